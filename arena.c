@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+#define ALIGN_UP(n) (((n) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t size;    /* bytes after the header */
+    size_t used;
+};
+
+/* the header rounded up so the first allocation is aligned too */
+#define BLOCK_HEADER ALIGN_UP(sizeof(ArenaBlock))
+#define BLOCK_DATA(block) ((char*)(block) + BLOCK_HEADER)
+
+static ArenaBlock *new_block(size_t size) {
+    ArenaBlock *block = (ArenaBlock*)malloc(BLOCK_HEADER + size);
+    if (!block) return NULL;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+static void free_blocks(ArenaBlock *block) {
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void arena_init(Arena *arena, size_t block_size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->block_size = block_size ? ALIGN_UP(block_size) : ARENA_DEFAULT_BLOCK;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    if (!arena) return malloc(size);
+
+    size = ALIGN_UP(size ? size : 1);
+    ArenaBlock *block = arena->blocks;
+    if (!block || block->size - block->used < size) {
+        /* doesnt fit: new block in front (the tail of the old one is lost until the reset) */
+        block = new_block(size > arena->block_size ? size : arena->block_size);
+        if (!block) return NULL;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    void *ptr = BLOCK_DATA(block) + block->used;
+    block->used += size;
+    arena->used += size;
+    if (arena->used > arena->peak) arena->peak = arena->used;
+    arena->last = ptr;
+    return ptr;
+}
+
+void *arena_calloc(Arena *arena, size_t count, size_t size) {
+    if (!arena) return calloc(count, size);
+    void *ptr = arena_alloc(arena, count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size) {
+    if (!arena) return realloc(ptr, new_size);
+    if (!ptr) return arena_alloc(arena, new_size);
+
+    /* newest allocation: just move the end of the block */
+    if (ptr == arena->last) {
+        ArenaBlock *block = arena->blocks;
+        size_t start = (size_t)((char*)ptr - BLOCK_DATA(block));
+        size_t old_aligned = block->used - start;
+        size_t new_aligned = ALIGN_UP(new_size ? new_size : 1);
+        if (start + new_aligned <= block->size) {
+            block->used = start + new_aligned;
+            arena->used = arena->used - old_aligned + new_aligned;
+            if (arena->used > arena->peak) arena->peak = arena->used;
+            return ptr;
+        }
+    }
+
+    void *moved = arena_alloc(arena, new_size);
+    if (!moved) return NULL;
+    memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+    return moved;
+}
+
+void arena_free(Arena *arena, void *ptr) {
+    if (!arena) free(ptr);
+}
+
+void arena_reset(Arena *arena) {
+    ArenaBlock *block = arena->blocks;
+    if (!block) return;
+
+    /* one block that isnt oversized: keep it as it is */
+    if (!block->next && block->size <= ARENA_KEEP_MAX) {
+        block->used = 0;
+    } else {
+        /* the file needed several blocks: swap them for one that holds it all
+           next time (or a default one if it was a monster) */
+        size_t keep = arena_capacity(arena);
+        if (keep > ARENA_KEEP_MAX) keep = arena->block_size;
+        free_blocks(block);
+        arena->blocks = new_block(ALIGN_UP(keep)); /* NULL is fine, alloc makes one later */
+    }
+    arena->used = 0;
+    arena->last = NULL;
+}
+
+void arena_release(Arena *arena) {
+    free_blocks(arena->blocks);
+    arena->blocks = NULL;
+    arena->used = 0;
+    arena->last = NULL;
+}
+
+size_t arena_capacity(const Arena *arena) {
+    size_t total = 0;
+    const ArenaBlock *block;
+    for (block = arena->blocks; block; block = block->next) total += block->size;
+    return total;
+}
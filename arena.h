@@ -0,0 +1,61 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * arena.h
+ * -------
+ * Bump allocator for everything one assembly needs (tables, labels, macro
+ * bodies, the expanded lines). Nothing in it is freed one by one: the whole
+ * arena is reset when the file is done and the next file reuses the same
+ * memory, so a batch doesnt malloc/free per file.
+ *
+ * Every function also takes NULL for the arena and then just does the plain
+ * malloc/realloc/free thing, so code that sometimes lives longer than a file
+ * (the --prelude macro table) works the same way without one.
+ */
+
+#define ARENA_DEFAULT_BLOCK (64 * 1024)
+
+/* reset keeps at most this much for the next file (one huge file shouldnt
+   pin its memory for the rest of the batch) */
+#define ARENA_KEEP_MAX (4 * 1024 * 1024)
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *blocks;     /* newest first, allocations come from the head */
+    size_t block_size;      /* size of a fresh block */
+    size_t used;            /* bytes handed out since the last reset */
+    size_t peak;            /* most bytes used by one file */
+    void *last;             /* newest allocation (arena_realloc grows it in place) */
+} Arena;
+
+void arena_init(Arena *arena, size_t block_size);
+
+/* size bytes (16-byte aligned), NULL if memory ran out */
+void *arena_alloc(Arena *arena, size_t size);
+
+/* same, zeroed */
+void *arena_calloc(Arena *arena, size_t count, size_t size);
+
+/* ptr (old_size bytes, or NULL) grown to new_size. in place if it was the
+   newest allocation and still fits, else copied (the old bytes stay until
+   the reset). NULL if memory ran out, ptr is untouched then */
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+
+/* only does something without an arena (free) */
+void arena_free(Arena *arena, void *ptr);
+
+/* forget every allocation, keep one block big enough for the last file
+   (up to ARENA_KEEP_MAX) */
+void arena_reset(Arena *arena);
+
+/* give all the blocks back */
+void arena_release(Arena *arena);
+
+/* bytes the arena holds right now (all blocks) */
+size_t arena_capacity(const Arena *arena);
+
+#endif /* ARENA_H */
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "asm_protocol.h"
+#include "util.h"
+
+/*
+ * asm_client
+ * ----------
+ * Small client for the assembler daemon (final_project_c --serve SOCKET).
+ *   asm_client SOCKET <file>                 : assemble <file>.as, write outputs like the cli would
+ *   asm_client -n N [-c C] SOCKET <file>     : send it N times on C threads and print requests/sec
+ */
+
+#define BUSY_RETRY_NANOS 200000L /* 0.2ms backoff when the server says BUSY */
+
+typedef struct {
+    const char *socket_path;
+    const char *name;
+    const char *source;
+    size_t source_size;
+    int requests;        /* how many this thread sends */
+    int ok, failed, busy, errors;
+} ClientThread;
+
+/* whole <file>.as into memory */
+static char *load_source(const char *base_name, size_t *size) {
+    char filename[MAX_FILENAME];
+    snprintf(filename, MAX_FILENAME, "%s.as", base_name);
+
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (len < 0) {
+        fclose(fp);
+        return NULL;
+    }
+
+    char *data = malloc((size_t)len + 1);
+    if (data && fread(data, 1, (size_t)len, fp) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    if (data) *size = (size_t)len;
+    return data;
+}
+
+static int connect_to_server(const char *socket_path) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* one round trip (reply must be freed by caller) */
+static int do_request(const char *socket_path, const char *name, const char *source,
+                      size_t source_size, AsmReply *reply) {
+    memset(reply, 0, sizeof(*reply));
+    int fd = connect_to_server(socket_path);
+    if (fd < 0) return FALSE;
+    send_request(fd, name, source, source_size); /* BUSY servers may close early, reply still readable */
+    int ok = recv_reply(fd, reply);
+    close(fd);
+    return ok;
+}
+
+/* write one output section to <name>.<tag> (skipped if the server sent none) */
+static void write_output_file(const AsmReply *reply, const char *name, const char *tag) {
+    char filename[MAX_FILENAME];
+    const FrameSection *sec = find_section(reply, tag);
+    snprintf(filename, MAX_FILENAME, "%s.%s", name, tag);
+
+    if (!sec) return;
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "%s: Error - failed to write .%s file\n", name, tag);
+        return;
+    }
+    fwrite(sec->data, 1, sec->size, fp);
+    fclose(fp);
+}
+
+static void *client_thread(void *arg) {
+    ClientThread *t = (ClientThread*)arg;
+    int i;
+    for (i = 0; i < t->requests; i++) {
+        AsmReply reply;
+        for (;;) {
+            if (!do_request(t->socket_path, t->name, t->source, t->source_size, &reply)) {
+                t->errors++;
+                free_reply(&reply);
+                break;
+            }
+            if (strcmp(reply.status, ASM_STATUS_BUSY) == 0) {
+                struct timespec pause;
+                pause.tv_sec = 0;
+                pause.tv_nsec = BUSY_RETRY_NANOS;
+                t->busy++;
+                free_reply(&reply);
+                nanosleep(&pause, NULL);
+                continue;
+            }
+            if (strcmp(reply.status, ASM_STATUS_OK) == 0) t->ok++;
+            else t->failed++;
+            free_reply(&reply);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* -n mode: hammer the server and print throughput */
+static int run_benchmark(const char *socket_path, const char *name, const char *source,
+                         size_t source_size, int requests, int concurrency) {
+    ClientThread *threads = calloc((size_t)concurrency, sizeof(ClientThread));
+    pthread_t *ids = calloc((size_t)concurrency, sizeof(pthread_t));
+    if (!threads || !ids) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(threads);
+        free(ids);
+        return EXIT_FAILURE;
+    }
+
+    int i;
+    for (i = 0; i < concurrency; i++) {
+        threads[i].socket_path = socket_path;
+        threads[i].name = name;
+        threads[i].source = source;
+        threads[i].source_size = source_size;
+        threads[i].requests = requests / concurrency + (i < requests % concurrency ? 1 : 0);
+    }
+
+    double start = now_seconds();
+    for (i = 0; i < concurrency; i++) pthread_create(&ids[i], NULL, client_thread, &threads[i]);
+    for (i = 0; i < concurrency; i++) pthread_join(ids[i], NULL);
+    double elapsed = now_seconds() - start;
+
+    int ok = 0, failed = 0, busy = 0, errors = 0;
+    for (i = 0; i < concurrency; i++) {
+        ok += threads[i].ok;
+        failed += threads[i].failed;
+        busy += threads[i].busy;
+        errors += threads[i].errors;
+    }
+
+    printf("%d requests in %.3f s (%d threads): %.0f req/s\n",
+           ok + failed, elapsed, concurrency, elapsed > 0 ? (ok + failed) / elapsed : 0.0);
+    printf("ok %d, failed %d, busy retries %d, transport errors %d\n", ok, failed, busy, errors);
+
+    free(threads);
+    free(ids);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    int requests = 1, concurrency = 1;
+    int opt;
+
+    signal(SIGPIPE, SIG_IGN);
+    while ((opt = getopt(argc, argv, "n:c:")) != -1) {
+        if (opt == 'n') requests = atoi(optarg);
+        else if (opt == 'c') concurrency = atoi(optarg);
+        else break;
+    }
+    if (optind + 2 != argc || requests < 1 || concurrency < 1) {
+        fprintf(stderr, "Usage: %s [-n requests] [-c concurrency] <socket> <file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *socket_path = argv[optind];
+    const char *name = argv[optind + 1];
+    size_t source_size = 0;
+    char *source = load_source(name, &source_size);
+    if (!source) {
+        fprintf(stderr, "%s: Error - cannot open .as file\n", name);
+        return EXIT_FAILURE;
+    }
+
+    int result;
+    if (requests > 1) {
+        if (concurrency > requests) concurrency = requests;
+        result = run_benchmark(socket_path, name, source, source_size, requests, concurrency);
+    } else {
+        AsmReply reply;
+        if (!do_request(socket_path, name, source, source_size, &reply)) {
+            fprintf(stderr, "%s: Error - no reply from server at %s\n", name, socket_path);
+            free_reply(&reply);
+            free(source);
+            return EXIT_FAILURE;
+        }
+
+        const FrameSection *out = find_section(&reply, "stdout");
+        const FrameSection *err = find_section(&reply, "stderr");
+        if (out) fwrite(out->data, 1, out->size, stdout);
+        if (err) fwrite(err->data, 1, err->size, stderr);
+
+        write_output_file(&reply, name, "ob");
+        write_output_file(&reply, name, "ent");
+        write_output_file(&reply, name, "ext");
+
+        if (strcmp(reply.status, ASM_STATUS_BUSY) == 0)
+            fprintf(stderr, "%s: server busy, try again\n", name);
+        result = (strcmp(reply.status, ASM_STATUS_OK) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        free_reply(&reply);
+    }
+
+    free(source);
+    return result;
+}
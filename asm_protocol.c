@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "asm_protocol.h"
+#include "util.h"
+
+/* ---------------- raw fd helpers ---------------- */
+
+int write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return FALSE;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return TRUE;
+}
+
+int read_all(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return FALSE;
+        }
+        if (n == 0) return FALSE; /* peer hung up early */
+        p += n;
+        len -= (size_t)n;
+    }
+    return TRUE;
+}
+
+/* read one header line byte by byte (headers are short so its fine) */
+static int read_header_line(int fd, char *line, size_t cap) {
+    size_t len = 0;
+    while (len + 1 < cap) {
+        char c;
+        if (!read_all(fd, &c, 1)) return FALSE;
+        if (c == NEWLINE_CHAR) {
+            line[len] = NULL_CHAR;
+            return TRUE;
+        }
+        line[len++] = c;
+    }
+    return FALSE; /* header way too long, not our protocol */
+}
+
+/* malloc + read exactly size bytes (+ a null so text payloads are strings) */
+static char *read_payload(int fd, size_t size) {
+    char *data = malloc(size + 1);
+    if (!data) return NULL;
+    if (size > 0 && !read_all(fd, data, size)) {
+        free(data);
+        return NULL;
+    }
+    data[size] = NULL_CHAR;
+    return data;
+}
+
+/* ---------------- request ---------------- */
+
+int send_request(int fd, const char *name, const char *source, size_t source_size) {
+    char header[ASM_MAX_HEADER_LEN];
+    size_t name_len = strlen(name);
+    int n = snprintf(header, sizeof(header), "%s REQUEST %lu %lu\n", ASM_PROTOCOL_MAGIC,
+                     (unsigned long)name_len, (unsigned long)source_size);
+    return write_all(fd, header, (size_t)n) &&
+           write_all(fd, name, name_len) &&
+           write_all(fd, source, source_size);
+}
+
+int recv_request(int fd, char **name, char **source, size_t *source_size) {
+    char header[ASM_MAX_HEADER_LEN];
+    char magic[ASM_MAX_TAG_LEN], kind[ASM_MAX_TAG_LEN];
+    unsigned long name_len, src_len;
+
+    *name = NULL;
+    *source = NULL;
+    if (!read_header_line(fd, header, sizeof(header))) return FALSE;
+    if (sscanf(header, "%15s %15s %lu %lu", magic, kind, &name_len, &src_len) != 4) return FALSE;
+    if (strcmp(magic, ASM_PROTOCOL_MAGIC) != 0 || strcmp(kind, "REQUEST") != 0) return FALSE;
+    if (name_len == 0 || name_len >= MAX_FILENAME - 4 || src_len > ASM_MAX_SOURCE_SIZE) return FALSE;
+
+    *name = read_payload(fd, name_len);
+    if (!*name) return FALSE;
+    *source = read_payload(fd, src_len);
+    if (!*source) {
+        free(*name);
+        *name = NULL;
+        return FALSE;
+    }
+    *source_size = src_len;
+    return TRUE;
+}
+
+/* ---------------- reply ---------------- */
+
+int format_reply_header(char *buf, size_t size, const char *status, int section_count) {
+    return snprintf(buf, size, "%s %s %d\n", ASM_PROTOCOL_MAGIC, status, section_count);
+}
+
+int format_section_header(char *buf, size_t size, const char *tag, size_t payload_size) {
+    return snprintf(buf, size, "%s %lu\n", tag, (unsigned long)payload_size);
+}
+
+int send_reply_header(int fd, const char *status, int section_count) {
+    char header[ASM_MAX_HEADER_LEN];
+    int n = format_reply_header(header, sizeof(header), status, section_count);
+    return write_all(fd, header, (size_t)n);
+}
+
+int send_section(int fd, const char *tag, const char *data, size_t size) {
+    char header[ASM_MAX_HEADER_LEN];
+    int n = format_section_header(header, sizeof(header), tag, size);
+    return write_all(fd, header, (size_t)n) &&
+           (size == 0 || write_all(fd, data, size)) &&
+           write_all(fd, NEW_LINE_STRING, 1);
+}
+
+int recv_reply(int fd, AsmReply *reply) {
+    char header[ASM_MAX_HEADER_LEN];
+    char magic[ASM_MAX_TAG_LEN];
+    int count;
+
+    memset(reply, 0, sizeof(*reply));
+    if (!read_header_line(fd, header, sizeof(header))) return FALSE;
+    if (sscanf(header, "%15s %15s %d", magic, reply->status, &count) != 3) return FALSE;
+    if (strcmp(magic, ASM_PROTOCOL_MAGIC) != 0 || count < 0 || count > ASM_MAX_SECTIONS) return FALSE;
+
+    int i;
+    for (i = 0; i < count; i++) {
+        FrameSection *sec = &reply->sections[i];
+        unsigned long size;
+        char newline;
+
+        if (!read_header_line(fd, header, sizeof(header))) return FALSE;
+        if (sscanf(header, "%15s %lu", sec->tag, &size) != 2) return FALSE;
+        sec->data = read_payload(fd, size);
+        if (!sec->data) return FALSE;
+        sec->size = size;
+        reply->section_count++;
+        if (!read_all(fd, &newline, 1)) return FALSE;
+    }
+    return TRUE;
+}
+
+const FrameSection *find_section(const AsmReply *reply, const char *tag) {
+    int i;
+    for (i = 0; i < reply->section_count; i++) {
+        if (strcmp(reply->sections[i].tag, tag) == 0) return &reply->sections[i];
+    }
+    return NULL;
+}
+
+void free_reply(AsmReply *reply) {
+    int i;
+    for (i = 0; i < reply->section_count; i++) free(reply->sections[i].data);
+    reply->section_count = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef ASM_PROTOCOL_H
+#define ASM_PROTOCOL_H
+
+#include <stddef.h>
+
+/*
+ * asm_protocol.h
+ * --------------
+ * Tiny framed format used by the assembler daemon (and its client), and by
+ * the cli's --stdout mode (one reply per input file, back to back).
+ * Headers are one text line, payloads are raw bytes with a known length:
+ *
+ *   request : "ASM1 REQUEST <name_len> <source_len>\n" <name> <source>
+ *   reply   : "ASM1 <status> <section_count>\n"
+ *             then per section: "<tag> <len>\n" <bytes> "\n"
+ *
+ * status is OK / FAILED / BUSY / BAD_REQUEST.
+ * tags are "ob", "ent", "ext" (only present if that file would exist),
+ * "stdout" and "stderr" (the messages a normal run would have printed).
+ * --stdout replies start with a "name" section (which input this one is).
+ */
+#define ASM_PROTOCOL_MAGIC "ASM1"
+#define ASM_MAX_SOURCE_SIZE (1 << 20)   /* 1MB of source is plenty for 255 words */
+#define ASM_MAX_SECTIONS 8
+#define ASM_MAX_TAG_LEN 16
+#define ASM_MAX_HEADER_LEN 128
+
+#define ASM_STATUS_OK "OK"
+#define ASM_STATUS_FAILED "FAILED"
+#define ASM_STATUS_BUSY "BUSY"
+#define ASM_STATUS_BAD_REQUEST "BAD_REQUEST"
+
+/* one framed payload */
+typedef struct {
+    char tag[ASM_MAX_TAG_LEN];
+    char *data;      /* malloc'd (may be NULL when size is 0) */
+    size_t size;
+} FrameSection;
+
+/* a decoded reply */
+typedef struct {
+    char status[ASM_MAX_TAG_LEN];
+    int section_count;
+    FrameSection sections[ASM_MAX_SECTIONS];
+} AsmReply;
+
+/* raw fd helpers (retry on short reads/writes and EINTR) */
+int write_all(int fd, const void *buf, size_t len);
+int read_all(int fd, void *buf, size_t len);
+
+/* request side */
+int send_request(int fd, const char *name, const char *source, size_t source_size);
+int recv_request(int fd, char **name, char **source, size_t *source_size);
+
+/* header lines without the fd (for writers that arent sockets), return the length */
+int format_reply_header(char *buf, size_t size, const char *status, int section_count);
+int format_section_header(char *buf, size_t size, const char *tag, size_t payload_size);
+
+/* reply side */
+int send_reply_header(int fd, const char *status, int section_count);
+int send_section(int fd, const char *tag, const char *data, size_t size);
+int recv_reply(int fd, AsmReply *reply);
+const FrameSection *find_section(const AsmReply *reply, const char *tag);
+void free_reply(AsmReply *reply);
+
+#endif /* ASM_PROTOCOL_H */
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "asm_server.h"
+#include "asm_protocol.h"
+#include "assembler.h"
+#include "libasm.h"
+#include "output_capture.h"
+#include "work_queue.h"
+#include "util.h"
+
+/* a client that stalls mid-request shouldnt hold a worker forever */
+#define CLIENT_TIMEOUT_SECONDS 5
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+/* no SA_RESTART on purpose: accept() has to return EINTR so we notice the stop */
+static void install_signal_handlers(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN); /* client gone = write error, not a dead daemon */
+}
+
+/* block (or unblock) the stop signals in the calling thread. threads made in
+   between inherit the block, so only the accept() loop ever gets them */
+static void block_stop_signals(int block) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    pthread_sigmask(block ? SIG_BLOCK : SIG_UNBLOCK, &set, NULL);
+}
+
+/* FrameWriter for a client socket */
+static int write_to_socket(const char *data, size_t size, void *context) {
+    return write_all(*(int*)context, data, size);
+}
+
+/* what every worker shares */
+typedef struct {
+    WorkQueue queue;
+    const AsmPrelude *prelude;
+} ServerContext;
+
+/* read one request, assemble it in memory, write the reply */
+static void handle_connection(int fd, const AsmPrelude *prelude, AsmArena *arena) {
+    struct timeval timeout;
+    timeout.tv_sec = CLIENT_TIMEOUT_SECONDS;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char *name = NULL, *source = NULL;
+    size_t source_size = 0;
+    if (!recv_request(fd, &name, &source, &source_size)) {
+        send_reply_header(fd, ASM_STATUS_BAD_REQUEST, 0);
+        free(name);
+        free(source);
+        return;
+    }
+
+    OutputCapture cap;
+    AsmResult result;
+    AsmOptions options;
+    memset(&cap, 0, sizeof(cap));
+    memset(&options, 0, sizeof(options));
+    options.prelude = prelude;
+    options.arena = arena;
+
+    asm_assemble(source, source_size, name, &options, &result);
+
+    /* same messages the cli would print, split by stream */
+    OutputCapture *outer = capture_begin(&cap);
+    replay_assembly_messages(&result);
+    print_assembly_summary(name, result.success, result.object_size > 0, result.entries_size > 0,
+                           result.externals_size > 0);
+    capture_end(outer);
+
+    write_assembly_frame(write_to_socket, &fd, NULL, &result, &cap);
+
+    asm_free_result(&result);
+    capture_free(&cap);
+    free(name);
+    free(source);
+}
+
+/* worker: pop accepted connections until the queue is closed */
+static void *server_worker(void *arg) {
+    ServerContext *server = (ServerContext*)arg;
+    AsmArena *arena = asm_arena_create(); /* reused by every request this worker takes */
+    void *item;
+    while (queue_pop(&server->queue, &item)) {
+        int fd = (int)(intptr_t)item;
+        handle_connection(fd, server->prelude, arena);
+        close(fd);
+    }
+    asm_arena_free(arena);
+    return NULL;
+}
+
+/* make + bind the listening socket (replaces a stale socket file) */
+static int open_listen_socket(const char *socket_path, int backlog) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: Error - socket path too long\n", socket_path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, backlog) < 0) {
+        perror(socket_path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int run_server(const char *socket_path, int workers, int queue_capacity, const AsmPrelude *prelude) {
+    ServerContext server;
+    if (workers < 1) workers = 1;
+    if (queue_capacity < 1) queue_capacity = DEFAULT_SERVER_QUEUE;
+
+    int listen_fd = open_listen_socket(socket_path, queue_capacity);
+    if (listen_fd < 0) return EXIT_FAILURE;
+
+    pthread_t *threads = calloc((size_t)workers, sizeof(pthread_t));
+    server.prelude = prelude;
+    if (!threads || !queue_init(&server.queue, queue_capacity)) {
+        fprintf(stderr, "Error: failed to allocate server workers\n");
+        free(threads);
+        close(listen_fd);
+        unlink(socket_path);
+        return EXIT_FAILURE;
+    }
+
+    /* handlers first: a stop that comes in while the workers start still counts */
+    install_signal_handlers();
+    block_stop_signals(TRUE);
+    int started = 0;
+    int i;
+    for (i = 0; i < workers; i++) {
+        if (pthread_create(&threads[i], NULL, server_worker, &server) != 0) break;
+        started++;
+    }
+    block_stop_signals(FALSE);
+
+    fprintf(stdout, "%s: listening (%d workers, queue %d)\n", socket_path, started, queue_capacity);
+    fflush(stdout);
+
+    while (!stop_requested && started > 0) {
+        int client = accept(listen_fd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            break;
+        }
+        if (!queue_try_push(&server.queue, (void*)(intptr_t)client)) {
+            /* queue full: tell the caller to back off instead of waiting here */
+            send_reply_header(client, ASM_STATUS_BUSY, 0);
+            close(client);
+        }
+    }
+
+    queue_close(&server.queue); /* workers finish whats queued, then exit */
+    for (i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    queue_destroy(&server.queue);
+    free(threads);
+    close(listen_fd);
+    unlink(socket_path);
+    fprintf(stdout, "%s: server stopped\n", socket_path);
+    return EXIT_SUCCESS;
+}
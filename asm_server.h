@@ -0,0 +1,21 @@
+#ifndef ASM_SERVER_H
+#define ASM_SERVER_H
+
+#include "libasm.h"
+
+#define DEFAULT_SERVER_QUEUE 64
+
+/*
+ * run_server
+ * ----------
+ * Daemon mode: listens on a unix domain socket at socket_path and assembles
+ * every request (see asm_protocol.h) in memory on a pool of worker threads.
+ * Accepted requests wait in a bounded queue of queue_capacity; when its full
+ * the caller gets a BUSY reply right away instead of piling up.
+ * Every request can call the macros of prelude (NULL = none).
+ * Runs until SIGINT/SIGTERM, then removes the socket file.
+ * returns EXIT_SUCCESS / EXIT_FAILURE (for main to pass on).
+ */
+int run_server(const char *socket_path, int workers, int queue_capacity, const AsmPrelude *prelude);
+
+#endif /* ASM_SERVER_H */
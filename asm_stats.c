@@ -0,0 +1,31 @@
+#include <stddef.h>
+#include "asm_stats.h"
+
+__thread AsmStats *current_asm_stats = NULL;
+
+static const char *stage_names[ASM_STAGE_COUNT] = {
+    "pre_assembly", "first_pass", "second_pass", "export"
+};
+
+static const char *counter_names[ASM_COUNTER_COUNT] = {
+    "find_label_by_name", "count_label_by_name", "is_matrix", "is_register",
+    "is_number", "ensure_capacity_reallocs", "macro_expansions"
+};
+
+AsmStats *stats_begin(AsmStats *stats) {
+    AsmStats *previous = current_asm_stats;
+    current_asm_stats = stats;
+    return previous;
+}
+
+void stats_end(AsmStats *previous) {
+    current_asm_stats = previous;
+}
+
+const char *asm_stage_name(int stage) {
+    return (stage >= 0 && stage < ASM_STAGE_COUNT) ? stage_names[stage] : "unknown";
+}
+
+const char *asm_counter_name(int counter) {
+    return (counter >= 0 && counter < ASM_COUNTER_COUNT) ? counter_names[counter] : "unknown";
+}
@@ -0,0 +1,22 @@
+#ifndef ASM_STATS_H
+#define ASM_STATS_H
+
+#include "libasm.h"
+
+/*
+ * asm_stats.h
+ * -----------
+ * Internal side of AsmStats: asm_assemble points this thread's counters at
+ * the result, the hot functions bump them with STATS_COUNT. Outside an
+ * assembly (no target) counting is a no-op, so util funcs stay usable anywhere.
+ */
+extern __thread AsmStats *current_asm_stats;
+
+#define STATS_COUNT(counter) \
+    do { if (current_asm_stats) current_asm_stats->counters[counter]++; } while (0)
+
+/* same begin/end nesting as capture_begin/capture_end */
+AsmStats *stats_begin(AsmStats *stats);
+void stats_end(AsmStats *previous);
+
+#endif /* ASM_STATS_H */
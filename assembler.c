@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "assembler.h"
+#include "asm_protocol.h"
+#include "libasm.h"
+#include "output_capture.h"
+#include "util.h"
+
+/* name shown in messages/frames for the "-" input */
+#define STDIN_DISPLAY_NAME "stdin"
+
+/* .as files at least this big get mmap'd, smaller ones are quicker with one read */
+#define MAP_INPUT_MIN_SIZE (64 * 1024)
+
+/* a loaded .as file (the stages only ever read it) */
+typedef struct {
+    char *data;
+    size_t size;
+    int mapped;     /* TRUE = munmap it, FALSE = free it */
+} SourceText;
+
+/* whole stream into a malloc'd buffer (NULL if reading failed) */
+static char *read_whole_stream(FILE *fp, size_t *size) {
+    size_t capacity = 4096, used = 0;
+    char *data = malloc(capacity);
+    while (data) {
+        used += fread(data + used, 1, capacity - used, fp);
+        if (used < capacity) break; /* eof (or read error) */
+        char *bigger = realloc(data, capacity * 2);
+        if (!bigger) {
+            free(data);
+            data = NULL;
+            break;
+        }
+        data = bigger;
+        capacity *= 2;
+    }
+    if (data && ferror(fp)) {
+        free(data);
+        data = NULL;
+    }
+    *size = used;
+    return data;
+}
+
+/* whole file in memory: mapped if its big, else read into a malloc'd buffer.
+   FALSE if it cant be opened/read */
+static int load_source_file(const char *filename, SourceText *source) {
+    struct stat info;
+    int fd = open(filename, O_RDONLY);
+    memset(source, 0, sizeof(*source));
+    if (fd < 0) return FALSE;
+
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size >= MAP_INPUT_MIN_SIZE) {
+        void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            close(fd);
+            source->data = data;
+            source->size = (size_t)info.st_size;
+            source->mapped = TRUE;
+            return TRUE;
+        }
+        /* cant map it? just read it then */
+    }
+
+    FILE *fp = fdopen(fd, "rb");
+    if (!fp) {
+        close(fd);
+        return FALSE;
+    }
+    source->data = read_whole_stream(fp, &source->size);
+    fclose(fp);
+    return source->data != NULL;
+}
+
+static void release_source(SourceText *source) {
+    if (source->mapped) munmap(source->data, source->size);
+    else free(source->data);
+    source->data = NULL;
+}
+
+/* what the .am hook needs (am_copy only kept when the result goes into the cache) */
+typedef struct {
+    const char *base_name;
+    int keep_copy;
+    char *am_copy;
+    size_t am_size;
+} AmHookContext;
+
+/* <base>.am from the expanded text (no msg, the caller decides what to print) */
+static int save_am_text(const char *base_name, const char *text, size_t size) {
+    char filename[MAX_FILENAME];
+    snprintf(filename, MAX_FILENAME, "%s.am", base_name);
+
+    FILE *out = fopen(filename, "w");
+    if (!out) {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "cannot create output file: %s", filename);
+        print_error(base_name, 0, buf);
+        return FALSE;
+    }
+    fwrite(text, 1, size, out);
+    fclose(out);
+    return TRUE;
+}
+
+/* hook: macro-expanded text → <base>.am (keeps the old debug artifact around) */
+static int write_am_file(const char *text, size_t size, void *context) {
+    AmHookContext *hook = (AmHookContext*)context;
+    if (!save_am_text(hook->base_name, text, size)) return FALSE;
+    out_printf("%s: .am file created\n", hook->base_name);
+
+    if (hook->keep_copy) {
+        hook->am_copy = malloc(size + 1);
+        if (hook->am_copy) {
+            memcpy(hook->am_copy, text, size);
+            hook->am_copy[size] = NULL_CHAR;
+            hook->am_size = size;
+        }
+    }
+    return TRUE;
+}
+
+/* hand one file's numbers to --stats (if on). file_stats NULL = never assembled */
+static void record_stats(const AssembleSettings *settings, const char *name, int ok, int cached,
+                         const AsmStats *file_stats) {
+    if (settings->stats)
+        batch_stats_record(settings->stats, settings->input_index, name, ok, cached, file_stats);
+}
+
+/* run the pipeline, or pull the same outputs out of the cache (if there is one) */
+static int assemble_source(const char *source, size_t source_size, const char *base_name,
+                           const AssembleSettings *settings, AsmArena *arena, AsmResult *result) {
+    AsmOptions options;
+    AmHookContext hook;
+    OutputCache *cache = settings->cache;
+    memset(&options, 0, sizeof(options));
+    memset(&hook, 0, sizeof(hook));
+    hook.base_name = base_name;
+    options.prelude = settings->prelude;
+    options.arena = arena;
+    options.one_pass = settings->one_pass;
+    if (settings->emit_am) {
+        options.on_expanded = write_am_file;
+        options.context = &hook;
+    }
+
+    if (!cache) {
+        int ok = asm_assemble(source, source_size, base_name, &options, result);
+        record_stats(settings, base_name, ok, FALSE, &result->stats);
+        return ok;
+    }
+
+    /* with --emit-am the msgs differ (".am file created"), so its a separate entry.
+       same for a prelude (a different one can change the whole expansion) */
+    char variant[64];
+    snprintf(variant, sizeof(variant), "%s%s", settings->emit_am ? "emit-am" : EMPTY_STRING,
+             settings->prelude_key);
+    CacheKey key = cache_key(source, source_size, variant);
+    char *am_text = NULL;
+    size_t am_size = 0;
+    if (cache_fetch(cache, key, source_size, base_name, result, &am_text, &am_size)) {
+        /* hit: the stored msgs already say ".am file created" */
+        if (am_text) save_am_text(base_name, am_text, am_size);
+        free(am_text);
+        record_stats(settings, base_name, result->success, TRUE, NULL);
+        return result->success;
+    }
+
+    hook.keep_copy = settings->emit_am;
+    double started = monotonic_seconds();
+    int ok = asm_assemble(source, source_size, base_name, &options, result);
+    cache_store(cache, key, source_size, base_name, result, hook.am_copy, hook.am_size,
+                monotonic_seconds() - started);
+    free(hook.am_copy);
+    record_stats(settings, base_name, ok, FALSE, &result->stats);
+    return ok;
+}
+
+/* write <base>.<ext> from a buffer; empty buffer = no file (stale one removed) */
+static int write_output_file(const char *base_name, const char *ext, const char *what,
+                             const char *data, size_t size) {
+    char filename[MAX_FILENAME];
+    snprintf(filename, MAX_FILENAME, "%s.%s", base_name, ext);
+
+    if (size == 0) {
+        remove(filename);
+        return FALSE;
+    }
+
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        err_printf("%s: Error - failed to write %s file\n", base_name, what);
+        return FALSE;
+    }
+    fwrite(data, 1, size, fp);
+    fclose(fp);
+    return TRUE;
+}
+
+void replay_assembly_messages(const AsmResult *result) {
+    int i;
+    for (i = 0; i < result->message_count; i++) {
+        if (result->messages[i].is_error) err_printf("%s", result->messages[i].text);
+        else out_printf("%s", result->messages[i].text);
+    }
+}
+
+void print_assembly_summary(const char *base_name, int success,
+                            int ob_ok, int ent_ok, int ext_ok) {
+    if (!success) {
+        /* same fail line for every stage (log parsers grep for it) */
+        err_printf("%s: Due to errors no | .ob | .ext | .ent | files created\n", base_name);
+        return;
+    }
+
+    if (!ob_ok) out_printf("%s: .ob file not created\n", base_name);
+    else        out_printf("%s: .ob file created\n", base_name);
+
+    if (!ent_ok) out_printf("%s: .ent file not created\n", base_name);
+    else         out_printf("%s: .ent file created\n", base_name);
+
+    if (!ext_ok) out_printf("%s: .ext file not created\n", base_name);
+    else         out_printf("%s: .ext file created", base_name);
+
+    /* lil success message (kinda verbose but nice for users) */
+    out_printf("%s: Successfully compiled\n", base_name);
+}
+
+/* send one "stdout"/"stderr" section made of the captured text of one stream */
+static int write_capture_section(FrameWriter write, void *context, const OutputCapture *messages,
+                                 int to_stderr, const char *tag) {
+    size_t size = 0;
+    char *text = messages ? capture_collect(messages, to_stderr, &size) : NULL;
+    int ok = write_frame_section(write, context, tag, text ? text : EMPTY_STRING, text ? size : 0);
+    free(text);
+    return ok;
+}
+
+int write_frame_section(FrameWriter write, void *context, const char *tag,
+                        const char *data, size_t size) {
+    char header[ASM_MAX_HEADER_LEN];
+    int n = format_section_header(header, sizeof(header), tag, size);
+    return write(header, (size_t)n, context) &&
+           (size == 0 || write(data, size, context)) &&
+           write(NEW_LINE_STRING, 1, context);
+}
+
+int write_assembly_frame(FrameWriter write, void *context, const char *name,
+                         const AsmResult *result, const OutputCapture *messages) {
+    char header[ASM_MAX_HEADER_LEN];
+    int sections = 2; /* stdout + stderr always there */
+    if (name) sections++;
+    if (result->object_size > 0) sections++;
+    if (result->entries_size > 0) sections++;
+    if (result->externals_size > 0) sections++;
+
+    int n = format_reply_header(header, sizeof(header),
+                                result->success ? ASM_STATUS_OK : ASM_STATUS_FAILED, sections);
+    int ok = write(header, (size_t)n, context);
+    if (ok && name) ok = write_frame_section(write, context, "name", name, strlen(name));
+    if (ok && result->object_size > 0)    ok = write_frame_section(write, context, "ob", result->object, result->object_size);
+    if (ok && result->entries_size > 0)   ok = write_frame_section(write, context, "ent", result->entries, result->entries_size);
+    if (ok && result->externals_size > 0) ok = write_frame_section(write, context, "ext", result->externals, result->externals_size);
+    if (ok) ok = write_capture_section(write, context, messages, 0, "stdout");
+    if (ok) ok = write_capture_section(write, context, messages, 1, "stderr");
+    return ok;
+}
+
+/* FrameWriter for --stdout (goes through out_write so --jobs keeps frames whole) */
+static int write_to_stdout(const char *data, size_t size, void *context) {
+    (void)context;
+    out_write(data, size);
+    return TRUE;
+}
+
+/*
+ * assemble_to_frame
+ * -----------------
+ * --stdout / "-" path: same stages, but nothing touches the filesystem. The
+ * messages are captured and shipped inside the frame with the outputs.
+ */
+static int assemble_to_frame(const char *base_name, const AssembleSettings *settings, AsmArena *arena) {
+    int from_stdin = strcmp(base_name, STDIN_INPUT_NAME) == 0;
+    const char *name = from_stdin ? STDIN_DISPLAY_NAME : base_name;
+    char filename[MAX_FILENAME];
+    SourceText source;
+    int loaded;
+    OutputCapture messages;
+    AsmResult result;
+    AssembleSettings no_files = *settings;
+
+    no_files.emit_am = FALSE;
+    memset(&messages, 0, sizeof(messages));
+    memset(&result, 0, sizeof(result));
+    OutputCapture *outer = capture_begin(&messages);
+
+    if (from_stdin) {
+        memset(&source, 0, sizeof(source));
+        source.data = read_whole_stream(stdin, &source.size);
+        loaded = source.data != NULL;
+    } else {
+        snprintf(filename, MAX_FILENAME, "%s.as", base_name);
+        loaded = load_source_file(filename, &source);
+    }
+
+    if (!loaded) {
+        err_printf("%s: Error - cannot open .as file\n", name);
+        record_stats(settings, name, FALSE, FALSE, NULL);
+    } else {
+        assemble_source(source.data, source.size, name, &no_files, arena, &result);
+        release_source(&source);
+        replay_assembly_messages(&result);
+    }
+    print_assembly_summary(name, result.success, result.object_size > 0,
+                           result.entries_size > 0, result.externals_size > 0);
+    capture_end(outer);
+
+    write_assembly_frame(write_to_stdout, NULL, name, &result, &messages);
+
+    int ok = result.success;
+    asm_free_result(&result);
+    capture_free(&messages);
+    return ok;
+}
+
+int load_prelude(const char *path, AssembleSettings *settings) {
+    SourceText text;
+    AsmResult result;
+
+    if (!load_source_file(path, &text)) {
+        err_printf("%s: Error - cannot open prelude file\n", path);
+        return FALSE;
+    }
+
+    settings->prelude = asm_prelude_create(text.data, text.size, path, &result);
+    replay_assembly_messages(&result);
+    asm_free_result(&result);
+    if (settings->prelude) {
+        CacheKey key = cache_key(text.data, text.size, "prelude");
+        snprintf(settings->prelude_key, sizeof(settings->prelude_key), " prelude=%016llx%016llx",
+                 key.hi, key.lo);
+    }
+    release_source(&text);
+    return settings->prelude != NULL;
+}
+
+int assemble_file(const char *base_name, const AssembleSettings *settings, AsmArena *arena) {
+    char filename[MAX_FILENAME];
+    SourceText source;
+
+    if (settings->framed_output || strcmp(base_name, STDIN_INPUT_NAME) == 0) {
+        return assemble_to_frame(base_name, settings, arena);
+    }
+
+    /* ---------- load <file>.as ---------- */
+    snprintf(filename, MAX_FILENAME, "%s.as", base_name);     /* build source path */
+    if (!load_source_file(filename, &source)) {
+        /* cant open input file — probably bad path or perms */
+        err_printf("%s: Error - cannot open .as file\n", base_name);
+        record_stats(settings, base_name, FALSE, FALSE, NULL);
+        print_assembly_summary(base_name, FALSE, FALSE, FALSE, FALSE);
+        return FALSE; /* caller moves on to the next file (dont crash whole batch) */
+    }
+
+    /* ---------- all stages in memory (a .am copy only with --emit-am) ---------- */
+    AsmResult result;
+    int ok = assemble_source(source.data, source.size, base_name, settings, arena, &result);
+    release_source(&source);
+    replay_assembly_messages(&result);
+
+    /* ---------- Export artifacts (.ob / .ent / .ext) ---------- */
+    int ob_ok = FALSE, ent_ok = FALSE, ext_ok = FALSE;
+    if (ok) {
+        ob_ok  = write_output_file(base_name, "ob", ".ob", result.object, result.object_size);
+        ent_ok = write_output_file(base_name, "ent", ".ent", result.entries, result.entries_size);
+        ext_ok = write_output_file(base_name, "ext", ".ex", result.externals, result.externals_size);
+    }
+
+    print_assembly_summary(base_name, ok, ob_ok, ent_ok, ext_ok);
+    asm_free_result(&result);
+    return ok;
+}
@@ -0,0 +1,81 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <stddef.h>
+#include "libasm.h"
+#include "output_cache.h"
+#include "output_capture.h"
+#include "batch_stats.h"
+
+/* input name meaning "read the source from stdin" */
+#define STDIN_INPUT_NAME "-"
+
+/* cli knobs shared by every file of a run */
+typedef struct {
+    int emit_am;          /* --emit-am: also write <base>.am (debug copy of the expansion) */
+    OutputCache *cache;   /* --cache DIR, NULL = off */
+    int framed_output;    /* --stdout: outputs + msgs as one frame on stdout, no files */
+    BatchStats *stats;    /* --stats FILE, NULL = off */
+    AsmPrelude *prelude;  /* --prelude FILE, NULL = off */
+    char prelude_key[48]; /* " prelude=<hash of its text>" for the cache key ("" = no prelude) */
+    int one_pass;         /* --one-pass: backpatching single pass (same outputs, so same cache entries) */
+    int input_index;      /* this file's place in the batch (orders the --stats entries), set
+                             per file on a copy of the run's settings */
+} AssembleSettings;
+
+/*
+ * load_prelude
+ * ------------
+ * Reads + parses the --prelude file once for the whole run (its errors are
+ * printed like a file's). Sets settings->prelude and prelude_key.
+ * returns FALSE if it cant be read or has errors.
+ */
+int load_prelude(const char *path, AssembleSettings *settings);
+
+/*
+ * assemble_file
+ * -------------
+ * The cli's per-file job, a thin layer over asm_assemble():
+ *   reads <base>.as into memory, assembles it, writes <base>.ob/.ent/.ext
+ *   (+ <base>.am with emit_am) and prints the usual messages through
+ *   out_printf/err_printf (so a worker thread can capture them).
+ *   settings->cache: reuse the outputs of an identical source if present.
+ *   arena: the calling thread's scratch memory (reset after the file), NULL = none.
+ *   "-" as base_name (or settings->framed_output) = no files at all: the
+ *   source comes from stdin / <base>.as and everything goes to stdout as
+ *   one asm_protocol reply frame (see write_assembly_frame).
+ * returns TRUE if the file compiled, FALSE if any stage failed.
+ */
+int assemble_file(const char *base_name, const AssembleSettings *settings, AsmArena *arena);
+
+/* prints the stage messages of a result in order (out_printf/err_printf) */
+void replay_assembly_messages(const AsmResult *result);
+
+/*
+ * print_assembly_summary
+ * ----------------------
+ * The closing lines the cli always printed: either "Due to errors ..." or
+ * the created/not created lines (ob_ok/ent_ok/ext_ok say which outputs
+ * actually exist) plus the success line.
+ */
+void print_assembly_summary(const char *base_name, int success,
+                            int ob_ok, int ent_ok, int ext_ok);
+
+/* where frame bytes go (socket, stdout, ...). returns FALSE if the write failed */
+typedef int (*FrameWriter)(const char *data, size_t size, void *context);
+
+/*
+ * write_assembly_frame
+ * --------------------
+ * One asm_protocol reply for a finished assembly: status, then a "name"
+ * section (skipped if name is NULL), ob/ent/ext (only the ones that exist)
+ * and the captured stdout/stderr text of messages (may be NULL = empty).
+ */
+int write_assembly_frame(FrameWriter write, void *context, const char *name,
+                         const AsmResult *result, const OutputCapture *messages);
+
+/* one "<tag> <len>\n<bytes>\n" section through a FrameWriter */
+int write_frame_section(FrameWriter write, void *context, const char *tag,
+                        const char *data, size_t size);
+
+#endif /* ASSEMBLER_H */
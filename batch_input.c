@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "batch_input.h"
+#include "util.h"
+
+#define MANIFEST_PREFIX '@'
+#define SOURCE_EXT ".as"
+#define SOURCE_EXT_LEN 3
+#define DIR_INITIAL_ENTRIES 64
+
+/* both callbacks + their context, so the walk only passes one thing around */
+typedef struct {
+    NameCallback on_name;
+    InputErrorCallback on_error;
+    void *context;
+} InputFeed;
+
+BatchInput input_from_arg(const char *arg) {
+    BatchInput input;
+    if (arg[0] == MANIFEST_PREFIX && arg[1] != NULL_CHAR) {
+        input.kind = INPUT_MANIFEST;
+        input.value = arg + 1;
+    } else {
+        input.kind = INPUT_NAME;
+        input.value = arg;
+    }
+    return input;
+}
+
+/* the assembler builds "<base>.xxx" in MAX_FILENAME bufs, longer names would get cut */
+static int emit_name(const char *base_name, const InputFeed *feed) {
+    if (strlen(base_name) + SOURCE_EXT_LEN + 2 > MAX_FILENAME) {
+        char message[64];
+        snprintf(message, sizeof(message), "file name too long (max %d chars)",
+                 MAX_FILENAME - SOURCE_EXT_LEN - 2);
+        return feed->on_error(base_name, message, feed->context); /* skip it */
+    }
+    return feed->on_name(base_name, feed->context);
+}
+
+/* one line at a time (getline), so a 200k line manifest is never in memory */
+static int read_manifest(const char *path, const InputFeed *feed) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return feed->on_error(path, "cannot open manifest", feed->context);
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    int keep_going = TRUE;
+    while (keep_going && getline(&line, &line_capacity, fp) != -1) {
+        /* trim both ends (windows line endings, stray spaces), skip blank lines */
+        char *start = line;
+        while (isspace((unsigned char)*start)) start++;
+        char *end = start + strlen(start);
+        while (end > start && isspace((unsigned char)*(end - 1))) end--;
+        *end = NULL_CHAR;
+
+        if (*start != NULL_CHAR) keep_going = emit_name(start, feed);
+    }
+    free(line);
+    fclose(fp);
+    return keep_going;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* entry names of one directory, sorted (NULL on failure, *count set) */
+static char **list_directory(const char *dir, int *count) {
+    DIR *d = opendir(dir);
+    if (!d) return NULL;
+
+    int capacity = DIR_INITIAL_ENTRIES;
+    char **names = malloc((size_t)capacity * sizeof(char *));
+    struct dirent *entry;
+    *count = 0;
+    while (names && (entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        if (*count >= capacity) {
+            char **grown = realloc(names, (size_t)capacity * GROWTH_FACTOR * sizeof(char *));
+            if (!grown) break;
+            names = grown;
+            capacity *= GROWTH_FACTOR;
+        }
+        names[*count] = malloc(strlen(entry->d_name) + 1);
+        if (!names[*count]) break;
+        strcpy(names[*count], entry->d_name);
+        (*count)++;
+    }
+    closedir(d);
+
+    if (names) qsort(names, (size_t)*count, sizeof(char *), compare_names);
+    return names;
+}
+
+/* depth first; symlinked dirs are not followed (no loops) */
+static int walk_directory(const char *dir, const InputFeed *feed) {
+    int count = 0;
+    char **names = list_directory(dir, &count);
+    if (!names) return feed->on_error(dir, "cannot read directory", feed->context);
+
+    int keep_going = TRUE;
+    int i;
+    for (i = 0; i < count; i++) {
+        if (keep_going) {
+            size_t path_len = strlen(dir) + strlen(names[i]) + 2;
+            char *path = malloc(path_len);
+            struct stat st;
+            if (!path) {
+                feed->on_error(dir, "out of memory while walking", feed->context);
+                keep_going = FALSE;
+            } else {
+                snprintf(path, path_len, "%s/%s", dir, names[i]);
+                size_t len = strlen(path);
+                if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+                    keep_going = walk_directory(path, feed);
+                } else if (len > SOURCE_EXT_LEN && strcmp(path + len - SOURCE_EXT_LEN, SOURCE_EXT) == 0 &&
+                           stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+                    path[len - SOURCE_EXT_LEN] = NULL_CHAR; /* base name = path without .as */
+                    keep_going = emit_name(path, feed);
+                }
+                free(path);
+            }
+        }
+        free(names[i]);
+    }
+    free(names);
+    return keep_going;
+}
+
+int for_each_input_name(const BatchInput *inputs, int count, NameCallback callback,
+                        InputErrorCallback on_input_error, void *context) {
+    InputFeed feed;
+    int i;
+    feed.on_name = callback;
+    feed.on_error = on_input_error;
+    feed.context = context;
+    for (i = 0; i < count; i++) {
+        int keep_going = TRUE;
+        switch (inputs[i].kind) {
+            case INPUT_NAME:      keep_going = callback(inputs[i].value, context); break;
+            case INPUT_MANIFEST:  keep_going = read_manifest(inputs[i].value, &feed); break;
+            case INPUT_DIRECTORY: keep_going = walk_directory(inputs[i].value, &feed); break;
+        }
+        if (!keep_going) return FALSE;
+    }
+    return TRUE;
+}
@@ -0,0 +1,49 @@
+#ifndef BATCH_INPUT_H
+#define BATCH_INPUT_H
+
+/*
+ * batch_input.h
+ * -------------
+ * Where a batch gets its base names from:
+ *   - a plain name from argv           ("foo" → foo.as)
+ *   - an @manifest file                (one base name per line, read as we go)
+ *   - a --recursive directory          (every *.as below it, walked as we go)
+ * Names are handed out one at a time through a callback, so assembling can
+ * start long before a huge manifest or tree has been read to the end.
+ */
+
+typedef enum {
+    INPUT_NAME,
+    INPUT_MANIFEST,
+    INPUT_DIRECTORY
+} BatchInputKind;
+
+typedef struct {
+    BatchInputKind kind;
+    const char *value;   /* name / manifest path / directory (not owned) */
+} BatchInput;
+
+/* gets each base name in order (only valid during the call). return FALSE to stop */
+typedef int (*NameCallback)(const char *base_name, void *context);
+
+/* gets an input that couldnt be used (name = the name/manifest/dir, message =
+   what went wrong, no "Error -" prefix), in the same order as the names so it
+   can be printed and counted like a failed file. return FALSE to stop */
+typedef int (*InputErrorCallback)(const char *name, const char *message, void *context);
+
+/* argv word → input ("@path" is a manifest, anything else a name) */
+BatchInput input_from_arg(const char *arg);
+
+/*
+ * for_each_input_name
+ * -------------------
+ * Feeds every base name of inputs[0..count-1] to callback, in order.
+ * Directories are walked in sorted order (same order every run).
+ * Unreadable manifests/dirs and names too long for the assembler go to
+ * on_input_error instead (at the spot they came up) and are skipped.
+ * returns FALSE if a callback asked to stop, TRUE otherwise.
+ */
+int for_each_input_name(const BatchInput *inputs, int count, NameCallback callback,
+                        InputErrorCallback on_input_error, void *context);
+
+#endif /* BATCH_INPUT_H */
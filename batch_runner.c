@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "batch_runner.h"
+#include "assembler.h"
+#include "output_capture.h"
+#include "util.h"
+
+/* how many found-but-not-printed files per worker before the feeder waits
+   (keeps memory flat when a manifest has 200k names) */
+#define PENDING_PER_WORKER 64
+
+/* one file in the batch (result + its captured output) */
+typedef struct BatchJob {
+    char *base_name;
+    int index;               /* place in the input order (for --stats) */
+    OutputCapture output;
+    int ok;
+    int done;                /* also set from the start for an input error */
+    struct BatchJob *next;
+} BatchJob;
+
+/* shared state of the pool (all guarded by lock) */
+typedef struct {
+    BatchJob *head;          /* oldest job not printed yet */
+    BatchJob *tail;
+    BatchJob *next_job;      /* first job no worker grabbed yet */
+    int pending;             /* jobs in the list */
+    int max_pending;
+    int feeding_done;        /* feeder walked every input */
+    int queued;              /* jobs the feeder made so far (only it touches this) */
+    const AssembleSettings *settings;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;  /* any of the above moved */
+} BatchPool;
+
+/* totals for the end-of-run summary */
+typedef struct {
+    int files;
+    int failed;
+} BatchTotals;
+
+typedef struct {
+    const AssembleSettings *settings;
+    BatchTotals *totals;    /* totals->files doubles as the next input index */
+    AsmArena *arena;
+} SerialContext;
+
+typedef struct {
+    BatchPool *pool;
+    const BatchInput *inputs;
+    int count;
+} FeederArgs;
+
+/* worker loop: grab next file, assemble it with output captured, mark done */
+static void *batch_worker(void *arg) {
+    BatchPool *pool = (BatchPool*)arg;
+    AsmArena *arena = asm_arena_create(); /* this worker's files all reuse it */
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->next_job && !pool->feeding_done)
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        BatchJob *job = pool->next_job;
+        if (!job) break;
+        pool->next_job = job->next;
+        if (job->done) continue; /* input error, nothing to assemble */
+        pthread_mutex_unlock(&pool->lock);
+
+        AssembleSettings file_settings = *pool->settings;
+        file_settings.input_index = job->index;
+        OutputCapture *outer = capture_begin(&job->output);
+        int ok = assemble_file(job->base_name, &file_settings, arena);
+        capture_end(outer);
+
+        pthread_mutex_lock(&pool->lock);
+        job->ok = ok;
+        job->done = TRUE;
+        pthread_cond_broadcast(&pool->changed);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    asm_arena_free(arena);
+    return NULL;
+}
+
+/* an input the feeder couldnt use, printed like a file's error (and in --stats
+   as a file that never got to the pipeline) */
+static void report_input_error(const AssembleSettings *settings, int index, const char *name,
+                               const char *message) {
+    err_printf("%s: Error - %s\n", name, message);
+    if (settings->stats) batch_stats_record(settings->stats, index, name, FALSE, FALSE, NULL);
+}
+
+/* feeder only: the next job in input order */
+static BatchJob *new_job(BatchPool *pool, const char *base_name) {
+    BatchJob *job = calloc(1, sizeof(BatchJob));
+    if (job) job->base_name = malloc(strlen(base_name) + 1);
+    if (!job || !job->base_name) {
+        fprintf(stderr, "%s: Error - out of memory, stopping the batch here\n", base_name);
+        free(job);
+        return NULL;
+    }
+    strcpy(job->base_name, base_name);
+    job->index = pool->queued++;
+    return job;
+}
+
+/* put job at the end of the list (waits while too many are pending) */
+static void append_job(BatchPool *pool, BatchJob *job) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending >= pool->max_pending)
+        pthread_cond_wait(&pool->changed, &pool->lock);
+    if (pool->tail) pool->tail->next = job;
+    else pool->head = job;
+    pool->tail = job;
+    /* an input error is done already: never hand it out as next_job (it can
+       be printed + freed any moment) */
+    if (!pool->next_job && !job->done) pool->next_job = job;
+    pool->pending++;
+    pthread_cond_broadcast(&pool->changed);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* NameCallback for the feeder: a job for a worker */
+static int enqueue_job(const char *base_name, void *context) {
+    BatchPool *pool = (BatchPool*)context;
+    BatchJob *job = new_job(pool, base_name);
+    if (!job) return FALSE;
+    append_job(pool, job);
+    return TRUE;
+}
+
+/* InputErrorCallback for the feeder: a job that already failed, its message
+   captured so print_in_order replays it in its spot */
+static int enqueue_input_error(const char *name, const char *message, void *context) {
+    BatchPool *pool = (BatchPool*)context;
+    BatchJob *job = new_job(pool, name);
+    if (!job) return FALSE;
+    OutputCapture *outer = capture_begin(&job->output);
+    report_input_error(pool->settings, job->index, name, message);
+    capture_end(outer);
+    job->ok = FALSE;
+    job->done = TRUE;
+    append_job(pool, job);
+    return TRUE;
+}
+
+/* feeder thread: walks manifests/dirs while the workers already assemble */
+static void *batch_feeder(void *arg) {
+    FeederArgs *feeder = (FeederArgs*)arg;
+    for_each_input_name(feeder->inputs, feeder->count, enqueue_job, enqueue_input_error, feeder->pool);
+
+    pthread_mutex_lock(&feeder->pool->lock);
+    feeder->pool->feeding_done = TRUE;
+    pthread_cond_broadcast(&feeder->pool->changed);
+    pthread_mutex_unlock(&feeder->pool->lock);
+    return NULL;
+}
+
+/* NameCallback for the old one-by-one loop (no threads, no capture) */
+static int assemble_now(const char *base_name, void *context) {
+    SerialContext *serial = (SerialContext*)context;
+    AssembleSettings file_settings = *serial->settings;
+    file_settings.input_index = serial->totals->files++;
+    if (!assemble_file(base_name, &file_settings, serial->arena)) serial->totals->failed++;
+    return TRUE;
+}
+
+/* InputErrorCallback for the serial loop: print it now, count it as failed */
+static int fail_now(const char *name, const char *message, void *context) {
+    SerialContext *serial = (SerialContext*)context;
+    report_input_error(serial->settings, serial->totals->files++, name, message);
+    serial->totals->failed++;
+    return TRUE;
+}
+
+static void run_serial(const BatchInput *inputs, int count, const AssembleSettings *settings,
+                       BatchTotals *totals) {
+    SerialContext serial;
+    serial.settings = settings;
+    serial.totals = totals;
+    serial.arena = asm_arena_create();
+    for_each_input_name(inputs, count, assemble_now, fail_now, &serial);
+    asm_arena_free(serial.arena);
+}
+
+/* print finished jobs in input order until the feeder is done and the list is empty */
+static void print_in_order(BatchPool *pool, BatchTotals *totals) {
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!(pool->head && pool->head->done) && !(pool->feeding_done && !pool->head))
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        BatchJob *job = pool->head;
+        if (!job) break;
+
+        pool->head = job->next;
+        if (!pool->head) pool->tail = NULL;
+        /* a done input error can still be next in line for the workers
+           (one came after it): move them past before its freed */
+        if (pool->next_job == job) pool->next_job = job->next;
+        pool->pending--;
+        pthread_cond_broadcast(&pool->changed); /* feeder may be waiting for room */
+        pthread_mutex_unlock(&pool->lock);
+
+        capture_flush(&job->output);
+        capture_free(&job->output);
+        totals->files++;
+        if (!job->ok) totals->failed++;
+        free(job->base_name);
+        free(job);
+
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void run_pool(const BatchInput *inputs, int count, int jobs, const AssembleSettings *settings,
+                     BatchTotals *totals) {
+    BatchPool pool;
+    FeederArgs feeder;
+    pthread_t feeder_thread;
+    pthread_t *threads = calloc((size_t)jobs, sizeof(pthread_t));
+    if (!threads) {
+        fprintf(stderr, "Error: failed to allocate worker pool, running serially\n");
+        run_serial(inputs, count, settings, totals);
+        return;
+    }
+
+    memset(&pool, 0, sizeof(pool));
+    pool.max_pending = jobs * PENDING_PER_WORKER;
+    pool.settings = settings;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.changed, NULL);
+
+    int started = 0;
+    int i;
+    for (i = 0; i < jobs; i++) {
+        if (pthread_create(&threads[i], NULL, batch_worker, &pool) != 0) break;
+        started++;
+    }
+
+    feeder.pool = &pool;
+    feeder.inputs = inputs;
+    feeder.count = count;
+    if (started == 0 || pthread_create(&feeder_thread, NULL, batch_feeder, &feeder) != 0) {
+        /* no threads at all?? stop the pool and just do it here */
+        pthread_mutex_lock(&pool.lock);
+        pool.feeding_done = TRUE;
+        pthread_cond_broadcast(&pool.changed);
+        pthread_mutex_unlock(&pool.lock);
+        for (i = 0; i < started; i++) pthread_join(threads[i], NULL);
+        pthread_cond_destroy(&pool.changed);
+        pthread_mutex_destroy(&pool.lock);
+        free(threads);
+        run_serial(inputs, count, settings, totals);
+        return;
+    }
+
+    print_in_order(&pool, totals);
+
+    pthread_join(feeder_thread, NULL);
+    for (i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    pthread_cond_destroy(&pool.changed);
+    pthread_mutex_destroy(&pool.lock);
+    free(threads);
+}
+
+int run_batch(const BatchInput *inputs, int count, int jobs, const AssembleSettings *settings) {
+    BatchTotals totals;
+    double started = monotonic_seconds();
+    memset(&totals, 0, sizeof(totals));
+
+    if (jobs <= 1) run_serial(inputs, count, settings, &totals);
+    else run_pool(inputs, count, jobs, settings, &totals);
+
+    /* stderr so it never mixes into --stdout frames */
+    fflush(stdout);
+    fprintf(stderr, "Summary: %d files, %d succeeded, %d failed in %.3f s\n",
+            totals.files, totals.files - totals.failed, totals.failed, monotonic_seconds() - started);
+    return totals.failed;
+}
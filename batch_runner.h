@@ -0,0 +1,22 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include "assembler.h"
+#include "batch_input.h"
+
+/*
+ * run_batch
+ * ---------
+ * Assembles every base name the inputs produce (names, @manifests, dirs).
+ *   - jobs <= 1 : plain serial loop (prints as it goes, like always)
+ *   - jobs  > 1 : a feeder thread reads manifests / walks dirs while a pool
+ *                 of workers assembles, each file's output is captured and
+ *                 printed grouped per file in the same order the names came
+ *   settings   : per-run options passed to every assemble_file (--emit-am, --cache)
+ * ends with a "Summary: N files, ..." line on stderr. an input that couldnt be
+ * read (missing manifest, unreadable dir, name too long) counts as a failed file.
+ * returns: how many files failed (inputs included).
+ */
+int run_batch(const BatchInput *inputs, int count, int jobs, const AssembleSettings *settings);
+
+#endif /* BATCH_RUNNER_H */
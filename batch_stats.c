@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "batch_stats.h"
+#include "util.h"
+
+#define STATS_INITIAL_CAPACITY 256
+
+typedef struct {
+    int input_index;   /* sort key of the per_file listing */
+    char *name;
+    int ok;
+    int cached;
+    int assembled;     /* FALSE = no stage ever ran (unreadable / cache hit) */
+    AsmStats stats;
+} FileStats;
+
+struct BatchStats {
+    FileStats *files;
+    int count;
+    int capacity;
+    pthread_mutex_t lock;
+};
+
+BatchStats *batch_stats_create(void) {
+    BatchStats *stats = calloc(1, sizeof(BatchStats));
+    if (!stats) return NULL;
+    pthread_mutex_init(&stats->lock, NULL);
+    return stats;
+}
+
+void batch_stats_free(BatchStats *stats) {
+    if (!stats) return;
+    int i;
+    for (i = 0; i < stats->count; i++) free(stats->files[i].name);
+    free(stats->files);
+    pthread_mutex_destroy(&stats->lock);
+    free(stats);
+}
+
+void batch_stats_record(BatchStats *stats, int input_index, const char *name, int ok, int cached,
+                        const AsmStats *file_stats) {
+    char *name_copy = malloc(strlen(name) + 1);
+    if (!name_copy) return; /* stats are best effort */
+    strcpy(name_copy, name);
+
+    pthread_mutex_lock(&stats->lock);
+    if (stats->count >= stats->capacity) {
+        int capacity = stats->capacity ? stats->capacity * GROWTH_FACTOR : STATS_INITIAL_CAPACITY;
+        FileStats *grown = realloc(stats->files, (size_t)capacity * sizeof(FileStats));
+        if (!grown) {
+            pthread_mutex_unlock(&stats->lock);
+            free(name_copy);
+            return;
+        }
+        stats->files = grown;
+        stats->capacity = capacity;
+    }
+
+    FileStats *f = &stats->files[stats->count++];
+    memset(f, 0, sizeof(*f));
+    f->input_index = input_index;
+    f->name = name_copy;
+    f->ok = ok;
+    f->cached = cached;
+    if (file_stats && !cached) {
+        f->stats = *file_stats;
+        f->assembled = TRUE;
+    }
+    pthread_mutex_unlock(&stats->lock);
+}
+
+/* ---------------- json output ---------------- */
+
+static void write_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* per_file in input order (workers record in whatever order they finish) */
+static int compare_input_index(const void *a, const void *b) {
+    int x = ((const FileStats *)a)->input_index, y = ((const FileStats *)b)->input_index;
+    return (x > y) - (x < y);
+}
+
+static int stage_skipped(const FileStats *f, int stage) {
+    return (f->stats.stages_skipped & (1u << stage)) != 0;
+}
+
+/* nearest-rank percentile of sorted values[0..n) */
+static double percentile(const double *values, int n, double q) {
+    if (n == 0) return 0.0;
+    int rank = (int)(q * n + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return values[rank - 1];
+}
+
+/* "name": {"files": n, "total": s, "p50": s, "p99": s, "max": s} for one stage */
+static void write_stage_summary(FILE *out, const BatchStats *stats, int stage, double *scratch) {
+    int n = 0;
+    double total = 0.0;
+    int i;
+    for (i = 0; i < stats->count; i++) {
+        const FileStats *f = &stats->files[i];
+        if (!f->assembled || f->stats.stages_run <= stage || stage_skipped(f, stage)) continue;
+        scratch[n++] = f->stats.stage_seconds[stage];
+        total += f->stats.stage_seconds[stage];
+    }
+    qsort(scratch, (size_t)n, sizeof(double), compare_doubles);
+
+    fprintf(out, "    \"%s\": {\"files\": %d, \"total\": %.9f, \"p50\": %.9f, \"p99\": %.9f, \"max\": %.9f}",
+            asm_stage_name(stage), n, total, percentile(scratch, n, 0.50),
+            percentile(scratch, n, 0.99), n ? scratch[n - 1] : 0.0);
+}
+
+static void write_file_entry(FILE *out, const FileStats *f) {
+    int i;
+    fprintf(out, "    {\"name\": ");
+    write_json_string(out, f->name);
+    fprintf(out, ", \"ok\": %s, \"cached\": %s", f->ok ? "true" : "false", f->cached ? "true" : "false");
+    if (f->assembled) {
+        fprintf(out, ", \"stages\": {");
+        for (i = 0; i < f->stats.stages_run; i++) {
+            fprintf(out, "%s\"%s\": ", i ? ", " : "", asm_stage_name(i));
+            if (stage_skipped(f, i)) fprintf(out, "\"skipped\"");
+            else fprintf(out, "%.9f", f->stats.stage_seconds[i]);
+        }
+        fprintf(out, "}, \"counters\": {");
+        for (i = 0; i < ASM_COUNTER_COUNT; i++) {
+            fprintf(out, "%s\"%s\": %lu", i ? ", " : "", asm_counter_name(i), f->stats.counters[i]);
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "}");
+}
+
+int batch_stats_write_json(BatchStats *stats, const char *path, double wall_seconds) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "%s: Error - cannot write stats file\n", path);
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&stats->lock);
+    qsort(stats->files, (size_t)stats->count, sizeof(FileStats), compare_input_index);
+    int ok_files = 0, cached = 0;
+    unsigned long counters[ASM_COUNTER_COUNT];
+    int i, j;
+    memset(counters, 0, sizeof(counters));
+    for (i = 0; i < stats->count; i++) {
+        if (stats->files[i].ok) ok_files++;
+        if (stats->files[i].cached) cached++;
+        for (j = 0; j < ASM_COUNTER_COUNT; j++) counters[j] += stats->files[i].stats.counters[j];
+    }
+
+    fprintf(out, "{\n  \"version\": \"%s\",\n", LIBASM_VERSION);
+    fprintf(out, "  \"files\": %d,\n  \"succeeded\": %d,\n  \"failed\": %d,\n  \"cached\": %d,\n",
+            stats->count, ok_files, stats->count - ok_files, cached);
+    fprintf(out, "  \"wall_seconds\": %.6f,\n", wall_seconds);
+
+    double *scratch = malloc((size_t)(stats->count ? stats->count : 1) * sizeof(double));
+    fprintf(out, "  \"stages\": {\n");
+    for (i = 0; scratch && i < ASM_STAGE_COUNT; i++) {
+        write_stage_summary(out, stats, i, scratch);
+        fprintf(out, "%s\n", i + 1 < ASM_STAGE_COUNT ? "," : "");
+    }
+    free(scratch);
+    fprintf(out, "  },\n  \"counters\": {\n");
+    for (i = 0; i < ASM_COUNTER_COUNT; i++) {
+        fprintf(out, "    \"%s\": %lu%s\n", asm_counter_name(i), counters[i], i + 1 < ASM_COUNTER_COUNT ? "," : "");
+    }
+    fprintf(out, "  },\n  \"per_file\": [\n");
+    for (i = 0; i < stats->count; i++) {
+        write_file_entry(out, &stats->files[i]);
+        fprintf(out, "%s\n", i + 1 < stats->count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    pthread_mutex_unlock(&stats->lock);
+
+    int ok = !ferror(out);
+    if (fclose(out) != 0) ok = FALSE;
+    if (!ok) fprintf(stderr, "%s: Error - cannot write stats file\n", path);
+    return ok;
+}
@@ -0,0 +1,31 @@
+#ifndef BATCH_STATS_H
+#define BATCH_STATS_H
+
+#include "libasm.h"
+
+/*
+ * batch_stats.h
+ * -------------
+ * --stats FILE: collects every file's AsmStats during a batch (thread safe)
+ * and writes one json report at the end:
+ *   totals, per-stage total/p50/p99/max across files, summed hot-call
+ *   counters, and one entry per file (in input order, same as the printed
+ *   output, whatever order the workers finished them in).
+ * Files served from --cache or that couldnt be read have no stage times.
+ * A stage the file didnt need (second pass of a complete --one-pass) is
+ * written as "skipped" and left out of that stage's summary.
+ */
+typedef struct BatchStats BatchStats;
+
+BatchStats *batch_stats_create(void);
+void batch_stats_free(BatchStats *stats);
+
+/* input_index = the file's place in the batch (0 = first input).
+   stats NULL = file never got to the pipeline (unreadable) */
+void batch_stats_record(BatchStats *stats, int input_index, const char *name, int ok, int cached,
+                        const AsmStats *file_stats);
+
+/* FALSE (+ msg) if the report couldnt be written */
+int batch_stats_write_json(BatchStats *stats, const char *path, double wall_seconds);
+
+#endif /* BATCH_STATS_H */
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "libasm.h"
+#include "program_gen.h"
+#include "util.h"
+
+/*
+ * asm_bench
+ * ---------
+ * End-to-end throughput of the in-memory assembler on generated programs.
+ * Every shape is swept over a few sizes; each point assembles a handful of
+ * programs (different seeds) over and over for --min-time seconds and reports
+ * files/s + lines/s per stage (from AsmStats) and the peak RSS so far.
+ * "asm_assemble" is the whole call (stages + setup/teardown between them).
+ * The timed calls reuse one AsmArena like a batch worker does, unless
+ * --no-arena (then every call allocates its own). --one-pass times the
+ * backpatching single pass instead of the two passes.
+ *   asm_bench [--quick] [--min-time S] [--shape NAME] [--csv] [--no-arena] [--one-pass]
+ */
+
+#define PROGRAMS_PER_POINT 8
+#define MAX_POINTS 8
+
+typedef struct {
+    const char *name;
+    const char *knob;           /* what the sweep changes */
+    int sizes[MAX_POINTS];      /* 0 ends the list */
+    int quick_points;           /* how many of them --quick runs */
+} Shape;
+
+static const Shape shapes[] = {
+    {"typical",  "words",   {250, 0},                                    1},
+    {"labels",   "externs", {250, 500, 1000, 2000, 4000, 8000, 0},       3},
+    {"macros",   "macros",  {50, 100, 200, 400, 800, 1600, 0},           3},
+    {"padding",  "lines",   {1000, 4000, 16000, 64000, 0},               2},
+};
+
+typedef struct {
+    char *text[PROGRAMS_PER_POINT];
+    size_t size[PROGRAMS_PER_POINT];
+    int lines[PROGRAMS_PER_POINT];
+} PointPrograms;
+
+/* params for one point of a shape */
+static void shape_params(const Shape *shape, int size, unsigned int seed, GenParams *params) {
+    gen_default_params(params);
+    params->seed = seed;
+    if (strcmp(shape->name, "labels") == 0) {
+        params->externs = size;
+    } else if (strcmp(shape->name, "macros") == 0) {
+        params->macros = size;
+        params->comment_macros = TRUE;
+    } else if (strcmp(shape->name, "padding") == 0) {
+        params->padding_lines = size;
+    } else {
+        params->words = size;
+    }
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss; /* kilobytes on linux */
+}
+
+static void print_point(const Shape *shape, int size, int csv, int average_lines,
+                        long files, const double *stage_seconds, double call_seconds) {
+    double total = 0;
+    int stage;
+    for (stage = 0; stage < ASM_STAGE_COUNT; stage++) total += stage_seconds[stage];
+
+    if (!csv) {
+        printf("%s %s=%d  (%d lines/file, %ld files, peak rss %ld KB)\n",
+               shape->name, shape->knob, size, average_lines, files, peak_rss_kb());
+        printf("  %-14s %12s %14s %10s\n", "stage", "files/s", "lines/s", "us/file");
+    }
+
+    for (stage = 0; stage <= ASM_STAGE_COUNT + 1; stage++) {
+        double seconds = (stage < ASM_STAGE_COUNT) ? stage_seconds[stage]
+                       : (stage == ASM_STAGE_COUNT) ? total : call_seconds;
+        const char *name = (stage < ASM_STAGE_COUNT) ? asm_stage_name(stage)
+                         : (stage == ASM_STAGE_COUNT) ? "total" : "asm_assemble";
+        double files_per_sec = seconds > 0 ? files / seconds : 0;
+        double lines_per_sec = files_per_sec * average_lines;
+        double us_per_file = files > 0 ? seconds * 1e6 / files : 0;
+
+        if (csv)
+            printf("%s,%s,%d,%d,%s,%.0f,%.0f,%.2f,%ld\n", shape->name, shape->knob, size, average_lines,
+                   name, files_per_sec, lines_per_sec, us_per_file, peak_rss_kb());
+        else
+            printf("  %-14s %12.0f %14.0f %10.2f\n", name, files_per_sec, lines_per_sec, us_per_file);
+    }
+    if (!csv) printf("\n");
+    fflush(stdout);
+}
+
+/* generate, check they assemble, then time them. FALSE if something broke */
+static int run_point(const Shape *shape, int size, double min_time, int csv, int use_arena,
+                     int one_pass) {
+    PointPrograms programs;
+    AsmOptions options;
+    double stage_seconds[ASM_STAGE_COUNT];
+    long files = 0;
+    int total_lines = 0;
+    int ok = TRUE;
+    int i;
+
+    memset(&programs, 0, sizeof(programs));
+    memset(stage_seconds, 0, sizeof(stage_seconds));
+
+    for (i = 0; i < PROGRAMS_PER_POINT; i++) {
+        GenParams params;
+        shape_params(shape, size, (unsigned int)(i + 1), &params);
+        programs.text[i] = gen_program(&params, &programs.size[i], &programs.lines[i]);
+        if (!programs.text[i]) {
+            fprintf(stderr, "asm_bench: out of memory generating %s %d\n", shape->name, size);
+            ok = FALSE;
+            goto done;
+        }
+        total_lines += programs.lines[i];
+    }
+
+    /* a generated program that doesnt compile would time the error path, not the real one */
+    for (i = 0; i < PROGRAMS_PER_POINT; i++) {
+        AsmResult result;
+        if (!asm_assemble(programs.text[i], programs.size[i], "bench", NULL, &result)) {
+            fprintf(stderr, "asm_bench: warning - %s %s=%d seed %d does not assemble (%d errors)\n",
+                    shape->name, shape->knob, size, i + 1, result.diagnostic_count);
+            if (result.diagnostic_count > 0)
+                fprintf(stderr, "  first: line %d: %s\n", result.diagnostics[0].line,
+                        result.diagnostics[0].message);
+            ok = FALSE;
+        }
+        asm_free_result(&result);
+    }
+
+    memset(&options, 0, sizeof(options));
+    options.arena = use_arena ? asm_arena_create() : NULL;
+    options.one_pass = one_pass;
+    double started = monotonic_seconds();
+    do {
+        for (i = 0; i < PROGRAMS_PER_POINT; i++) {
+            AsmResult result;
+            int stage;
+            asm_assemble(programs.text[i], programs.size[i], "bench", &options, &result);
+            for (stage = 0; stage < ASM_STAGE_COUNT; stage++)
+                stage_seconds[stage] += result.stats.stage_seconds[stage];
+            asm_free_result(&result);
+            files++;
+        }
+    } while (monotonic_seconds() - started < min_time);
+    double call_seconds = monotonic_seconds() - started;
+    asm_arena_free(options.arena);
+
+    print_point(shape, size, csv, total_lines / PROGRAMS_PER_POINT, files, stage_seconds, call_seconds);
+
+done:
+    for (i = 0; i < PROGRAMS_PER_POINT; i++) free(programs.text[i]);
+    return ok;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--quick] [--min-time SECONDS] [--shape typical|labels|macros|padding] [--csv] [--no-arena] [--one-pass]\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    double min_time = 0.5;
+    int quick = FALSE;
+    int csv = FALSE;
+    int use_arena = TRUE;
+    int one_pass = FALSE;
+    const char *only_shape = NULL;
+    int failures = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = TRUE;
+            min_time = 0.1;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = TRUE;
+        } else if (strcmp(argv[i], "--no-arena") == 0) {
+            use_arena = FALSE;
+        } else if (strcmp(argv[i], "--one-pass") == 0) {
+            one_pass = TRUE;
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--shape") == 0 && i + 1 < argc) {
+            only_shape = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (csv) printf("shape,knob,size,lines_per_file,stage,files_per_sec,lines_per_sec,us_per_file,peak_rss_kb\n");
+
+    int shape_count = (int)(sizeof(shapes) / sizeof(shapes[0]));
+    int found = FALSE;
+    for (i = 0; i < shape_count; i++) {
+        const Shape *shape = &shapes[i];
+        int point;
+        if (only_shape && strcmp(only_shape, shape->name) != 0) continue;
+        found = TRUE;
+        for (point = 0; point < MAX_POINTS && shape->sizes[point] != 0; point++) {
+            if (quick && point >= shape->quick_points) break;
+            if (!run_point(shape, shape->sizes[point], min_time, csv, use_arena, one_pass)) failures++;
+        }
+    }
+
+    if (!found) {
+        fprintf(stderr, "asm_bench: unknown shape %s\n", only_shape);
+        usage(argv[0]);
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
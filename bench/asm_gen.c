@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "program_gen.h"
+
+/*
+ * asm_gen
+ * -------
+ * Writes synthetic .as programs (see program_gen.h for what the knobs mean).
+ *   asm_gen [options] > foo.as
+ *   asm_gen [options] --files 1000 -o dir/gen    (dir/gen0.as ... seeds seed+i)
+ */
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options] [-o BASE] [--files N]\n"
+            "  --seed N            random seed (default 1)\n"
+            "  --words N           word budget, max 255 (default 250)\n"
+            "  --data-percent N    share of words for .data/.string/.mat (30)\n"
+            "  --label-percent N   instructions with a label (30)\n"
+            "  --entry-percent N   code labels also .entry (20)\n"
+            "  --macros N          macros defined (4)\n"
+            "  --macro-body N      lines per macro (3)\n"
+            "  --macro-calls N     calls per macro (1)\n"
+            "  --comment-macros    macro bodies are comments (cost no words)\n"
+            "  --externs N         .extern declarations (4)\n"
+            "  --padding N         comment/blank lines spread over the file (0)\n"
+            "  --data-mix D,S,M    weights of .data/.string/.mat (3,1,1)\n"
+            "  --operand-mix I,D,M,R  weights of immediate/direct/matrix/register (1,2,1,2)\n",
+            prog);
+}
+
+/* "a,b,c" into up to n ints (FALSE if it doesnt have exactly n) */
+static int parse_list(const char *text, int *values, int n) {
+    int i;
+    for (i = 0; i < n; i++) {
+        char *end;
+        values[i] = (int)strtol(text, &end, 10);
+        if (end == text) return 0;
+        text = end;
+        if (i + 1 < n) {
+            if (*text != ',') return 0;
+            text++;
+        }
+    }
+    return *text == '\0';
+}
+
+static int write_program(const GenParams *params, FILE *out) {
+    size_t size;
+    int lines;
+    char *text = gen_program(params, &size, &lines);
+    if (!text) {
+        fprintf(stderr, "asm_gen: out of memory\n");
+        return 0;
+    }
+    fwrite(text, 1, size, out);
+    free(text);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    GenParams params;
+    const char *out_base = NULL;
+    int files = 0;
+    int i;
+
+    gen_default_params(&params);
+
+    for (i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        int values[4];
+        int *target = NULL;
+
+        if (strcmp(arg, "--comment-macros") == 0) { params.comment_macros = 1; continue; }
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) { usage(argv[0]); return 0; }
+        if (!value) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        if (strcmp(arg, "-o") == 0) out_base = value;
+        else if (strcmp(arg, "--files") == 0) target = &files;
+        else if (strcmp(arg, "--seed") == 0) params.seed = (unsigned int)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--words") == 0) target = &params.words;
+        else if (strcmp(arg, "--data-percent") == 0) target = &params.data_percent;
+        else if (strcmp(arg, "--label-percent") == 0) target = &params.label_percent;
+        else if (strcmp(arg, "--entry-percent") == 0) target = &params.entry_percent;
+        else if (strcmp(arg, "--macros") == 0) target = &params.macros;
+        else if (strcmp(arg, "--macro-body") == 0) target = &params.macro_body;
+        else if (strcmp(arg, "--macro-calls") == 0) target = &params.macro_calls;
+        else if (strcmp(arg, "--externs") == 0) target = &params.externs;
+        else if (strcmp(arg, "--padding") == 0) target = &params.padding_lines;
+        else if (strcmp(arg, "--data-mix") == 0) {
+            if (!parse_list(value, values, 3)) { usage(argv[0]); return 1; }
+            params.data_weight = values[0];
+            params.string_weight = values[1];
+            params.mat_weight = values[2];
+        } else if (strcmp(arg, "--operand-mix") == 0) {
+            if (!parse_list(value, values, 4)) { usage(argv[0]); return 1; }
+            params.immediate_weight = values[0];
+            params.direct_weight = values[1];
+            params.matrix_weight = values[2];
+            params.register_weight = values[3];
+        } else {
+            fprintf(stderr, "asm_gen: unknown option %s\n", arg);
+            usage(argv[0]);
+            return 1;
+        }
+
+        if (target) *target = atoi(value);
+        i++;
+    }
+
+    /* single program to stdout or BASE.as */
+    if (files <= 0) {
+        FILE *out = stdout;
+        char path[4096];
+        if (out_base) {
+            snprintf(path, sizeof(path), "%s.as", out_base);
+            out = fopen(path, "w");
+            if (!out) {
+                perror(path);
+                return 1;
+            }
+        }
+        int ok = write_program(&params, out);
+        if (out != stdout) fclose(out);
+        return ok ? 0 : 1;
+    }
+
+    /* many programs: BASE0.as, BASE1.as ... (one seed each) */
+    if (!out_base) {
+        fprintf(stderr, "asm_gen: --files needs -o BASE\n");
+        return 1;
+    }
+    unsigned int first_seed = params.seed;
+    for (i = 0; i < files; i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s%d.as", out_base, i);
+        FILE *out = fopen(path, "w");
+        if (!out) {
+            perror(path);
+            return 1;
+        }
+        params.seed = first_seed + (unsigned int)i;
+        int ok = write_program(&params, out);
+        fclose(out);
+        if (!ok) return 1;
+    }
+    return 0;
+}
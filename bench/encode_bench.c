@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libasm.h"
+#include "table.h"
+#include "labels.h"
+#include "binary_table_parsing.h"
+#include "util.h"
+
+/*
+ * encode_bench
+ * ------------
+ * Pass two alone (parse_table_to_binary) on made up tables way past the 255
+ * word cap, one thread vs the task pool, to see from what size the pool
+ * pays off on this machine (that size is what ASM_PARALLEL_MIN_ROWS should
+ * be). Checks both ways give the same words too.
+ *   encode_bench [--threads N] [--min-time S]
+ */
+
+static const int sizes[] = {256, 512, 1024, 2048, 4096, 8192, 16384, 65536, 262144, 0};
+
+/* rows roughly like a real program: symbols, immediates, registers, pairs */
+static void fill_table(Table *tbl, Labels *lbls, int rows) {
+    char label[MAX_LABEL_LEN];
+    char operands[64];
+    int line = 1;
+
+    while (tbl->size + 3 <= rows) {
+        int kind = line % 3;
+        snprintf(label, sizeof(label), "L%d", line);
+        if (kind == 0) {
+            add_label_row(lbls, label, tbl->size, CODE, FALSE, line, "bench");
+            snprintf(operands, sizeof(operands), "%s, r3", label);
+            add_row(tbl, label, MOV, TRUE, operands, 0, (unsigned int)line);
+            add_row(tbl, EMPTY_STRING, MOV, FALSE, label, 1, (unsigned int)line);
+            add_row(tbl, EMPTY_STRING, MOV, FALSE, "r3", 2, (unsigned int)line);
+        } else if (kind == 1) {
+            add_row(tbl, EMPTY_STRING, ADD, TRUE, "#5, r2", 0, (unsigned int)line);
+            add_row(tbl, EMPTY_STRING, ADD, FALSE, "#5", 1, (unsigned int)line);
+            add_row(tbl, EMPTY_STRING, ADD, FALSE, "r2", 2, (unsigned int)line);
+        } else {
+            add_row(tbl, EMPTY_STRING, CMP, TRUE, "r1, r2", 0, (unsigned int)line);
+            add_row(tbl, EMPTY_STRING, CMP, FALSE, "r1, r2", 1, (unsigned int)line);
+        }
+        line++;
+    }
+
+    int i;
+    for (i = 0; i < tbl->size; i++) {
+        describe_row(tbl, i);
+        if (tbl->operand[i].kind == OPERAND_SYMBOL) link_symbol_row(tbl, lbls, i);
+    }
+    reset_addresses(tbl, BASE_ADDRESS);
+    reset_labels_addresses(lbls, BASE_ADDRESS);
+}
+
+/* seconds per parse_table_to_binary */
+static double time_pass(Table *tbl, Labels *lbls, int parallel_rows, double min_time) {
+    double started = monotonic_seconds();
+    double elapsed;
+    long passes = 0;
+
+    tbl->parallel_rows = parallel_rows;
+    do {
+        parse_table_to_binary(tbl, lbls, "bench");
+        passes++;
+        elapsed = monotonic_seconds() - started;
+    } while (elapsed < min_time);
+    return elapsed / passes;
+}
+
+int main(int argc, char *argv[]) {
+    double min_time = 0.2;
+    int threads = 0;
+    int crossover = 0;
+    int failures = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--threads N] [--min-time SECONDS]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    threads = asm_parallel_threads(threads);
+    printf("pool threads: %d (+ the caller)\n", threads);
+    printf("%10s %14s %14s %8s\n", "rows", "serial us", "pool us", "speedup");
+
+    for (i = 0; sizes[i] != 0; i++) {
+        Table *tbl = create_table(NULL, sizes[i]);
+        Labels *lbls = create_label_table(NULL);
+        if (!tbl || !lbls) {
+            fprintf(stderr, "encode_bench: out of memory at %d rows\n", sizes[i]);
+            return 1;
+        }
+        fill_table(tbl, lbls, sizes[i]);
+
+        double serial = time_pass(tbl, lbls, 0, min_time);
+        unsigned short *words = malloc((size_t)tbl->size * sizeof(unsigned short));
+        if (words) memcpy(words, tbl->code, (size_t)tbl->size * sizeof(unsigned short));
+        memset(tbl->code, 0, (size_t)tbl->size * sizeof(unsigned short));
+
+        double pooled = time_pass(tbl, lbls, 1, min_time);
+        if (words && memcmp(words, tbl->code, (size_t)tbl->size * sizeof(unsigned short)) != 0) {
+            fprintf(stderr, "encode_bench: pool and serial words differ at %d rows\n", sizes[i]);
+            failures++;
+        }
+
+        printf("%10d %14.2f %14.2f %7.2fx\n", tbl->size, serial * 1e6, pooled * 1e6, serial / pooled);
+        /* crossover = from here on the pool keeps winning (by more than noise) */
+        if (pooled < serial * 0.95) {
+            if (!crossover) crossover = tbl->size;
+        } else {
+            crossover = 0;
+        }
+
+        free(words);
+        free_table(tbl);
+        free_label_table(lbls);
+    }
+
+    if (crossover)
+        printf("crossover: the pool is faster from ~%d rows\n", crossover);
+    else
+        printf("crossover: none (the pool never beat one thread here)\n");
+    return failures ? 1 : 0;
+}
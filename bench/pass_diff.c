@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libasm.h"
+#include "program_gen.h"
+#include "util.h"
+
+/*
+ * pass_diff
+ * ---------
+ * Differential check of --one-pass against the normal two passes: every
+ * program is assembled both ways and everything a caller can see has to
+ * match byte for byte (success, .ob/.ent/.ext, the printed messages and the
+ * diagnostics).
+ * The corpus is generated programs (a few shapes, many seeds) plus broken
+ * copies of each one: lines swapped (labels after their uses, the case the
+ * backpatching is for), dropped (undefined labels), doubled (labels defined
+ * twice) or with a char changed (bad operands). Any .as files on the command
+ * line are checked too. The first few mismatches get their source saved as
+ * pass_diff_<n>.as.
+ *   pass_diff [--seeds N] [--variants N] [file.as ...]
+ */
+
+#define SAVED_MISMATCHES 5
+#define MAX_PIECES 4096
+
+/* the same corpus every run (no rand(), its state differs between libcs) */
+static unsigned int next_random(unsigned int *state) {
+    *state = *state * 1103515245u + 12345u;
+    return (*state >> 16) & 0x7FFF;
+}
+
+/* params for seed: every shape the generator has, a bit of each mixed in */
+static void corpus_params(unsigned int seed, GenParams *params) {
+    unsigned int state = seed;
+    gen_default_params(params);
+    params->seed = seed;
+    params->words = 20 + (int)(next_random(&state) % 236);
+    params->label_percent = (int)(next_random(&state) % 101);
+    params->entry_percent = (int)(next_random(&state) % 101);
+    params->data_percent = (int)(next_random(&state) % 60);
+    params->externs = (int)(next_random(&state) % 4) == 0 ? (int)(next_random(&state) % 300) : 0;
+    params->macros = (int)(next_random(&state) % 6);
+    params->comment_macros = (int)(next_random(&state) % 2);
+    params->padding_lines = (int)(next_random(&state) % 50);
+}
+
+/* one random edit somewhere in text (one line = one '\n' terminated piece) */
+static char *mutate(const char *text, size_t size, unsigned int *state, size_t *new_size) {
+    const char *lines[MAX_PIECES];
+    size_t lengths[MAX_PIECES];
+    int count = 0;
+    size_t at = 0;
+
+    while (at < size) {
+        /* past MAX_PIECES the rest is one big piece */
+        const char *end = count < MAX_PIECES - 1 ? memchr(text + at, '\n', size - at) : NULL;
+        size_t length = end ? (size_t)(end - (text + at)) + 1 : size - at;
+        lines[count] = text + at;
+        lengths[count] = length;
+        count++;
+        at += length;
+    }
+    if (count < 2) return NULL;
+
+    char *out = malloc(size * 2 + 2);
+    if (!out) return NULL;
+    int a = (int)(next_random(state) % (unsigned int)count);
+    int b = (int)(next_random(state) % (unsigned int)count);
+    int kind = (int)(next_random(state) % 4);
+    size_t used = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        int from = i;
+        if (kind == 0 && i == a) from = b;      /* swap a and b */
+        else if (kind == 0 && i == b) from = a;
+        if (kind == 1 && i == a) continue;      /* drop a */
+
+        memcpy(out + used, lines[from], lengths[from]);
+        if (kind == 3 && i == a && lengths[from] > 1) {
+            /* change a char (to something that means something to the parser) */
+            static const char replacements[] = "#,[]r9:X ";
+            out[used + next_random(state) % (lengths[from] - 1)] =
+                replacements[next_random(state) % (sizeof(replacements) - 1)];
+        }
+        used += lengths[from];
+        if (lengths[from] && lines[from][lengths[from] - 1] != '\n') out[used++] = '\n';
+
+        if (kind == 2 && i == a) {              /* double a */
+            memcpy(out + used, lines[from], lengths[from]);
+            used += lengths[from];
+            if (lengths[from] && lines[from][lengths[from] - 1] != '\n') out[used++] = '\n';
+        }
+    }
+    *new_size = used;
+    return out;
+}
+
+static int same_bytes(const char *a, size_t a_size, const char *b, size_t b_size) {
+    return a_size == b_size && (a_size == 0 || memcmp(a, b, a_size) == 0);
+}
+
+/* NULL if both results match, else what differs first */
+static const char *compare_results(const AsmResult *two, const AsmResult *one) {
+    int i;
+    if (two->success != one->success) return "success";
+    if (!same_bytes(two->object, two->object_size, one->object, one->object_size)) return ".ob";
+    if (!same_bytes(two->entries, two->entries_size, one->entries, one->entries_size)) return ".ent";
+    if (!same_bytes(two->externals, two->externals_size, one->externals, one->externals_size))
+        return ".ext";
+
+    if (two->message_count != one->message_count) return "message count";
+    for (i = 0; i < two->message_count; i++) {
+        if (two->messages[i].is_error != one->messages[i].is_error ||
+            !same_bytes(two->messages[i].text, two->messages[i].size,
+                        one->messages[i].text, one->messages[i].size))
+            return "messages";
+    }
+
+    if (two->diagnostic_count != one->diagnostic_count) return "diagnostic count";
+    for (i = 0; i < two->diagnostic_count; i++) {
+        if (two->diagnostics[i].line != one->diagnostics[i].line ||
+            strcmp(two->diagnostics[i].message, one->diagnostics[i].message) != 0)
+            return "diagnostics";
+    }
+    return NULL;
+}
+
+typedef struct {
+    long programs;
+    long failing;       /* programs that (both ways) didnt assemble */
+    long mismatches;
+    AsmArena *arena;
+} DiffTotals;
+
+/* assemble text both ways, TRUE if they match (a mismatch gets reported) */
+static int check_program(const char *text, size_t size, const char *what, DiffTotals *totals) {
+    AsmOptions options;
+    AsmResult two_pass;
+    AsmResult one_pass;
+
+    memset(&options, 0, sizeof(options));
+    options.arena = totals->arena;
+    asm_assemble(text, size, "diff", &options, &two_pass);
+    options.one_pass = TRUE;
+    asm_assemble(text, size, "diff", &options, &one_pass);
+
+    const char *differs = compare_results(&two_pass, &one_pass);
+    totals->programs++;
+    if (!two_pass.success) totals->failing++;
+    if (differs) {
+        totals->mismatches++;
+        fprintf(stderr, "pass_diff: %s: %s differ", what, differs);
+        if (totals->mismatches <= SAVED_MISMATCHES) {
+            char path[64];
+            snprintf(path, sizeof(path), "pass_diff_%ld.as", totals->mismatches);
+            FILE *fp = fopen(path, "w");
+            if (fp) {
+                fwrite(text, 1, size, fp);
+                fclose(fp);
+                fprintf(stderr, " (saved as %s)", path);
+            }
+        }
+        fprintf(stderr, "\n");
+    }
+
+    asm_free_result(&two_pass);
+    asm_free_result(&one_pass);
+    return differs == NULL;
+}
+
+/* whole file into memory (NULL if it cant be read) */
+static char *read_file(const char *path, size_t *size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *text = malloc(length > 0 ? (size_t)length : 1);
+    if (text && length > 0 && fread(text, 1, (size_t)length, fp) != (size_t)length) {
+        free(text);
+        text = NULL;
+    }
+    fclose(fp);
+    *size = length > 0 ? (size_t)length : 0;
+    return text;
+}
+
+/* the source and variants broken copies of it */
+static void check_with_variants(const char *text, size_t size, const char *name, int variants,
+                                unsigned int seed, DiffTotals *totals) {
+    char what[256];
+    unsigned int state = seed * 2654435761u + 1;
+    int v;
+
+    check_program(text, size, name, totals);
+    for (v = 1; v <= variants; v++) {
+        /* 1-3 edits on top of each other */
+        int edits = 1 + (int)(next_random(&state) % 3);
+        char *current = NULL;
+        size_t current_size = size;
+        int e;
+        for (e = 0; e < edits; e++) {
+            size_t new_size = 0;
+            char *next = mutate(current ? current : text, current_size, &state, &new_size);
+            if (!next) break;
+            free(current);
+            current = next;
+            current_size = new_size;
+        }
+        if (!current) continue;
+        snprintf(what, sizeof(what), "%s variant %d", name, v);
+        check_program(current, current_size, what, totals);
+        free(current);
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--seeds N] [--variants N] [file.as ...]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    int seeds = 500;
+    int variants = 20;
+    DiffTotals totals;
+    int i;
+
+    memset(&totals, 0, sizeof(totals));
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strcmp(argv[i], "--seeds") == 0 && i + 1 < argc) {
+            seeds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--variants") == 0 && i + 1 < argc) {
+            variants = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    totals.arena = asm_arena_create();
+    for (; i < argc; i++) {
+        size_t size = 0;
+        char *text = read_file(argv[i], &size);
+        if (!text) {
+            fprintf(stderr, "pass_diff: cannot read %s\n", argv[i]);
+            continue;
+        }
+        check_with_variants(text, size, argv[i], variants, (unsigned int)i, &totals);
+        free(text);
+    }
+
+    for (i = 1; i <= seeds; i++) {
+        GenParams params;
+        char name[32];
+        size_t size = 0;
+        int lines = 0;
+        corpus_params((unsigned int)i, &params);
+        char *text = gen_program(&params, &size, &lines);
+        if (!text) {
+            fprintf(stderr, "pass_diff: out of memory generating seed %d\n", i);
+            break;
+        }
+        snprintf(name, sizeof(name), "seed %d", i);
+        check_with_variants(text, size, name, variants, (unsigned int)i, &totals);
+        free(text);
+    }
+    asm_arena_free(totals.arena);
+
+    printf("pass_diff: %ld programs (%ld with errors), %ld mismatches\n",
+           totals.programs, totals.failing, totals.mismatches);
+    return totals.mismatches ? 1 : 0;
+}
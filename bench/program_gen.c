@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "program_gen.h"
+
+#define GEN_TRUE 1
+#define GEN_FALSE 0
+
+#define MAX_PROGRAM_WORDS 255
+#define MAX_INSTRUCTION_WORDS 5   /* opcode + matrix (2) + matrix (2) */
+#define GEN_LINE_LEN 96
+
+/* addressing modes as bits (so each opcode lists what it accepts) */
+#define MODE_IMMEDIATE 1
+#define MODE_DIRECT    2
+#define MODE_MATRIX    4
+#define MODE_REGISTER  8
+#define MODE_ANY  (MODE_IMMEDIATE | MODE_DIRECT | MODE_MATRIX | MODE_REGISTER)
+#define MODE_DEST (MODE_DIRECT | MODE_MATRIX | MODE_REGISTER)
+
+typedef struct {
+    const char *name;
+    int operands;
+    int src_modes;
+    int dst_modes;
+} GenOpcode;
+
+static const GenOpcode opcodes[] = {
+    {"mov", 2, MODE_ANY, MODE_DEST},
+    {"cmp", 2, MODE_ANY, MODE_ANY},
+    {"add", 2, MODE_ANY, MODE_DEST},
+    {"sub", 2, MODE_ANY, MODE_DEST},
+    {"lea", 2, MODE_DIRECT | MODE_MATRIX, MODE_DEST},
+    {"not", 1, 0, MODE_DEST},
+    {"clr", 1, 0, MODE_DEST},
+    {"inc", 1, 0, MODE_DEST},
+    {"dec", 1, 0, MODE_DEST},
+    {"jmp", 1, 0, MODE_DIRECT},
+    {"bne", 1, 0, MODE_DIRECT},
+    {"red", 1, 0, MODE_DEST},
+    {"prn", 1, 0, MODE_ANY},
+    {"jsr", 1, 0, MODE_DIRECT},
+    {"rts", 0, 0, 0}
+};
+#define OPCODE_COUNT ((int)(sizeof(opcodes) / sizeof(opcodes[0])))
+
+/* one output line (padding only goes after lines that allow it) */
+typedef struct {
+    char *text;
+    int paddable;
+} GenLine;
+
+typedef struct {
+    const GenParams *params;
+    unsigned int rng;
+    GenLine *lines;
+    int line_count;
+    int line_capacity;
+    int failed;            /* out of memory somewhere */
+
+    int data_labels;       /* D0.. (.data / .string) */
+    int mat_labels;        /* M0.. (.mat) */
+    int code_labels;       /* L0.. */
+} Gen;
+
+void gen_default_params(GenParams *params) {
+    memset(params, 0, sizeof(*params));
+    params->seed = 1;
+    params->words = 250;
+    params->data_percent = 30;
+    params->label_percent = 30;
+    params->entry_percent = 20;
+    params->macros = 4;
+    params->macro_body = 3;
+    params->macro_calls = 1;
+    params->externs = 4;
+    params->data_weight = 3;
+    params->string_weight = 1;
+    params->mat_weight = 1;
+    params->immediate_weight = 1;
+    params->direct_weight = 2;
+    params->matrix_weight = 1;
+    params->register_weight = 2;
+}
+
+/* xorshift32 (tiny, good enough, same sequence everywhere) */
+static unsigned int next_random(Gen *g) {
+    unsigned int x = g->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    g->rng = x;
+    return x;
+}
+
+static int random_below(Gen *g, int n) {
+    return n > 0 ? (int)(next_random(g) % (unsigned int)n) : 0;
+}
+
+static int random_between(Gen *g, int low, int high) {
+    return low + random_below(g, high - low + 1);
+}
+
+/* pick index i with chance weights[i] / sum (-1 if all weights are 0) */
+static int pick_weighted(Gen *g, const int *weights, int count) {
+    int total = 0, i;
+    for (i = 0; i < count; i++) total += weights[i] > 0 ? weights[i] : 0;
+    if (total == 0) return -1;
+    int r = random_below(g, total);
+    for (i = 0; i < count; i++) {
+        if (weights[i] <= 0) continue;
+        if (r < weights[i]) return i;
+        r -= weights[i];
+    }
+    return count - 1;
+}
+
+static void add_line(Gen *g, int paddable, const char *fmt, ...) {
+    char buf[GEN_LINE_LEN];
+    va_list args;
+    if (g->failed) return;
+
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    if (g->line_count >= g->line_capacity) {
+        int capacity = g->line_capacity ? g->line_capacity * 2 : 256;
+        GenLine *grown = realloc(g->lines, (size_t)capacity * sizeof(GenLine));
+        if (!grown) {
+            g->failed = GEN_TRUE;
+            return;
+        }
+        g->lines = grown;
+        g->line_capacity = capacity;
+    }
+    g->lines[g->line_count].text = malloc(strlen(buf) + 1);
+    if (!g->lines[g->line_count].text) {
+        g->failed = GEN_TRUE;
+        return;
+    }
+    strcpy(g->lines[g->line_count].text, buf);
+    g->lines[g->line_count].paddable = paddable;
+    g->line_count++;
+}
+
+/* ---------------- operands ---------------- */
+
+/* words an operand of this mode costs on its own */
+static int mode_words(int mode) {
+    return mode == MODE_MATRIX ? 2 : 1;
+}
+
+/* choose a mode out of allowed using the operand mix (falls back if a kind has no labels yet) */
+static int pick_mode(Gen *g, int allowed) {
+    const GenParams *p = g->params;
+    int modes[4] = {MODE_IMMEDIATE, MODE_DIRECT, MODE_MATRIX, MODE_REGISTER};
+    int weights[4];
+    int i;
+    weights[0] = p->immediate_weight;
+    weights[1] = p->direct_weight;
+    weights[2] = g->mat_labels > 0 ? p->matrix_weight : 0;
+    weights[3] = p->register_weight;
+    for (i = 0; i < 4; i++) {
+        if (!(allowed & modes[i])) weights[i] = 0;
+    }
+
+    i = pick_weighted(g, weights, 4);
+    if (i >= 0) return modes[i];
+    /* nothing in the mix fits, take any allowed mode that works */
+    if (allowed & MODE_DIRECT) return MODE_DIRECT;
+    if (allowed & MODE_REGISTER) return MODE_REGISTER;
+    return MODE_IMMEDIATE;
+}
+
+/* some label a direct operand can point at (data, extern or an earlier code label) */
+static void direct_target(Gen *g, char *out, size_t size, int jump) {
+    const GenParams *p = g->params;
+    int choice = random_below(g, 3);
+
+    if (jump || choice == 0) {
+        if (g->code_labels > 0 && random_below(g, 4) != 0)
+            snprintf(out, size, "L%d", random_below(g, g->code_labels));
+        else
+            snprintf(out, size, "END");
+        return;
+    }
+    if (choice == 1 && p->externs > 0) {
+        snprintf(out, size, "X%d", random_below(g, p->externs));
+        return;
+    }
+    if (g->data_labels > 0) snprintf(out, size, "D%d", random_below(g, g->data_labels));
+    else snprintf(out, size, "END");
+}
+
+static void format_operand(Gen *g, int mode, char *out, size_t size, int jump) {
+    int m, r;
+    switch (mode) {
+        case MODE_IMMEDIATE:
+            snprintf(out, size, "#%d", random_between(g, -200, 200));
+            break;
+        case MODE_MATRIX:
+            /* [r0][r0] encodes to an all-zero word, which the encoder rejects, so skip it */
+            m = random_below(g, g->mat_labels);
+            r = random_below(g, 8);
+            snprintf(out, size, "M%d[r%d][r%d]", m, r, r == 0 ? random_between(g, 1, 7) : random_below(g, 8));
+            break;
+        case MODE_REGISTER:
+            snprintf(out, size, "r%d", random_below(g, 8));
+            break;
+        default:
+            direct_target(g, out, size, jump);
+            break;
+    }
+}
+
+/* one instruction line (label prefix may be empty), returns words used */
+static int make_instruction(Gen *g, char *line, size_t size, const char *label_prefix) {
+    const GenOpcode *op = &opcodes[random_below(g, OPCODE_COUNT)];
+    char src[32], dst[32];
+    int jump = op->dst_modes == MODE_DIRECT;
+
+    if (op->operands == 0) {
+        snprintf(line, size, "%s %s", label_prefix, op->name);
+        return 1;
+    }
+
+    int dst_mode = pick_mode(g, op->dst_modes);
+    format_operand(g, dst_mode, dst, sizeof(dst), jump);
+    if (op->operands == 1) {
+        snprintf(line, size, "%s %s %s", label_prefix, op->name, dst);
+        return 1 + mode_words(dst_mode);
+    }
+
+    int src_mode = pick_mode(g, op->src_modes);
+    format_operand(g, src_mode, src, sizeof(src), GEN_FALSE);
+    snprintf(line, size, "%s %s %s, %s", label_prefix, op->name, src, dst);
+    if (src_mode == MODE_REGISTER && dst_mode == MODE_REGISTER) return 2; /* registers share a word */
+    return 1 + mode_words(src_mode) + mode_words(dst_mode);
+}
+
+/* ---------------- program parts ---------------- */
+
+/* data directives until the data share of the budget is used, returns words */
+static int make_data(Gen *g, int budget, char data_lines[][GEN_LINE_LEN], int *count) {
+    const GenParams *p = g->params;
+    int weights[3];
+    int used = 0;
+    weights[0] = p->data_weight;
+    weights[1] = p->string_weight;
+    weights[2] = p->mat_weight;
+
+    *count = 0;
+    while (used < budget && *count < MAX_PROGRAM_WORDS) {
+        char *line = data_lines[*count];
+        int kind = pick_weighted(g, weights, 3);
+        int left = budget - used;
+        int i, n, at;
+
+        if (kind == 2 && left >= 1) {
+            int rows = random_between(g, 1, 3), cols = random_between(g, 1, 3);
+            while (rows * cols > left) {
+                if (rows > 1) rows--;
+                else cols--;
+            }
+            at = snprintf(line, GEN_LINE_LEN, "M%d: .mat [%d][%d] ", g->mat_labels, rows, cols);
+            for (i = 0; i < rows * cols; i++)
+                at += snprintf(line + at, (size_t)(GEN_LINE_LEN - at), "%s%d", i ? "," : "", random_between(g, -99, 99));
+            g->mat_labels++;
+            used += rows * cols;
+        } else if (kind == 1 && left >= 2) {
+            n = random_between(g, 1, 8);
+            if (n + 1 > left) n = left - 1;
+            at = snprintf(line, GEN_LINE_LEN, "D%d: .string \"", g->data_labels++);
+            for (i = 0; i < n; i++) line[at++] = (char)('a' + random_below(g, 26));
+            snprintf(line + at, (size_t)(GEN_LINE_LEN - at), "\"");
+            used += n + 1;
+        } else {
+            n = random_between(g, 1, 4);
+            if (n > left) n = left;
+            at = snprintf(line, GEN_LINE_LEN, "D%d: .data ", g->data_labels++);
+            for (i = 0; i < n; i++)
+                at += snprintf(line + at, (size_t)(GEN_LINE_LEN - at), "%s%d", i ? ", " : "", random_between(g, -500, 500));
+            used += n;
+        }
+        (*count)++;
+    }
+    return used;
+}
+
+/* macro definitions + calls; returns words the calls will expand to */
+static int make_macros(Gen *g, int budget, char ***calls, int *call_count) {
+    const GenParams *p = g->params;
+    int used = 0, m, j;
+    char line[GEN_LINE_LEN];
+
+    *call_count = 0;
+    *calls = NULL;
+    if (p->macros <= 0) return 0;
+    *calls = calloc((size_t)p->macros * (size_t)(p->macro_calls > 0 ? p->macro_calls : 1), sizeof(char *));
+    if (!*calls) {
+        g->failed = GEN_TRUE;
+        return 0;
+    }
+
+    for (m = 0; m < p->macros; m++) {
+        int body_words = 0;
+        add_line(g, GEN_FALSE, "mcro mc%d", m);
+        for (j = 0; j < p->macro_body; j++) {
+            if (p->comment_macros) {
+                add_line(g, GEN_FALSE, "; macro %d body line %d", m, j);
+                continue;
+            }
+            /* keep the expansion inside the budget (skip the line otherwise) */
+            int words = make_instruction(g, line, sizeof(line), "");
+            if (used + (body_words + words) * p->macro_calls > budget) continue;
+            body_words += words;
+            add_line(g, GEN_FALSE, "%s", line);
+        }
+        add_line(g, GEN_TRUE, "mcroend");
+
+        used += body_words * p->macro_calls;
+        for (j = 0; j < p->macro_calls; j++) {
+            char *call = malloc(16);
+            if (!call) {
+                g->failed = GEN_TRUE;
+                break;
+            }
+            snprintf(call, 16, "mc%d", m);
+            (*calls)[(*call_count)++] = call;
+        }
+    }
+    return used;
+}
+
+char *gen_program(const GenParams *params, size_t *size, int *lines) {
+    Gen g;
+    char (*data_lines)[GEN_LINE_LEN];
+    char **calls = NULL;
+    int call_count = 0, data_count = 0;
+    int budget = params->words > MAX_PROGRAM_WORDS ? MAX_PROGRAM_WORDS : params->words;
+    int i;
+
+    memset(&g, 0, sizeof(g));
+    g.params = params;
+    g.rng = params->seed ? params->seed : 1;
+
+    data_lines = malloc((size_t)MAX_PROGRAM_WORDS * GEN_LINE_LEN);
+    if (!data_lines) return NULL;
+
+    /* data first (code needs its labels), then macros, externs, code, data lines, entries */
+    int words = make_data(&g, budget * params->data_percent / 100, data_lines, &data_count);
+    words += make_macros(&g, budget - words - 1, &calls, &call_count);
+
+    for (i = 0; i < params->externs; i++) add_line(&g, GEN_TRUE, ".extern X%d", i);
+
+    /* spread the macro calls over the code */
+    int next_call = 0;
+    while (budget - words > MAX_INSTRUCTION_WORDS) {
+        char line[GEN_LINE_LEN], label[16] = "";
+        if (next_call < call_count && random_below(&g, 3) == 0) {
+            add_line(&g, GEN_TRUE, "%s", calls[next_call++]);
+            continue;
+        }
+        if (random_below(&g, 100) < params->label_percent) snprintf(label, sizeof(label), "L%d:", g.code_labels);
+        words += make_instruction(&g, line, sizeof(line), label);
+        if (label[0]) g.code_labels++;
+        add_line(&g, GEN_TRUE, "%s", line);
+    }
+    while (next_call < call_count) add_line(&g, GEN_TRUE, "%s", calls[next_call++]);
+    add_line(&g, GEN_TRUE, "END: stop"); /* loop always leaves >= 1 word for it */
+
+    for (i = 0; i < data_count; i++) add_line(&g, GEN_TRUE, "%s", data_lines[i]);
+    for (i = 0; i < g.code_labels; i++) {
+        if (random_below(&g, 100) < params->entry_percent) add_line(&g, GEN_TRUE, ".entry L%d", i);
+    }
+
+    for (i = 0; i < call_count; i++) free(calls[i]);
+    free(calls);
+    free(data_lines);
+
+    /* write it out, padding spread evenly after paddable lines */
+    char *text = NULL;
+    size_t text_size = 0;
+    FILE *out = g.failed ? NULL : open_memstream(&text, &text_size);
+    int paddable = 0, padded = 0, seen = 0, total_lines = 0;
+    for (i = 0; i < g.line_count; i++) paddable += g.lines[i].paddable;
+    for (i = 0; i < g.line_count; i++) {
+        if (out) fprintf(out, "%s\n", g.lines[i].text);
+        total_lines++;
+        free(g.lines[i].text);
+        if (!g.lines[i].paddable) continue;
+
+        seen++;
+        int target = (int)((long)params->padding_lines * seen / paddable);
+        for (; padded < target; padded++) {
+            if (out) {
+                if (padded % 4 == 3) fprintf(out, "\n");
+                else fprintf(out, "; padding line %d\n", padded);
+            }
+            total_lines++;
+        }
+    }
+    free(g.lines);
+    if (!out) return NULL;
+    fclose(out);
+
+    *size = text_size;
+    if (lines) *lines = total_lines;
+    return text;
+}
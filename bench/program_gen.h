@@ -0,0 +1,51 @@
+#ifndef PROGRAM_GEN_H
+#define PROGRAM_GEN_H
+
+#include <stddef.h>
+
+/*
+ * program_gen.h
+ * -------------
+ * Makes random but valid .as programs for benchmarking (same seed = same
+ * program). The assembler caps a program at 255 words, so "big" inputs grow
+ * in the directions that cost no words:
+ *   - externs        : thousands of .extern labels (label table scans)
+ *   - comment macros : hundreds of macros whose bodies are only comments
+ *                      (macro table scan on every line)
+ *   - padding        : comment / blank lines between the real ones
+ * while words (instructions + data) stay under the cap.
+ */
+typedef struct {
+    unsigned int seed;
+    int words;              /* word budget for code + data (<= 255) */
+    int data_percent;       /* share of the budget spent on .data/.string/.mat */
+    int label_percent;      /* % of instructions that get a label */
+    int entry_percent;      /* % of code labels also declared .entry */
+
+    int macros;             /* macros defined (each called macro_calls times) */
+    int macro_body;         /* lines per macro body */
+    int macro_calls;
+    int comment_macros;     /* TRUE = bodies are comments only (cost no words) */
+
+    int externs;            /* .extern declarations */
+    int padding_lines;      /* comment/blank lines spread over the program */
+
+    /* directive mix (weights) */
+    int data_weight;
+    int string_weight;
+    int mat_weight;
+
+    /* operand mix (weights) */
+    int immediate_weight;
+    int direct_weight;
+    int matrix_weight;
+    int register_weight;
+} GenParams;
+
+/* a "typical" program: ~250 words, some labels/macros, every operand kind */
+void gen_default_params(GenParams *params);
+
+/* malloc'd program text (NULL if out of memory), *lines = source line count */
+char *gen_program(const GenParams *params, size_t *size, int *lines);
+
+#endif /* PROGRAM_GEN_H */
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libasm.h"
+#include "line_reader.h"
+#include "program_gen.h"
+#include "scan.h"
+#include "util.h"
+
+/*
+ * scan_bench
+ * ----------
+ * Scalar vs SSE2 vs AVX2 structural scanning (scan.h), on every path this
+ * cpu has. First checks all paths give the same bitmaps (random bytes, every
+ * length), then times:
+ *   - raw block scan of a big generated source (all structural chars)
+ *   - line splitting with LineReader over the same source
+ *   - a whole assembly (pre-assembly + first pass use the scanner)
+ *   scan_bench [--min-time S] [--lines N]
+ */
+
+#define CHECK_BUFFER 4096
+
+typedef struct {
+    const char *text;
+    size_t size;
+    int lines;
+    const ScanSet *set;
+} BenchInput;
+
+/* keeps the compiler from dropping the work */
+static volatile uint64_t sink;
+
+/* every path against scalar on random data, all lengths and offsets */
+static int check_impls(const ScanSet *set) {
+    static char buffer[CHECK_BUFFER];
+    int impl;
+    int i;
+
+    srand(7);
+    for (i = 0; i < CHECK_BUFFER; i++) {
+        /* mostly the interesting chars, some anything */
+        buffer[i] = (rand() % 4) ? " \t\n\r\v\f:;,[]#a0"[rand() % 15] : (char)(rand() % 256);
+    }
+
+    for (impl = SCAN_IMPL_SSE2; impl < SCAN_IMPL_COUNT; impl++) {
+        size_t offset;
+        if (!scan_force_impl((ScanImpl)impl)) continue;
+        for (offset = 0; offset + SCAN_BLOCK_SIZE <= CHECK_BUFFER; offset++) {
+            size_t length;
+            for (length = 0; length <= SCAN_BLOCK_SIZE; length += (offset % 7) + 1) {
+                uint64_t got = scan_partial(set, buffer + offset, length);
+                uint64_t expected;
+                scan_force_impl(SCAN_IMPL_SCALAR);
+                expected = scan_partial(set, buffer + offset, length);
+                scan_force_impl((ScanImpl)impl);
+                if (got != expected) {
+                    fprintf(stderr, "scan_bench: %s differs from scalar at offset %lu length %lu\n",
+                            scan_impl_name((ScanImpl)impl), (unsigned long)offset, (unsigned long)length);
+                    return FALSE;
+                }
+            }
+        }
+    }
+    return TRUE;
+}
+
+static double time_block_scan(const BenchInput *input, double min_time, double *bytes) {
+    double started = monotonic_seconds();
+    double elapsed;
+    double done = 0;
+    uint64_t found = 0;
+
+    do {
+        size_t pos;
+        for (pos = 0; pos + SCAN_BLOCK_SIZE <= input->size; pos += SCAN_BLOCK_SIZE) {
+            found += (uint64_t)__builtin_popcountll(scan_block(input->set, input->text + pos));
+        }
+        found += scan_partial(input->set, input->text + pos, input->size - pos);
+        done += (double)input->size;
+        elapsed = monotonic_seconds() - started;
+    } while (elapsed < min_time);
+
+    sink = found;
+    *bytes = done;
+    return elapsed;
+}
+
+static double time_line_split(const BenchInput *input, double min_time, double *lines) {
+    double started = monotonic_seconds();
+    double elapsed;
+    double done = 0;
+    uint64_t length = 0;
+
+    do {
+        LineReader reader;
+        LineView line;
+        line_reader_init(&reader, input->text, input->size);
+        while (line_reader_next(&reader, &line)) {
+            length += line.length;
+            done++;
+        }
+        elapsed = monotonic_seconds() - started;
+    } while (elapsed < min_time);
+
+    sink = length;
+    *lines = done;
+    return elapsed;
+}
+
+static double time_assembly(const char *program, size_t size, double min_time, double *files) {
+    double started = monotonic_seconds();
+    double elapsed;
+    double done = 0;
+
+    do {
+        AsmResult result;
+        asm_assemble(program, size, "bench", NULL, &result);
+        asm_free_result(&result);
+        done++;
+        elapsed = monotonic_seconds() - started;
+    } while (elapsed < min_time);
+
+    *files = done;
+    return elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    double min_time = 0.5;
+    int padding = 64000;
+    ScanSet structural;
+    GenParams params;
+    BenchInput input;
+    char *program;
+    size_t program_size;
+    int program_lines;
+    int impl;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--lines") == 0 && i + 1 < argc) {
+            padding = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--min-time SECONDS] [--lines N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    /* everything the passes split on: \n ; : , [ ] # and whitespace */
+    scan_set_init(&structural, "\n;:,[]#", 7, TRUE);
+    ScanImpl best = scan_active_impl();
+    if (!check_impls(&structural)) return 1;
+
+    gen_default_params(&params);
+    params.padding_lines = padding;
+    program = gen_program(&params, &program_size, &program_lines);
+    if (!program) {
+        fprintf(stderr, "scan_bench: out of memory\n");
+        return 1;
+    }
+    input.text = program;
+    input.size = program_size;
+    input.lines = program_lines;
+    input.set = &structural;
+
+    printf("source: %d lines, %lu bytes, cpu picks %s\n", program_lines,
+           (unsigned long)program_size, scan_impl_name(best));
+    printf("  %-8s %14s %14s %14s\n", "path", "scan MB/s", "split lines/s", "assembly us");
+    for (impl = 0; impl < SCAN_IMPL_COUNT; impl++) {
+        double bytes, lines, files;
+        double scan_seconds, split_seconds, assembly_seconds;
+        if (!scan_force_impl((ScanImpl)impl)) {
+            printf("  %-8s %14s\n", scan_impl_name((ScanImpl)impl), "(not on this cpu)");
+            continue;
+        }
+        scan_seconds = time_block_scan(&input, min_time, &bytes);
+        split_seconds = time_line_split(&input, min_time, &lines);
+        assembly_seconds = time_assembly(program, program_size, min_time, &files);
+        printf("  %-8s %14.0f %14.0f %14.1f\n", scan_impl_name((ScanImpl)impl),
+               bytes / scan_seconds / 1e6, lines / split_seconds, assembly_seconds * 1e6 / files);
+    }
+
+    scan_force_impl(best);
+    free(program);
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+/*
+ * word_bench
+ * ----------
+ * Microbenchmark of the reserved word lookup (find_command and friends).
+ * Times the old strcmp loop over command_names against find_reserved_word on
+ * the kind of words the assembler feeds it: mnemonics (every line), label
+ * names (add_label_row) and macro names (is_reserved_macro_name).
+ *   word_bench [--min-time S]
+ */
+
+static const char *words[] = {
+    /* first words of lines */
+    "mov", "cmp", "add", "sub", "not", "clr", "lea", "inc", "dec", "jmp",
+    "bne", "red", "prn", "jsr", "rts", "stop", ".string", ".data", ".mat",
+    /* labels / macro names, most of them miss */
+    "MAIN", "LOOP", "END", "STR", "LIST", "K", "W", "X1", "data_7", "m_mac",
+    "mcro_copy", "move", "stops", "sub2", "Loop1", "r9", "jmpp", "COUNTER"
+};
+
+#define WORD_COUNT ((int)(sizeof(words) / sizeof(words[0])))
+
+/* the lookup find_command did before (full strcmp walk) */
+static int find_command_loop(const char *word, const char *label) {
+    int i;
+    for (i = 0; i < NUMBER_OF_COMMANDS; i++) {
+        if (strcmp(word, command_names[i]) == 0) {
+            return i;
+        }
+        if (i < NUMBER_OF_DATA_TYPES &&
+            strcmp(label, EMPTY_STRING) != 0 &&
+            strcmp(word, command_names[i + NUMBER_OF_COMMANDS]) == 0) {
+            return i + NUMBER_OF_COMMANDS;
+        }
+    }
+    return NOT_FOUND;
+}
+
+/* keeps the compiler from dropping the lookups */
+static volatile long sink;
+
+static double time_loop(int use_switch, double min_time, long *lookups) {
+    double started = monotonic_seconds();
+    double elapsed;
+    long done = 0;
+    long found = 0;
+
+    do {
+        int round;
+        for (round = 0; round < 10000; round++) {
+            int i;
+            for (i = 0; i < WORD_COUNT; i++) {
+                if (use_switch)
+                    found += find_command((char *)words[i], "L");
+                else
+                    found += find_command_loop(words[i], "L");
+            }
+        }
+        done += 10000L * WORD_COUNT;
+        elapsed = monotonic_seconds() - started;
+    } while (elapsed < min_time);
+
+    sink = found;
+    *lookups = done;
+    return elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    double min_time = 0.5;
+    long lookups;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--min-time SECONDS]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    /* same answers first, a fast wrong lookup is no use */
+    for (i = 0; i < WORD_COUNT; i++) {
+        if (find_command((char *)words[i], "L") != find_command_loop(words[i], "L") ||
+            find_command((char *)words[i], "") != find_command_loop(words[i], "")) {
+            fprintf(stderr, "word_bench: lookups disagree on \"%s\"\n", words[i]);
+            return 1;
+        }
+    }
+
+    printf("  %-14s %14s %10s\n", "lookup", "lookups/s", "ns/lookup");
+    for (i = 0; i < 2; i++) {
+        double seconds = time_loop(i, min_time, &lookups);
+        printf("  %-14s %14.0f %10.2f\n", i ? "switch" : "strcmp loop",
+               lookups / seconds, seconds * 1e9 / lookups);
+    }
+    return 0;
+}
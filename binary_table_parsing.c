@@ -3,15 +3,26 @@
 #include <string.h>
 #include <ctype.h>
 #include "binary_table_parsing.h"
+#include "isa.h"
+#include "task_pool.h"
 #include "table.h"
 #include "labels.h"
 #include "util.h"
 
-/* Small helper to print errors with original source line (very useful for users). */
-static void error_at_row(const char *filename, const Row *row, const char *msg) {
-    print_error(filename, row ? (int)row->original_line_number : -1, msg);
+/* pass two of a big table: a few chunks per thread (so one slow thread
+   doesnt hold up the rest), but not so small the handout costs more */
+#define CHUNKS_PER_THREAD 4
+#define MIN_CHUNK_ROWS 256
+
+/* Small helper to print errors with original source line (very useful for users).
+   filename NULL = one-pass trying a row early or a pool thread: stay quiet,
+   whoever called reports it again in order */
+static void error_at_row(const char *filename, const Table *table, int index, const char *msg) {
+    if (filename) print_error(filename, (int)table->line[index], msg);
 }
 
+/* ===== first pass: operand text -> Operand (describe_row) ===== */
+
 /* --- Addressing mode helpers --- */
 static int detect_mode(const char *op) {
     if (!op)                             return 0; /* won't be used if missing */
@@ -21,32 +32,16 @@ static int detect_mode(const char *op) {
     return DIRECT_ADDRESSING;                                                // 1
 }
 
-static const char* mode_name(int m) {
-    switch (m) {
-        case IMMEDIATE_ADDRESSING:       return "Immediate";
-        case DIRECT_ADDRESSING:          return "Direct";
-        case MATRIX_ACCESS_ADDRESSING:   return "Matrix";
-        case DIRECT_REGISTER_ADDRESSING: return "Register";
-        default:                         return "Unknown";
-    }
-}
-
-/* Packs 8-bit payload into bits 2–9, and 2-bit ARE into bits 0–1. */
-static unsigned int pack_payload_with_are(unsigned int payload8, unsigned int are2) {
-    return ((payload8 & 0xFF) << 2) | (are2 & 0x3);
-}
-
 /*
- * encode_matrix_regs
- * ------------------
- * Encodes the register pair inside a matrix index like: [r2][r7]
- * Mapping: row-reg → bits 6–8, col-reg → bits 2–4, ARE in 0–1.
+ * parse_matrix_regs
+ * -----------------
+ * Reads the register pair inside a matrix index like: [r2][r7]
+ * returns TRUE and the row/col registers, FALSE if its not exactly that.
  */
-static unsigned int encode_matrix_regs(const char *regstr) {
+static int parse_matrix_regs(const char *regstr, int *r_row, int *r_col) {
     if (!regstr) return FALSE;
 
     const char *p = regstr;
-    int r_row = -1, r_col = -1;
 
     while (*p && isspace((unsigned char)*p)) p++;
 
@@ -60,7 +55,7 @@ static unsigned int encode_matrix_regs(const char *regstr) {
     char *endptr = NULL;
     long v = strtol(p, &endptr, 10);
     if (endptr == p || v < 0 || v > 7) return FALSE;
-    r_row = (int)v;
+    *r_row = (int)v;
     p = endptr;
 
     while (*p && isspace((unsigned char)*p)) p++;
@@ -77,7 +72,7 @@ static unsigned int encode_matrix_regs(const char *regstr) {
 
     v = strtol(p, &endptr, 10);
     if (endptr == p || v < 0 || v > 7) return FALSE;
-    r_col = (int)v;
+    *r_col = (int)v;
     p = endptr;
 
     while (*p && isspace((unsigned char)*p)) p++;
@@ -87,123 +82,12 @@ static unsigned int encode_matrix_regs(const char *regstr) {
 
     if (*p != '\0') return FALSE;  /* trailing junk not allowed */
 
-    return ((r_row & 0x7) << 6) | ((r_col & 0x7) << 2) | A_ARE;
-}
-
-/*
- * encode_command_line
- * -------------------
- * Builds the FIRST word of an instruction line.
- */
-int encode_command_line(Row *row, const char *src_filename)
-{
-    if (!row) return FALSE;
-
-    int src_mode = 0, dest_mode = 0;
-    char operands_copy[MAX_OPERAND_LEN];
-    char *src_tok = NULL, *dest_tok = NULL;
-
-    strncpy(operands_copy, row->operands_string ? row->operands_string : "", MAX_OPERAND_LEN - 1);
-    operands_copy[MAX_OPERAND_LEN - 1] = '\0';
-
-    src_tok  = strtok(operands_copy, COMMA_STRING);
-    dest_tok = strtok(NULL,          COMMA_STRING);
-
-    if (src_tok)  src_mode  = detect_mode(src_tok);
-    if (dest_tok) dest_mode = detect_mode(dest_tok);
-
-    const unsigned src_all   = 0xF;    /* 0|1|2|3 */
-    const unsigned dest_all  = 0xF;
-    const unsigned not_immediate = 0xE;/* 1|2|3 */
-    const unsigned lea_src   = 0x6;    /* 1|2 only */
-
-    int cmd = row->command;
-    int expected_operands = 2;
-    unsigned allow_src = 0, allow_dst = 0;
-
-    switch (cmd) {
-        case MOV: allow_src = src_all;        allow_dst = not_immediate; expected_operands = 2; break;
-        case CMP: allow_src = src_all;        allow_dst = dest_all;      expected_operands = 2; break;
-        case ADD: allow_src = src_all;        allow_dst = not_immediate; expected_operands = 2; break;
-        case SUB: allow_src = src_all;        allow_dst = not_immediate; expected_operands = 2; break;
-        case NOT: allow_src = 0;              allow_dst = not_immediate; expected_operands = 1; break;
-        case CLR: allow_src = 0;              allow_dst = not_immediate; expected_operands = 1; break;
-        case LEA: allow_src = lea_src;        allow_dst = not_immediate; expected_operands = 2; break;
-        case INC: allow_src = 0;              allow_dst = not_immediate; expected_operands = 1; break;
-        case DEC: allow_src = 0;              allow_dst = not_immediate; expected_operands = 1; break;
-        case JMP: allow_src = 0;              allow_dst = not_immediate; expected_operands = 1; break;
-        case BNE: allow_src = 0;              allow_dst = not_immediate; expected_operands = 1; break;
-        case RED: allow_src = 0;              allow_dst = not_immediate; expected_operands = 1; break;
-        case PRN: allow_src = 0;              allow_dst = dest_all;      expected_operands = 1; break;
-        case JSR: allow_src = 0;              allow_dst = not_immediate; expected_operands = 1; break;
-        case RTS: allow_src = 0;              allow_dst = 0;             expected_operands = 0; break;
-        case STP: allow_src = 0;              allow_dst = 0;             expected_operands = 0; break;
-        default:
-            error_at_row(src_filename, row, "Unknown command opcode");
-            return FALSE;
-    }
-
-    int provided_operands = (src_tok ? 1 : 0) + (dest_tok ? 1 : 0);
-
-    if (expected_operands == 1) {
-        if (provided_operands == 0) {
-            print_error(src_filename, (int)row->original_line_number, "Expected one operand, got none");
-            return FALSE;
-        }
-        if (provided_operands > 1) {
-            print_error(src_filename, (int)row->original_line_number, "Expected one operand, got two");
-            return FALSE;
-        }
-        if (src_tok && !dest_tok) {
-            dest_tok  = src_tok;
-            dest_mode = src_mode;
-            src_tok   = NULL;
-            src_mode  = 0;
-        }
-    } else if (expected_operands == 2) {
-        if (provided_operands < 2) {
-            print_error(src_filename, (int)row->original_line_number, "Expected two operands, got one");
-            return FALSE;
-        }
-        if (provided_operands > 2) {
-            print_error(src_filename, (int)row->original_line_number, "Expected two operands, got more than two");
-            return FALSE;
-        }
-    } else {
-        if (provided_operands != 0) {
-            print_error(src_filename, (int)row->original_line_number, "Expected no operands for this instruction");
-            return FALSE;
-        }
-    }
-
-    if (expected_operands == 2) {
-        if (((allow_src >> src_mode) & 1U) == 0U) {
-            char buf[128];
-            snprintf(buf, sizeof(buf), "Invalid SOURCE addressing for opcode %d: %s", cmd, mode_name(src_mode));
-            error_at_row(src_filename, row, buf);
-            return FALSE;
-        }
-    }
-    if (expected_operands >= 1) {
-        if (((allow_dst >> dest_mode) & 1U) == 0U) {
-            char buf[128];
-            snprintf(buf, sizeof(buf), "Invalid DESTINATION addressing for opcode %d: %s", cmd, mode_name(dest_mode));
-            error_at_row(src_filename, row, buf);
-            return FALSE;
-        }
-    }
-
-    unsigned int binary = 0;
-    binary |= (row->command & 0xF) << 6;
-    binary |= (src_tok  ? (src_mode  & 0x3) << 4 : 0);
-    binary |= (dest_tok ? (dest_mode & 0x3) << 2 : 0);
-    binary |= A_ARE;
-
-    row->binary_machine_code = (binary & TEN_BIT_MASK);
     return TRUE;
 }
 
-int encode_two_register_operands(const char *operand, Row *row) {
+/* "rX, rY" packed row: TRUE + both registers, NOT_FOUND if out of r0..r7,
+   FALSE if its not a register pair at all */
+static int parse_two_registers(const char *operand, int *r1, int *r2) {
     if (!operand) return FALSE;
 
     char buf[MAX_OPERAND_LEN + 1];
@@ -231,150 +115,319 @@ int encode_two_register_operands(const char *operand, Row *row) {
 
     if (*right == '\0' || *left == '\0') return FALSE;
 
-    int r1 = -1, r2 = -1;
-    if (sscanf(left, "r%d", &r1) != 1) return FALSE;
-    if (sscanf(right, "r%d", &r2) != 1) return FALSE;
+    *r1 = -1;
+    *r2 = -1;
+    if (sscanf(left, "r%d", r1) != 1) return FALSE;
+    if (sscanf(right, "r%d", r2) != 1) return FALSE;
 
-    if (r1 < 0 || r1 > 7 || r2 < 0 || r2 > 7) return NOT_FOUND;
+    if (*r1 < 0 || *r1 > 7 || *r2 < 0 || *r2 > 7) return NOT_FOUND;
+    return TRUE;
+}
 
-    unsigned int word = ((r1 & 0xF) << 6) | ((r2 & 0xF) << 2) | A_ARE;
-    row->binary_machine_code = (word & TEN_BIT_MASK);
+static void describe_invalid(Operand *desc, OperandError error) {
+    desc->kind = OPERAND_INVALID;
+    desc->error = error;
+}
 
-    return TRUE;
+/* first row of a command: which operands are there and their addressing modes */
+static void describe_instruction(Table *table, int index) {
+    Operand *desc = &table->operand[index];
+    char operands_copy[MAX_OPERAND_LEN];
+
+    strncpy(operands_copy, row_operands(table, index), MAX_OPERAND_LEN - 1);
+    operands_copy[MAX_OPERAND_LEN - 1] = '\0';
+
+    char *cursor = operands_copy;
+    char *src_tok  = split_token(&cursor, COMMA_STRING);
+    char *dest_tok = split_token(&cursor, COMMA_STRING);
+
+    desc->kind = OPERAND_INSTRUCTION;
+    desc->operand_count = (src_tok ? 1 : 0) + (dest_tok ? 1 : 0);
+    desc->src_mode  = src_tok  ? detect_mode(src_tok)  : 0;
+    desc->dest_mode = dest_tok ? detect_mode(dest_tok) : 0;
 }
 
-int encode_operand_row(Row *row, Labels *labels, const char *src_filename)
-{
-    if (!row) return FALSE;
+/* one operand row of a command (checks in the same order the encoder always did) */
+static void describe_operand(Table *table, int index) {
+    Operand *desc = &table->operand[index];
+    const char *operand = row_operands(table, index);
+    int r1, r2;
 
-    const char *operand = row->operands_string;
-    if (!operand || !*operand) {
-        error_at_row(src_filename, row, "Missing operand text for encoding");
-        return FALSE;
+    desc->role = (unsigned char)table->code[index]; /* add_row got the operand number: 1=src, 2=dest */
+
+    if (!*operand) {
+        describe_invalid(desc, OPERAND_ERR_MISSING_TEXT);
+        return;
     }
 
-    if (is_matrix(operand) == FALSE_FOUND) {
-        error_at_row(src_filename, row, "Only registers between r0 and r7 are allowed");
-        return FALSE;
+    int matrix = is_matrix(operand);
+    if (matrix == FALSE_FOUND) {
+        describe_invalid(desc, OPERAND_ERR_MATRIX_REGISTERS);
+        return;
     }
 
-    int two_register_operands = encode_two_register_operands(operand, row);
-    if (two_register_operands == TRUE) return TRUE;
-    if (two_register_operands == NOT_FOUND) {
-        print_error(src_filename, (int)row->original_line_number,
-                     "Invalid two-register operands, use r0 to r7");
-        return FALSE;
+    int pair = parse_two_registers(operand, &r1, &r2);
+    if (pair == TRUE) {
+        desc->kind = OPERAND_REGISTER_PAIR;
+        desc->reg1 = (unsigned char)r1;
+        desc->reg2 = (unsigned char)r2;
+        return;
+    }
+    if (pair == NOT_FOUND) {
+        describe_invalid(desc, OPERAND_ERR_REGISTER_PAIR);
+        return;
     }
 
-    if (is_matrix(operand) != NOT_FOUND) {
+    if (matrix != NOT_FOUND) {
         const char *br = strchr(operand, '[');
         if (!br) {
-            error_at_row(src_filename, row, "Matrix operand missing register brackets");
-            return FALSE;
+            describe_invalid(desc, OPERAND_ERR_MATRIX_BRACKETS);
+            return;
         }
-        unsigned int regs_word = encode_matrix_regs(br);
-        if (!regs_word) {
-            error_at_row(src_filename, row, "Invalid matrix register pattern; expected [rX][rY], r0 to r7");
-            return FALSE;
+        /* [r0][r0] packs to 0, which always counted as a failed pattern */
+        if (!parse_matrix_regs(br, &r1, &r2) || (r1 == 0 && r2 == 0)) {
+            describe_invalid(desc, OPERAND_ERR_MATRIX_PATTERN);
+            return;
         }
-        row->binary_machine_code = regs_word & TEN_BIT_MASK;
-        return TRUE;
+        desc->kind = OPERAND_MATRIX_INDEX;
+        desc->reg1 = (unsigned char)r1;
+        desc->reg2 = (unsigned char)r2;
+        return;
     }
 
     if (is_immediate(operand)) {
         double val = 0.0;
         if (!is_number(operand + 1, &val)) {
-            print_error(src_filename, (int)row->original_line_number,"Invalid immediate operand; expected # followed by a whole number");
-            return FALSE;
+            describe_invalid(desc, OPERAND_ERR_IMMEDIATE);
+            return;
         }
-        unsigned int payload = (unsigned int)((int)val & 0xFF);
-        row->binary_machine_code = pack_payload_with_are(payload, A_ARE) & TEN_BIT_MASK;
-        return TRUE;
+        desc->kind = OPERAND_IMMEDIATE;
+        desc->value = (unsigned short)((int)val & 0xFF);
+        return;
     }
 
     if (is_register(operand)) {
         int regnum = atoi(&operand[1]);
         if (regnum < 0 || regnum > 7) {
-            error_at_row(src_filename, row, "Register index out of range (expected r0..r7)");
-            return FALSE;
+            describe_invalid(desc, OPERAND_ERR_REGISTER_RANGE);
+            return;
         }
-        unsigned int role_hint = row->binary_machine_code; /* 1=src, 2=dest */
-        unsigned int word = 0;
-
-        if (role_hint == 1) {          /* source */
-            word = ((unsigned int)regnum << 6) | A_ARE;
-        } else if (role_hint == 2) {   /* dest */
-            word = ((unsigned int)regnum << 2) | A_ARE;
-        } else {
-            error_at_row(src_filename, row, "Missing role hint for single-register operand");
-            return FALSE;
+        if (desc->role != 1 && desc->role != 2) {
+            describe_invalid(desc, OPERAND_ERR_ROLE);
+            return;
         }
+        desc->kind = OPERAND_REGISTER;
+        desc->reg1 = (unsigned char)regnum;
+        return;
+    }
+
+    /* anything else is a label, only pass two knows where it is
+       (the first pass swaps NO_SYMBOL for the name's id) */
+    desc->kind = OPERAND_SYMBOL;
+    desc->value = NO_SYMBOL;
+}
+
+OperandError describe_data_value(const char *text, unsigned short *word) {
+    double val;
+    if (!is_number(text, &val)) return OPERAND_ERR_DATA_NUMBER;
+    *word = (unsigned short)((long)val & TEN_BIT_MASK);
+    return OPERAND_OK;
+}
 
-        row->binary_machine_code = (word & TEN_BIT_MASK);
-        return TRUE;
+/* .data/.mat value or .string char */
+static void describe_data(Table *table, int index) {
+    Operand *desc = &table->operand[index];
+    int command = table->command[index];
+
+    if (command == STR) {
+        desc->kind = OPERAND_DATA;
+        desc->value = (unsigned char)row_operands(table, index)[0]; /* 0 = end of string */
+        return;
     }
-    if (is_register(operand) == NOT_FOUND) {
-        error_at_row(src_filename, row, "Invalid operand: expected a register (r0..r7)");
-        return FALSE;
+
+    if (command == DAT || command == MAT) {
+        OperandError error = describe_data_value(row_operands(table, index), &desc->value);
+        if (error != OPERAND_OK) {
+            describe_invalid(desc, error);
+            return;
+        }
+        desc->kind = OPERAND_DATA;
+        return;
     }
 
-    int two_operands = encode_two_register_operands(operand, row);
-    if (two_operands == TRUE) return TRUE;
-    if (two_operands == NOT_FOUND) {
-        error_at_row(src_filename, row, "Invalid two-register, register must be r0 to r7");
+    describe_invalid(desc, OPERAND_ERR_DATA_DIRECTIVE);
+}
+
+void describe_row(Table *table, int index) {
+    if (!table || index < 0 || index >= table->size) return;
+    memset(&table->operand[index], 0, sizeof(Operand));
+
+    if ((table->flags[index] & ROW_COMMAND_LINE) && table->command[index] < NUMBER_OF_COMMANDS) {
+        describe_instruction(table, index);
+    } else if (table->command[index] < NUMBER_OF_COMMANDS) {
+        describe_operand(table, index);
+    } else {
+        describe_data(table, index);
+    }
+}
+
+/* ===== second pass: Operand -> 10-bit word (no text parsing here) ===== */
+
+/* what each OperandError prints */
+static const char *operand_error_messages[] = {
+    [OPERAND_OK]                   = "",
+    [OPERAND_ERR_MISSING_TEXT]     = "Missing operand text for encoding",
+    [OPERAND_ERR_MATRIX_REGISTERS] = "Only registers between r0 and r7 are allowed",
+    [OPERAND_ERR_REGISTER_PAIR]    = "Invalid two-register operands, use r0 to r7",
+    [OPERAND_ERR_MATRIX_BRACKETS]  = "Matrix operand missing register brackets",
+    [OPERAND_ERR_MATRIX_PATTERN]   = "Invalid matrix register pattern; expected [rX][rY], r0 to r7",
+    [OPERAND_ERR_IMMEDIATE]        = "Invalid immediate operand; expected # followed by a whole number",
+    [OPERAND_ERR_REGISTER_RANGE]   = "Register index out of range (expected r0..r7)",
+    [OPERAND_ERR_ROLE]             = "Missing role hint for single-register operand",
+    [OPERAND_ERR_DATA_NUMBER]      = "Invalid numeric literal in data directive",
+    [OPERAND_ERR_DATA_DIRECTIVE]   = "Unsupported data directive for encoding"
+};
+
+/*
+ * encode_command_line
+ * -------------------
+ * Builds the FIRST word of an instruction line: operand count checked
+ * against the ISA table, then the word is one isa_first_words load (the
+ * mode masks only get looked at to say whats wrong).
+ */
+int encode_command_line(Table *table, int index, const char *src_filename)
+{
+    const Operand *desc = &table->operand[index];
+    int provided_operands = desc->operand_count;
+    int cmd = table->command[index];
+    int src_mode = 0, dest_mode = 0;
+
+    if (cmd >= NUMBER_OF_COMMANDS) {
+        error_at_row(src_filename, table, index, "Unknown command opcode");
         return FALSE;
     }
+    const IsaInstruction *spec = &isa_instructions[cmd];
 
-    {
-        Label *lbl = find_label_by_name(labels, operand);
-        if (!lbl) {
-            error_at_row(src_filename, row, "Label not found");
+    if (spec->operands == 1) {
+        if (provided_operands == 0) {
+            error_at_row(src_filename, table, index, "Expected one operand, got none");
             return FALSE;
         }
-        if (lbl->type == EXT) {
-            unsigned int addr8 = 0 & 0xFF;
-            row->binary_machine_code = pack_payload_with_are(addr8, E_ARE) & TEN_BIT_MASK;
+        if (provided_operands > 1) {
+            error_at_row(src_filename, table, index, "Expected one operand, got two");
+            return FALSE;
         }
-        else {
-            unsigned int addr8 = (unsigned int)lbl->decimal_address & 0xFF;
-            row->binary_machine_code = pack_payload_with_are(addr8, R_ARE) & TEN_BIT_MASK;
+        dest_mode = desc->src_mode; /* the only operand is the destination */
+    } else if (spec->operands == 2) {
+        if (provided_operands < 2) {
+            error_at_row(src_filename, table, index, "Expected two operands, got one");
+            return FALSE;
+        }
+        if (provided_operands > 2) {
+            error_at_row(src_filename, table, index, "Expected two operands, got more than two");
+            return FALSE;
+        }
+        src_mode = desc->src_mode;
+        dest_mode = desc->dest_mode;
+    } else {
+        if (provided_operands != 0) {
+            error_at_row(src_filename, table, index, "Expected no operands for this instruction");
+            return FALSE;
         }
-        return TRUE;
     }
+
+    unsigned short word = isa_first_words[cmd][src_mode & ISA_MODE_MASK][dest_mode & ISA_MODE_MASK];
+    if (word == ISA_ILLEGAL) {
+        char buf[128];
+        if (spec->operands == 2 && ((spec->src_modes >> src_mode) & 1U) == 0U) {
+            snprintf(buf, sizeof(buf), "Invalid SOURCE addressing for opcode %d: %s", cmd, isa_mode_name(src_mode));
+        } else {
+            snprintf(buf, sizeof(buf), "Invalid DESTINATION addressing for opcode %d: %s", cmd, isa_mode_name(dest_mode));
+        }
+        error_at_row(src_filename, table, index, buf);
+        return FALSE;
+    }
+
+    table->code[index] = word;
+    return TRUE;
 }
 
-int encode_data_row(Row *row, Labels *labels, const char *src_filename)
+int encode_operand_row(Table *table, int index, Labels *labels, const char *src_filename)
 {
-    (void)labels;
+    const Operand *desc = &table->operand[index];
+    unsigned int word = 0;
+
+    switch (desc->kind) {
+        case OPERAND_REGISTER_PAIR:
+            word = ISA_REGISTER_PAIR_WORD(desc->reg1, desc->reg2);
+            break;
+
+        case OPERAND_MATRIX_INDEX:
+            word = ISA_MATRIX_INDEX_WORD(desc->reg1, desc->reg2);
+            break;
+
+        case OPERAND_IMMEDIATE:
+            word = ISA_PAYLOAD_WORD(desc->value, A_ARE);
+            break;
+
+        case OPERAND_REGISTER:
+            word = ISA_REGISTER_WORD(desc->reg1, desc->role == 1); /* role 1 = source */
+            break;
+
+        case OPERAND_SYMBOL: {
+            /* id from the first pass, already resolved (no name compare) */
+            Label *lbl = (desc->value != NO_SYMBOL) ? symbol_label(labels, desc->value)
+                                                    : find_label_by_name(labels, row_operands(table, index));
+            if (!lbl) {
+                error_at_row(src_filename, table, index, "Label not found");
+                return FALSE;
+            }
+            if (lbl->type == EXT) {
+                word = ISA_PAYLOAD_WORD(0, E_ARE);
+            }
+            else {
+                word = ISA_PAYLOAD_WORD(lbl->decimal_address, R_ARE);
+            }
+            break;
+        }
 
-    if (row->command == STR) {
-        if (!row->operands_string) {
-            error_at_row(src_filename, row, ".string with empty payload");
+        case OPERAND_INVALID:
+            error_at_row(src_filename, table, index, operand_error_messages[desc->error]);
             return FALSE;
-        }
-        if (row->operands_string[0] == '\0') {
-            row->binary_machine_code = 0;
-            return TRUE;
-        }
-        row->binary_machine_code = ((unsigned char)row->operands_string[0]) & TEN_BIT_MASK;
-        return TRUE;
-    }
 
-    if (row->command == DAT || row->command == MAT) {
-        double val;
-        if (is_number(row->operands_string, &val)) {
-            long iv = (long)val;
-            iv &= TEN_BIT_MASK;
-            row->binary_machine_code = (unsigned int)iv;
-            return TRUE;
-        } else {
-            error_at_row(src_filename, row, "Invalid numeric literal in data directive");
+        default:
+            error_at_row(src_filename, table, index, "Missing operand text for encoding");
             return FALSE;
-        }
     }
 
-    error_at_row(src_filename, row, "Unsupported data directive for encoding");
-    return FALSE;
+    table->code[index] = (unsigned short)(word & TEN_BIT_MASK);
+    return TRUE;
+}
+
+int encode_data_row(Table *table, int index, Labels *labels, const char *src_filename)
+{
+    const Operand *desc = &table->operand[index];
+    (void)labels;
+
+    if (desc->kind == OPERAND_INVALID) {
+        error_at_row(src_filename, table, index, operand_error_messages[desc->error]);
+        return FALSE;
+    }
+
+    table->code[index] = desc->value;
+    return TRUE;
+}
+
+/* one row -> its word, whichever kind of row it is */
+static int encode_row(Table *table, int index, Labels *labels, const char *src_filename)
+{
+    if ((table->flags[index] & ROW_COMMAND_LINE) && table->command[index] < NUMBER_OF_COMMANDS) {
+        return encode_command_line(table, index, src_filename);
+    }
+    if (table->command[index] < NUMBER_OF_COMMANDS) {
+        return encode_operand_row(table, index, labels, src_filename);
+    }
+    return encode_data_row(table, index, labels, src_filename);
 }
 
 void trim_spaces(char *str)
@@ -386,32 +439,186 @@ void trim_spaces(char *str)
     if (start != str) memmove(str, start, strlen(start) + 1);
 }
 
-int parse_table_to_binary(Table *table, Labels *labels, const char *src_filename)
+void link_symbol_row(Table *table, Labels *labels, int index)
 {
-    int i;
+    Operand *desc = &table->operand[index];
+    int symbol = intern_symbol(labels, row_operands(table, index));
+
+    /* no id (out of memory / too many) = pass two looks the name up instead */
+    if (symbol == NOT_FOUND || symbol >= (int)NO_SYMBOL) return;
+    if (!add_fixup(table, index, symbol)) return;
+    desc->value = (unsigned short)symbol;
+}
+
+/* bad data values sitting before code row index (all that are left for
+   index == size), printed in order. TRUE if there were any */
+static int report_data_errors(const Table *table, int index, int *next, const char *src_filename)
+{
+    int reported = FALSE;
+    while (*next < table->data_error_count) {
+        const DataError *error = &table->data_errors[*next];
+        const DataDirective *directive = &table->directives[error->directive];
+        if (directive->code_before > index) break;
+        if (src_filename) print_error(src_filename, (int)directive->line, operand_error_messages[error->error]);
+        reported = TRUE;
+        (*next)++;
+    }
+    return reported;
+}
+
+/* every code row in order, the data errors in between where their words are */
+static int encode_rows_serial(Table *table, Labels *labels, const char *src_filename)
+{
+    int next_error = 0;
     int had_error = FALSE;
+    int i;
 
     for (i = 0; i < table->size; ++i) {
-        Row *row = get_row(table, i);
+        if (report_data_errors(table, i, &next_error, src_filename)) had_error = TRUE;
+        if (!encode_row(table, i, labels, src_filename)) had_error = TRUE;
+    }
+    if (report_data_errors(table, table->size, &next_error, src_filename)) had_error = TRUE;
+    return had_error ? FALSE : TRUE;
+}
 
-        if (row->is_command_line && row->command < NUMBER_OF_COMMANDS) {
-            if (encode_command_line(row, src_filename) == FALSE) {
-                had_error = TRUE;
-            }
+static int compare_fixup_rows(const void *a, const void *b)
+{
+    return ((const Fixup*)a)->row - ((const Fixup*)b)->row;
+}
+
+/* ===== big tables: pass two in chunks on the task pool ===== */
+
+typedef struct {
+    Table *table;
+    Labels *labels;         /* only read from here on */
+    int chunk_rows;
+    unsigned char *failed;  /* per chunk */
+} EncodeJob;
+
+/* quiet (a worker cant print into the caller's capture), errors get redone below */
+static void encode_chunk(int chunk, void *context)
+{
+    EncodeJob *job = (EncodeJob*)context;
+    int first = chunk * job->chunk_rows;
+    int end = first + job->chunk_rows < job->table->size ? first + job->chunk_rows : job->table->size;
+    int i;
+    for (i = first; i < end; i++) {
+        if (!encode_row(job->table, i, job->labels, NULL)) job->failed[chunk] = TRUE;
+    }
+}
+
+/* same result + messages as the serial loop: the chunks that had errors are
+   encoded again here, in row order, this time printing */
+static int encode_rows_parallel(Table *table, Labels *labels, const char *src_filename)
+{
+    EncodeJob job;
+    int helpers = task_pool_threads(0);
+    int chunks = (helpers + 1) * CHUNKS_PER_THREAD;
+    int had_error = FALSE;
+    int next_error = 0;
+    int chunk, i;
+
+    job.table = table;
+    job.labels = labels;
+    job.chunk_rows = (table->size + chunks - 1) / chunks;
+    if (job.chunk_rows < MIN_CHUNK_ROWS) job.chunk_rows = MIN_CHUNK_ROWS;
+    chunks = (table->size + job.chunk_rows - 1) / job.chunk_rows;
+    job.failed = arena_calloc(table->arena, (size_t)chunks, 1);
+    if (!job.failed) {
+        /* no memory for the flags: serial it is */
+        return encode_rows_serial(table, labels, src_filename);
+    }
+
+    task_pool_run(chunks, encode_chunk, &job);
+
+    for (chunk = 0; chunk < chunks; chunk++) {
+        int end = (chunk + 1) * job.chunk_rows < table->size ? (chunk + 1) * job.chunk_rows : table->size;
+        if (!job.failed[chunk]) {
+            if (report_data_errors(table, end - 1, &next_error, src_filename)) had_error = TRUE;
+            continue;
         }
-        else {
-            int ok = FALSE;
-            if (row->command < NUMBER_OF_COMMANDS) {
-                ok = encode_operand_row(row, labels, src_filename);
-            }
-            else {
-                ok = encode_data_row(row, labels, src_filename);
-            }
-            if (!ok) {
-                had_error = TRUE;
+        had_error = TRUE;
+        for (i = chunk * job.chunk_rows; i < end; i++) {
+            report_data_errors(table, i, &next_error, src_filename);
+            encode_row(table, i, labels, src_filename);
+        }
+    }
+    if (report_data_errors(table, table->size, &next_error, src_filename)) had_error = TRUE;
+    arena_free(table->arena, job.failed);
+    return had_error ? FALSE : TRUE;
+}
+
+int parse_table_to_binary(Table *table, Labels *labels, const char *src_filename)
+{
+    int i;
+    int late_fixups = FALSE;
+
+    for (i = 0; i < table->size; ++i) {
+        /* rows the first pass didnt describe (added by hand) get it now */
+        if (table->operand[i].kind == OPERAND_NONE) {
+            describe_row(table, i);
+            if (table->operand[i].kind == OPERAND_SYMBOL) {
+                link_symbol_row(table, labels, i);
+                late_fixups = TRUE;
             }
         }
     }
+    /* those went on the end of the list, the .ext writer wants row order */
+    if (late_fixups) qsort(table->fixups, (size_t)table->fixup_count, sizeof(Fixup), compare_fixup_rows);
 
-    return had_error ? FALSE : TRUE;
+    /* every label is in by now: tie the symbol ids to them once */
+    resolve_symbols(labels);
+
+    if (table->parallel_rows > 0 && table->size >= table->parallel_rows) {
+        return encode_rows_parallel(table, labels, src_filename);
+    }
+    return encode_rows_serial(table, labels, src_filename);
+}
+
+/* ===== one-pass mode: words go in while the first pass adds rows ===== */
+
+void encode_added_row(Table *table, Labels *labels, int index)
+{
+    const Operand *desc = &table->operand[index];
+
+    if (desc->kind == OPERAND_SYMBOL && desc->value != NO_SYMBOL) {
+        Symbol *symbol = &labels->symbols[desc->value];
+        if (symbol->label == NOT_FOUND) {
+            /* forward reference: its fixup (link_symbol_row just added it)
+               waits on the symbol until the label comes */
+            table->fixups[table->fixup_count - 1].next = symbol->pending;
+            symbol->pending = table->fixup_count - 1;
+            return;
+        }
+    }
+    if (!encode_row(table, index, labels, NULL)) table->unencoded++;
+}
+
+void backpatch_label(Table *table, Labels *labels, int label)
+{
+    Label *lbl = &labels->data[label];
+    int fixup;
+
+    /* same as reset_labels_addresses would set after the pass */
+    lbl->decimal_address = BASE_ADDRESS + lbl->table_row_index;
+
+    /* only the first row with a name is what uses resolve to */
+    int id = find_symbol(labels, lbl->label);
+    if (id == NOT_FOUND || labels->symbols[id].label != NOT_FOUND) return;
+    labels->symbols[id].label = label;
+
+    for (fixup = labels->symbols[id].pending; fixup != NOT_FOUND; fixup = table->fixups[fixup].next) {
+        if (!encode_row(table, table->fixups[fixup].row, labels, NULL)) table->unencoded++;
+    }
+    labels->symbols[id].pending = NOT_FOUND;
+}
+
+int one_pass_complete(const Table *table, const Labels *labels)
+{
+    int i;
+    if (table->unencoded > 0 || table->data_error_count > 0) return FALSE;
+    for (i = 0; i < labels->symbol_count; i++) {
+        if (labels->symbols[i].pending != NOT_FOUND) return FALSE; /* never defined */
+    }
+    return TRUE;
 }
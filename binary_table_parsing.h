@@ -4,27 +4,67 @@
 #include "table.h"
 #include "labels.h"
 
+/* word layouts + A/R/E flags (TEN_BIT_MASK, A_ARE, E_ARE, R_ARE) live in isa.h */
+#include "isa.h"
+
 /*
- * binary_table_parsing.h
- * ----------------------
- * Constants for 10-bit words and A/R/E flags (ARE in bits 0..1).
- * Just a lil legend so we remember:
- *   - A_ARE: Absolute (00)
- *   - E_ARE: External (01)
- *   - R_ARE: Relocatable (10)
+ * describe_row
+ * ------------
+ * First pass side: parses row index's operand text once into table->operand[index]
+ * (addressing modes, registers, immediate/data value, symbol or the error it
+ * will report). The second pass encodes from that and never reads the text.
  */
-#define TEN_BIT_MASK 0x3FF
-#define E_ARE 0x1
-#define R_ARE 0x2
-#define A_ARE 0x0
+void describe_row(Table *table, int index);
+
+/* a .data/.mat value's text -> its 10-bit word (OPERAND_OK), or the error a
+   row with that text would report. the first pass fills the data segment with it */
+OperandError describe_data_value(const char *text, unsigned short *word);
+
+/*
+ * link_symbol_row
+ * ---------------
+ * Row index was described as OPERAND_SYMBOL: interns its name (its id goes
+ * in the descriptor's value) and records the row as a fixup. Pass two then
+ * patches the row from the id, no name lookups.
+ */
+void link_symbol_row(Table *table, Labels *labels, int index);
 
 /*
  * parse_table_to_binary
  * ---------------------
  * Walks the Table rows and encodes each one into its 10-bit machine word.
- * Uses Labels to resolve symbols when needed (like direct adressing).
+ * Symbol rows (the fixups) get the address of the label their id resolved to.
+ * Data words are final already, only the bad values get reported (in address
+ * order, between the code rows around them).
+ * From table->parallel_rows rows up the encoding runs in chunks on the task
+ * pool (each row only needs its own descriptor + the resolved labels), the
+ * messages still come out in row order from this thread.
  * returns TRUE on success, FALSE if any row failed (but still tries to keep going).
  */
 int parse_table_to_binary(Table *table, Labels *labels, const char *src_filename);
 
+/* --------- one-pass mode (table->encode_now) --------- */
+
+/*
+ * encode_added_row
+ * ----------------
+ * Encodes row index right after the first pass described (and linked) it.
+ * A symbol whose label isnt in yet gets the row's fixup chained on it
+ * instead. Nothing is printed: a row that fails just counts in
+ * table->unencoded.
+ */
+void encode_added_row(Table *table, Labels *labels, int index);
+
+/*
+ * backpatch_label
+ * ---------------
+ * Label row label was just added: gives it its address and, if its the
+ * first row with that name, patches every use that was waiting on it.
+ */
+void backpatch_label(Table *table, Labels *labels, int label);
+
+/* TRUE if every row got its word (no errors, no bad data values, no undefined symbols). FALSE =
+   run parse_table_to_binary, which redoes it all and reports the errors */
+int one_pass_complete(const Table *table, const Labels *labels);
+
 #endif //BINARY_TABLE_PARSING_H
@@ -5,6 +5,7 @@
 #include "table.h"
 #include "labels.h"
 #include "util.h"
+#include "output_capture.h"
 
 /* ----------- Base-4 encoding helpers ----------- */
 
@@ -50,17 +51,111 @@ for (i = 4; i >= 0; --i) {
     out[5] = '\0';
 }
 
+/* ----------- Stream writers ----------- */
+
+/* one .ob line: <addr in base-4> \t <code in base-4> */
+static void write_object_word(FILE *fp, unsigned int address, unsigned int code) {
+    char addr_base4[5];
+    char code_base4[6];
+    to_base4_address(address, addr_base4);
+    to_base4_code(code, code_base4);
+    fprintf(fp, "%s\t%s\n", addr_base4, code_base4);
+}
+
+/*
+ * write_object_stream
+ * -------------------
+ * Writes every word to fp in address order: the code rows, with each data
+ * directive's words from the data segment spliced in after its code_before rows.
+ */
+int write_object_stream(FILE *fp, Table *tbl) {
+    int written_into_file = FALSE;
+    int d = 0;
+
+    int i;
+    for (i = 0; i <= tbl->size; ++i) {
+        while (d < tbl->directive_count && tbl->directives[d].code_before <= i) {
+            const DataDirective *directive = &tbl->directives[d];
+            int w;
+            for (w = 0; w < directive->count; w++) {
+                write_object_word(fp, directive->address + (unsigned int)w, tbl->data[directive->first + w]);
+                written_into_file = TRUE;
+            }
+            d++;
+        }
+        if (i == tbl->size) break;
+
+        write_object_word(fp, tbl->address[i], tbl->code[i]);
+        written_into_file = TRUE;
+    }
+    return written_into_file;
+}
+
+/*
+ * write_entry_stream
+ * ------------------
+ * Writes all labels marked as .entry to fp.
+ * The same name's non-entry rows (its definition) are linked to it, so their
+ * adress is one short walk away (no scan of the whole table per entry).
+ */
+int write_entry_stream(FILE *fp, Labels *lbls) {
+    int written_into_file = FALSE;
+
+    int i;
+    for (i = 0; i < lbls->size; i++) {
+        if (lbls->data[i].is_entry) {
+            char *current_label = lbls->data[i].label;
+
+            /* every row with this name, in the order they were added */
+            Label *first = find_label_by_name(lbls, current_label);
+            int j;
+            for (j = (int)(first - lbls->data); j != NOT_FOUND; j = lbls->data[j].next_same) {
+                if (!(lbls->data[j].is_entry)) {
+                    char addr_base4[5];
+                    to_base4_address(lbls->data[j].decimal_address, addr_base4);
+                    fprintf(fp, "%s\t%s\n", current_label, addr_base4);
+                    written_into_file = TRUE;
+                }
+            }
+        }
+    }
+    return written_into_file;
+}
+
+/*
+ * write_external_stream
+ * ---------------------
+ * Writes all occurences of .extern labels to fp.
+ * Only walks the symbol uses (tbl->fixups, in row order), not the whole table.
+ */
+int write_external_stream(FILE *fp, Table *tbl, Labels *lbls) {
+    int written_into_file = FALSE;
+
+    int i;
+    for (i = 0; i < tbl->fixup_count; i++) {
+        const Fixup *fixup = &tbl->fixups[i];
+        Label *lbl = symbol_label(lbls, fixup->symbol);
+
+        if (lbl && lbl->type == EXT) {
+            char addr_base4[5];
+            to_base4_address(tbl->address[fixup->row], addr_base4);
+            fprintf(fp, "%s\t%s\n", lbl->label, addr_base4);
+            written_into_file = TRUE;
+        }
+    }
+    return written_into_file;
+}
+
 /* ----------- Export functions ----------- */
 
 /*
  * export_object_file
  * ------------------
- * Writes each row of the table to <name>.ob
- * Format: <addr in base-4> \t <code in base-4>
+ * Writes the object code to <name>.ob (removed again if empty)
  */
 int export_object_file(Table *tbl, const char *name) {
     if (!tbl || !name) {
-        fprintf(stderr, "%s: Error - no data found for .ob file\n", name);
+        err_printf("%s: Error - no data found for .ob file\n", name);
         return FALSE;
     }
 
@@ -69,22 +164,11 @@ int export_object_file(Table *tbl, const char *name) {
 
     FILE *fp = fopen(filename, "w");
     if (!fp){
-        fprintf(stderr, "%s: Error - failed to write .ob file\n", name);
+        err_printf("%s: Error - failed to write .ob file\n", name);
         return FALSE;
     }
 
-    int written_into_file = FALSE;
-
-    int i;
-    for (i = 0; i < tbl->size; ++i) {
-        char addr_base4[5];
-        char code_base4[6];
-        to_base4_address(tbl->data[i].decimal_address, addr_base4);
-        to_base4_code(tbl->data[i].binary_machine_code, code_base4);
-
-        fprintf(fp, "%s\t%s\n", addr_base4, code_base4);
-        written_into_file = TRUE;
-    }
+    int written_into_file = write_object_stream(fp, tbl);
 
     fclose(fp);
     if (!written_into_file) {
@@ -97,12 +181,11 @@ int export_object_file(Table *tbl, const char *name) {
 /*
  * export_entry_file
  * -----------------
- * Writes all labels marked as .entry into <name>.ent
- * It searches for same label in non-entry context to grab its adress.
+ * Writes entry symbols to <name>.ent (removed again if empty)
  */
 int export_entry_file(Labels *lbls, const char *name) {
     if (!lbls || !name){
-        fprintf(stderr, "%s: Error - no data found for .ex file\n", name);
+        err_printf("%s: Error - no data found for .ex file\n", name);
         return FALSE;
     }
 
@@ -111,29 +194,11 @@ int export_entry_file(Labels *lbls, const char *name) {
 
     FILE *fp = fopen(filename, "w");
     if (!fp){
-        fprintf(stderr, "%s: Error - failed to write .ent file\n", name);
+        err_printf("%s: Error - failed to write .ent file\n", name);
         return FALSE;
     }
 
-    int written_into_file = FALSE;
-
-    int i;
-    for (i = 0; i < lbls->size; i++) {
-        if (lbls->data[i].is_entry) {
-            char *current_label = lbls->data[i].label;
-
-            int j;
-            for (j = 0; j < lbls->size; j++) {
-                if (strcmp(lbls->data[j].label, current_label) == 0 &&
-                    !(lbls->data[j].is_entry)) {
-                    char addr_base4[5];
-                    to_base4_address(lbls->data[j].decimal_address, addr_base4);
-                    fprintf(fp, "%s\t%s\n", current_label, addr_base4);
-                    written_into_file = TRUE;
-                }
-            }
-        }
-    }
+    int written_into_file = write_entry_stream(fp, lbls);
 
     fclose(fp);
     if (!written_into_file) {
@@ -146,12 +211,11 @@ int export_entry_file(Labels *lbls, const char *name) {
 /*
  * export_external_file
  * --------------------
- * Writes all occurences of .extern labels into <name>.ext
- * It scans the table rows that are NOT command-lines (data/operands).
+ * Writes extern usages to <name>.ext (removed again if empty)
  */
 int export_external_file(Table *tbl, Labels *lbls, const char *name) {
     if (!lbls || !name || !tbl){
-        fprintf(stderr, "%s: Error - no data found for .ex file\n", name);
+        err_printf("%s: Error - no data found for .ex file\n", name);
         return FALSE;
     }
 
@@ -160,25 +224,11 @@ int export_external_file(Table *tbl, Labels *lbls, const char *name) {
 
     FILE *fp = fopen(filename, "w");
     if (!fp){
-        fprintf(stderr, "%s: Error - failed to write .ex file\n", name);
+        err_printf("%s: Error - failed to write .ex file\n", name);
         return FALSE;
     }
 
-    int written_into_file = FALSE;
-
-    int i;
-    for (i = 0; i < tbl->size; i++) {
-        if (!tbl->data[i].is_command_line) {
-            Label *lbl = find_label_by_name(lbls, tbl->data[i].operands_string);
-
-            if (lbl && lbl->type == EXT) {
-                char addr_base4[5];
-                to_base4_address(tbl->data[i].decimal_address, addr_base4);
-                fprintf(fp, "%s\t%s\n", lbl->label, addr_base4);
-                written_into_file = TRUE;
-            }
-        }
-    }
+    int written_into_file = write_external_stream(fp, tbl, lbls);
 
     fclose(fp);
     if (!written_into_file) {
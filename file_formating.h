@@ -1,9 +1,15 @@
 #ifndef FILE_FORMATING_H
 #define FILE_FORMATING_H
 
+#include <stdio.h>
 #include "table.h"
 #include "labels.h"
 
+/* Stream writers (same format as the files, return TRUE if anything was written) */
+int write_object_stream(FILE *fp, Table *tbl);
+int write_entry_stream(FILE *fp, Labels *lbls);
+int write_external_stream(FILE *fp, Table *tbl, Labels *lbls);
+
 /* Writes table contents into <name>.ob (the object file in base-4) */
 int export_object_file(Table *tbl, const char *name);
 
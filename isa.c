@@ -0,0 +1,45 @@
+#include "isa.h"
+
+#define INSTRUCTION(opcode, operands, src_modes, dest_modes) \
+    [opcode] = { operands, src_modes, dest_modes },
+
+const IsaInstruction isa_instructions[NUMBER_OF_COMMANDS] = {
+    ISA_INSTRUCTIONS(INSTRUCTION)
+};
+
+/* a mode slot the instruction has (its operand is there) must be in the
+   allowed set, one it doesnt have only exists as mode 0 */
+#define MODE_OK(mode, needs, operands, modes) \
+    ((operands) >= (needs) ? (((modes) >> (mode)) & 1) : (mode) == 0)
+
+#define FIRST_WORD_OR_ILLEGAL(opcode, operands, src_modes, dest_modes, src, dest)      \
+    ((MODE_OK(src, 2, operands, src_modes) && MODE_OK(dest, 1, operands, dest_modes)) \
+        ? ISA_FIRST_WORD(opcode, (operands) >= 2 ? (src) : 0, (operands) >= 1 ? (dest) : 0) \
+        : ISA_ILLEGAL)
+
+#define FIRST_WORDS_FOR_SRC(opcode, operands, src_modes, dest_modes, src) {        \
+    FIRST_WORD_OR_ILLEGAL(opcode, operands, src_modes, dest_modes, src, 0),        \
+    FIRST_WORD_OR_ILLEGAL(opcode, operands, src_modes, dest_modes, src, 1),        \
+    FIRST_WORD_OR_ILLEGAL(opcode, operands, src_modes, dest_modes, src, 2),        \
+    FIRST_WORD_OR_ILLEGAL(opcode, operands, src_modes, dest_modes, src, 3) }
+
+#define FIRST_WORDS(opcode, operands, src_modes, dest_modes) [opcode] = { \
+    FIRST_WORDS_FOR_SRC(opcode, operands, src_modes, dest_modes, 0),     \
+    FIRST_WORDS_FOR_SRC(opcode, operands, src_modes, dest_modes, 1),     \
+    FIRST_WORDS_FOR_SRC(opcode, operands, src_modes, dest_modes, 2),     \
+    FIRST_WORDS_FOR_SRC(opcode, operands, src_modes, dest_modes, 3) },
+
+const unsigned short isa_first_words[NUMBER_OF_COMMANDS][ISA_MODE_COUNT][ISA_MODE_COUNT] = {
+    ISA_INSTRUCTIONS(FIRST_WORDS)
+};
+
+static const char *mode_names[ISA_MODE_COUNT] = {
+    [IMMEDIATE_ADDRESSING]       = "Immediate",
+    [DIRECT_ADDRESSING]          = "Direct",
+    [MATRIX_ACCESS_ADDRESSING]   = "Matrix",
+    [DIRECT_REGISTER_ADDRESSING] = "Register"
+};
+
+const char *isa_mode_name(int mode) {
+    return (mode >= 0 && mode < ISA_MODE_COUNT) ? mode_names[mode] : "Unknown";
+}
@@ -0,0 +1,94 @@
+#ifndef ISA_H
+#define ISA_H
+
+#include "util.h"
+
+/*
+ * isa.h
+ * -----
+ * The machine, once: what each opcode takes and how every kind of word is
+ * laid out. describe/validate (ordering_into_table) and encode
+ * (binary_table_parsing) both read these, so a different ISA profile is an
+ * edit to ISA_INSTRUCTIONS + the layouts here, nothing else.
+ */
+
+/* ---------- word layout (10 bits, ARE in bits 0..1) ---------- */
+#define TEN_BIT_MASK 0x3FF
+#define E_ARE 0x1   /* External (01) */
+#define R_ARE 0x2   /* Relocatable (10) */
+#define A_ARE 0x0   /* Absolute (00) */
+#define ARE_MASK 0x3
+
+/* first word: opcode | src mode | dest mode | ARE */
+#define ISA_OPCODE_SHIFT 6
+#define ISA_SRC_MODE_SHIFT 4
+#define ISA_DEST_MODE_SHIFT 2
+#define ISA_MODE_MASK 0x3
+
+/* register words (one register, a packed pair, a matrix index): src/row
+   register up, dest/column register down */
+#define ISA_SRC_REG_SHIFT 6
+#define ISA_DEST_REG_SHIFT 2
+#define ISA_REG_MASK 0x7
+
+/* immediate value / label address: 8-bit payload over the ARE bits */
+#define ISA_PAYLOAD_SHIFT 2
+#define ISA_PAYLOAD_MASK 0xFF
+
+#define ISA_FIRST_WORD(opcode, src_mode, dest_mode) \
+    ((((opcode) & 0xF) << ISA_OPCODE_SHIFT) | (((src_mode) & ISA_MODE_MASK) << ISA_SRC_MODE_SHIFT) | \
+     (((dest_mode) & ISA_MODE_MASK) << ISA_DEST_MODE_SHIFT) | A_ARE)
+#define ISA_REGISTER_PAIR_WORD(src_reg, dest_reg) \
+    ((((src_reg) & ISA_REG_MASK) << ISA_SRC_REG_SHIFT) | (((dest_reg) & ISA_REG_MASK) << ISA_DEST_REG_SHIFT) | A_ARE)
+#define ISA_MATRIX_INDEX_WORD(row_reg, col_reg) ISA_REGISTER_PAIR_WORD(row_reg, col_reg)
+#define ISA_REGISTER_WORD(reg, is_source) \
+    ((((reg) & ISA_REG_MASK) << ((is_source) ? ISA_SRC_REG_SHIFT : ISA_DEST_REG_SHIFT)) | A_ARE)
+#define ISA_PAYLOAD_WORD(payload, are) ((((payload) & ISA_PAYLOAD_MASK) << ISA_PAYLOAD_SHIFT) | ((are) & ARE_MASK))
+
+/* ---------- instructions ---------- */
+
+/* addressing mode sets (bit n = AddressingMode n allowed) */
+#define MODES_NONE          0x0
+#define MODES_ANY           0xF     /* 0|1|2|3 */
+#define MODES_NOT_IMMEDIATE 0xE     /* 1|2|3 */
+#define MODES_MEMORY        0x6     /* 1|2 (lea) */
+
+/* X(opcode, operands, src modes, dest modes) for every instruction */
+#define ISA_INSTRUCTIONS(X) \
+    X(MOV, 2, MODES_ANY,  MODES_NOT_IMMEDIATE) \
+    X(CMP, 2, MODES_ANY,  MODES_ANY)           \
+    X(ADD, 2, MODES_ANY,  MODES_NOT_IMMEDIATE) \
+    X(SUB, 2, MODES_ANY,  MODES_NOT_IMMEDIATE) \
+    X(NOT, 1, MODES_NONE, MODES_NOT_IMMEDIATE) \
+    X(CLR, 1, MODES_NONE, MODES_NOT_IMMEDIATE) \
+    X(LEA, 2, MODES_MEMORY, MODES_NOT_IMMEDIATE) \
+    X(INC, 1, MODES_NONE, MODES_NOT_IMMEDIATE) \
+    X(DEC, 1, MODES_NONE, MODES_NOT_IMMEDIATE) \
+    X(JMP, 1, MODES_NONE, MODES_NOT_IMMEDIATE) \
+    X(BNE, 1, MODES_NONE, MODES_NOT_IMMEDIATE) \
+    X(RED, 1, MODES_NONE, MODES_NOT_IMMEDIATE) \
+    X(PRN, 1, MODES_NONE, MODES_ANY)           \
+    X(JSR, 1, MODES_NONE, MODES_NOT_IMMEDIATE) \
+    X(RTS, 0, MODES_NONE, MODES_NONE)          \
+    X(STP, 0, MODES_NONE, MODES_NONE)
+
+#define ISA_MODE_COUNT 4
+
+typedef struct {
+    unsigned char operands;     /* how many it takes (0..2) */
+    unsigned char src_modes;    /* MODES_* */
+    unsigned char dest_modes;
+} IsaInstruction;
+
+extern const IsaInstruction isa_instructions[NUMBER_OF_COMMANDS];
+
+/* finished first word for every (opcode, src mode, dest mode), built by the
+   compiler from ISA_INSTRUCTIONS. a one operand instruction uses src mode 0,
+   none uses 0/0. ISA_ILLEGAL = that combination isnt allowed */
+#define ISA_ILLEGAL 0xFFFF
+extern const unsigned short isa_first_words[NUMBER_OF_COMMANDS][ISA_MODE_COUNT][ISA_MODE_COUNT];
+
+/* "Immediate", "Direct", ... (for messages) */
+const char *isa_mode_name(int mode);
+
+#endif /* ISA_H */
@@ -5,41 +5,159 @@
 
 #include "util.h"
 #include "labels.h"
+#include "asm_stats.h"
+
+#define INITIAL_LABELS 16
+#define INITIAL_LABEL_SLOTS 32
+
+/* ---------------- Name indexes ---------------- */
+
+/* both indexes (labels by name, symbols by name) are open addressing over
+   row numbers of an array whose rows start with the name (Label.label,
+   Symbol.name): names = that array, stride = the size of one row */
+#define NAME_AT(names, stride, row) ((names) + (size_t)(row) * (stride))
+
+/* slot of name[0..len) (or the empty slot it would go in) */
+static int find_name_slot(const int *slots, int slot_count, const char *names, size_t stride,
+                          const char *name, size_t len, unsigned int hash) {
+    unsigned int mask = (unsigned int)slot_count - 1;
+    unsigned int i = hash & mask;
+    while (slots[i] != NOT_FOUND) {
+        const char *stored = NAME_AT(names, stride, slots[i]);
+        if (strncmp(stored, name, len) == 0 && stored[len] == NULL_CHAR) return (int)i;
+        i = (i + 1) & mask;
+    }
+    return (int)i;
+}
+
+/* double an index (or make the first one). FALSE if memory ran out */
+static int grow_name_slots(int **slots, int *slot_count, const char *names, size_t stride,
+                           Arena *arena) {
+    int new_count = (*slot_count == 0) ? INITIAL_LABEL_SLOTS : *slot_count * GROWTH_FACTOR;
+    int *new_slots = arena_alloc(arena, (size_t)new_count * sizeof(int));
+    if (!new_slots) {
+        print_error("SYSTEM", -1, "Failed to allocate labels index (malloc)");
+        return FALSE;
+    }
+
+    int *old_slots = *slots;
+    int old_count = *slot_count;
+    int i;
+    for (i = 0; i < new_count; i++) new_slots[i] = NOT_FOUND;
+    for (i = 0; i < old_count; i++) {
+        if (old_slots[i] == NOT_FOUND) continue;
+        const char *stored = NAME_AT(names, stride, old_slots[i]);
+        size_t len = strlen(stored);
+        new_slots[find_name_slot(new_slots, new_count, names, stride, stored, len,
+                                 hash_name(stored, len))] = old_slots[i];
+    }
+    arena_free(arena, old_slots);
+    *slots = new_slots;
+    *slot_count = new_count;
+    return TRUE;
+}
+
+#define LABEL_NAMES(lbls) ((const char*)(lbls)->data)
+#define SYMBOL_NAMES(lbls) ((const char*)(lbls)->symbols)
+
+static int find_label_slot(const Labels *lbls, const char *name, size_t len, unsigned int hash) {
+    return find_name_slot(lbls->slots, lbls->slot_count, LABEL_NAMES(lbls), sizeof(Label),
+                          name, len, hash);
+}
+
+/* hook row index into the index: first of its name gets a slot, later ones
+   go to the end of that name's next_same chain. FALSE if memory ran out */
+static int index_label(Labels *lbls, int index) {
+    Label *lbl = &lbls->data[index];
+    size_t len = strlen(lbl->label);
+    unsigned int hash = hash_name(lbl->label, len);
+    int slot;
+
+    lbl->next_same = NOT_FOUND;
+    if (lbls->slot_count > 0) {
+        slot = find_label_slot(lbls, lbl->label, len, hash);
+        if (lbls->slots[slot] != NOT_FOUND) {
+            Label *last = &lbls->data[lbls->slots[slot]];
+            while (last->next_same != NOT_FOUND) last = &lbls->data[last->next_same];
+            last->next_same = index;
+            return TRUE;
+        }
+    }
+
+    /* new name: keep the index at most half full */
+    if ((lbls->name_count + 1) * 2 > lbls->slot_count &&
+        !grow_name_slots(&lbls->slots, &lbls->slot_count, LABEL_NAMES(lbls), sizeof(Label), lbls->arena))
+        return FALSE;
+    slot = find_label_slot(lbls, lbl->label, len, hash);
+    lbls->slots[slot] = index;
+    lbls->name_count++;
+    return TRUE;
+}
+
+/* the key a lookup means: cut like a stored label, spaces trimmed, one
+   trailing ':' dropped. returns its length, *start = where it begins */
+static size_t label_key(const char *name, const char **start) {
+    size_t len = strnlen(name, MAX_LABEL_LEN - 1);
+    while (len > 0 && isspace((unsigned char)*name)) {
+        name++;
+        len--;
+    }
+    while (len > 0 && isspace((unsigned char)name[len - 1])) len--;
+    if (len && name[len - 1] == SEMI_COLON_CHAR) len--;
+    *start = name;
+    return len;
+}
 
 /* ---------------- Construction / Destruction ---------------- */
 
-/* Allocates a new Labels table (initialy empty) */
-Labels* create_label_table() {
-    Labels *lbls = malloc(sizeof(Labels));
+/* Allocates a new Labels table (initialy empty), NULL if malloc fails */
+Labels* create_label_table(Arena *arena) {
+    Labels *lbls = arena_alloc(arena, sizeof(Labels));
     if (!lbls) {
         print_error("SYSTEM", -1, "Failed to allocate labels table (malloc)");
-        exit(EXIT_FAILURE); /* no point continuing if malloc fails */
+        return NULL; /* caller fails this file, the process keeps going */
     }
     lbls->data = NULL;
     lbls->size = 0;
     lbls->capacity = 0;
+    lbls->slots = NULL;
+    lbls->slot_count = 0;
+    lbls->name_count = 0;
+    lbls->symbols = NULL;
+    lbls->symbol_count = 0;
+    lbls->symbol_capacity = 0;
+    lbls->symbol_slots = NULL;
+    lbls->symbol_slot_count = 0;
+    lbls->arena = arena;
     return lbls;
 }
 
-/* Frees both the array data and the wrapper struct itself */
+/* Frees both the array data and the wrapper struct itself (arena: nothing to do) */
 void free_label_table(Labels *lbls) {
-    if (lbls) {
+    if (lbls && !lbls->arena) {
         free(lbls->data);
+        free(lbls->slots);
+        free(lbls->symbols);
+        free(lbls->symbol_slots);
         free(lbls);
     }
 }
 
-/* Make sure we got enough room for new entries (realloc doubles size each time) */
-void ensure_label_capacity(Labels *lbls) {
+/* Make sure we got enough room for new entries (realloc doubles size each time)
+   returns FALSE if realloc failed (table stays as it was) */
+int ensure_label_capacity(Labels *lbls) {
     if (lbls->size >= lbls->capacity) {
-        lbls->capacity = (lbls->capacity == 0) ? 4 : lbls->capacity * 2;
-        Label *new_data = realloc(lbls->data, lbls->capacity * sizeof(Label));
+        int new_capacity = (lbls->capacity == 0) ? INITIAL_LABELS : lbls->capacity * 2;
+        Label *new_data = arena_realloc(lbls->arena, lbls->data, lbls->capacity * sizeof(Label),
+                                        new_capacity * sizeof(Label));
         if (!new_data) {
             print_error("SYSTEM", -1, "Failed to reallocate labels table (realloc)");
-            exit(EXIT_FAILURE);
+            return FALSE;
         }
         lbls->data = new_data;
+        lbls->capacity = new_capacity;
     }
+    return TRUE;
 }
 
 /* ---------------- API ---------------- */
@@ -102,7 +220,7 @@ int add_label_row(Labels *lbls, const char *label, int table_row_index,
     }
 
     /* allocate space and copy into table */
-    ensure_label_capacity(lbls);
+    if (!ensure_label_capacity(lbls)) return FALSE;
     strncpy(lbls->data[lbls->size].label, start, MAX_LABEL_LEN);
     lbls->data[lbls->size].label[LABEL_NULL_CHAR_LOCATION] = NULL_CHAR;
 
@@ -110,6 +228,7 @@ int add_label_row(Labels *lbls, const char *label, int table_row_index,
     lbls->data[lbls->size].table_row_index = table_row_index;
     lbls->data[lbls->size].type = label_type;
     lbls->data[lbls->size].is_entry = is_entry;
+    if (!index_label(lbls, lbls->size)) return FALSE;
 
     lbls->size++;
     return TRUE;
@@ -156,54 +275,104 @@ for (i = 0; i < lbls->size; i++) {
     }
 }
 
+/* first row called key[0..len) exactly, NOT_FOUND if none */
+static int label_row(const Labels *lbls, const char *key, size_t len) {
+    if (lbls->slot_count == 0) return NOT_FOUND;
+    return lbls->slots[find_label_slot(lbls, key, len, hash_name(key, len))];
+}
+
+/* first row called name (after label_key), NOT_FOUND if none */
+static int first_label_named(const Labels *lbls, const char *name) {
+    const char *key;
+    size_t len = label_key(name, &key);
+    return label_row(lbls, key, len);
+}
+
 /* find a label by its name (ignores trailing ':' if user typed one) */
 Label* find_label_by_name(const Labels *lbls, const char *name) {
+    STATS_COUNT(ASM_COUNT_FIND_LABEL);
     if (!lbls || !name) return NULL;
 
-    char key[MAX_LABEL_LEN];
-    strncpy(key, name, MAX_LABEL_LEN - 1);
-    key[MAX_LABEL_LEN - 1] = NULL_CHAR;
+    int index = first_label_named(lbls, name);
+    return (index == NOT_FOUND) ? NULL : (Label*)&lbls->data[index]; /* cast away const */
+}
 
-    /* normalize */
-    char *start = key;
-    while (*start && isspace((unsigned char)*start)) start++;
-    char *end = start + strlen(start);
-    while (end > start && isspace((unsigned char)*(end - 1))) end--;
-    *end = NULL_CHAR;
-    size_t len = strlen(start);
-    if (len && start[len - 1] == SEMI_COLON_CHAR) start[len - 1] = NULL_CHAR;
+/* ---------------- Symbols ---------------- */
 
-    int i;
-for (i = 0; i < lbls->size; i++) {
-        if (strcmp(lbls->data[i].label, start) == 0) {
-            return (Label*)&lbls->data[i]; /* cast away const */
+int intern_symbol(Labels *lbls, const char *name) {
+    const char *key;
+    size_t len = label_key(name, &key);
+    unsigned int hash = hash_name(key, len);
+    int slot = NOT_FOUND;
+
+    if (lbls->symbol_slot_count > 0) {
+        slot = find_name_slot(lbls->symbol_slots, lbls->symbol_slot_count, SYMBOL_NAMES(lbls),
+                              sizeof(Symbol), key, len, hash);
+        if (lbls->symbol_slots[slot] != NOT_FOUND) return lbls->symbol_slots[slot];
+    }
+
+    if (lbls->symbol_count >= lbls->symbol_capacity) {
+        int new_capacity = (lbls->symbol_capacity == 0) ? INITIAL_LABELS : lbls->symbol_capacity * 2;
+        Symbol *new_symbols = arena_realloc(lbls->arena, lbls->symbols,
+                                            lbls->symbol_capacity * sizeof(Symbol),
+                                            new_capacity * sizeof(Symbol));
+        if (!new_symbols) {
+            print_error("SYSTEM", -1, "Failed to reallocate symbols table (realloc)");
+            return NOT_FOUND;
         }
+        lbls->symbols = new_symbols;
+        lbls->symbol_capacity = new_capacity;
+    }
+    if ((lbls->symbol_count + 1) * 2 > lbls->symbol_slot_count) {
+        if (!grow_name_slots(&lbls->symbol_slots, &lbls->symbol_slot_count, SYMBOL_NAMES(lbls),
+                             sizeof(Symbol), lbls->arena))
+            return NOT_FOUND;
+    }
+    slot = find_name_slot(lbls->symbol_slots, lbls->symbol_slot_count, SYMBOL_NAMES(lbls),
+                          sizeof(Symbol), key, len, hash);
+
+    /* key is at most MAX_LABEL_LEN - 1 chars (label_key cuts it) */
+    Symbol *symbol = &lbls->symbols[lbls->symbol_count];
+    memcpy(symbol->name, key, len);
+    symbol->name[len] = NULL_CHAR;
+    symbol->label = label_row(lbls, key, len); /* defined already? (one-pass wants it now) */
+    symbol->pending = NOT_FOUND;
+    lbls->symbol_slots[slot] = lbls->symbol_count;
+    return lbls->symbol_count++;
+}
+
+int find_symbol(const Labels *lbls, const char *name) {
+    const char *key;
+    size_t len = label_key(name, &key);
+    if (lbls->symbol_slot_count == 0) return NOT_FOUND;
+    return lbls->symbol_slots[find_name_slot(lbls->symbol_slots, lbls->symbol_slot_count,
+                                             SYMBOL_NAMES(lbls), sizeof(Symbol), key, len,
+                                             hash_name(key, len))];
+}
+
+void resolve_symbols(Labels *lbls) {
+    int i;
+    for (i = 0; i < lbls->symbol_count; i++) {
+        Symbol *symbol = &lbls->symbols[i];
+        symbol->label = label_row(lbls, symbol->name, strlen(symbol->name));
     }
-    return NULL;
+}
+
+Label* symbol_label(const Labels *lbls, int symbol) {
+    if (symbol < 0 || symbol >= lbls->symbol_count) return NULL;
+    int index = lbls->symbols[symbol].label;
+    return (index == NOT_FOUND) ? NULL : (Label*)&lbls->data[index]; /* cast away const */
 }
 
 /* count how many times a label name appears (could be duplicates in some cases) */
 int count_label_by_name(const Labels *lbls, const char *name) {
+    STATS_COUNT(ASM_COUNT_COUNT_LABEL);
     if (!lbls || !name) return 0;
 
-    char key[MAX_LABEL_LEN];
-    strncpy(key, name, MAX_LABEL_LEN - 1);
-    key[MAX_LABEL_LEN - 1] = NULL_CHAR;
-
-    char *start = key;
-    while (*start && isspace((unsigned char)*start)) start++;
-    char *end = start + strlen(start);
-    while (end > start && isspace((unsigned char)*(end - 1))) end--;
-    *end = NULL_CHAR;
-    size_t len = strlen(start);
-    if (len && start[len - 1] == SEMI_COLON_CHAR) start[len - 1] = NULL_CHAR;
-
     int count = 0;
     int i;
-for (i = 0; i < lbls->size; i++) {
-        if (strcmp(lbls->data[i].label, start) == 0) {
-            count++;
-        }
+    for (i = first_label_named(lbls, name); i != NOT_FOUND; i = lbls->data[i].next_same) {
+        count++;
     }
     return count;
 }
@@ -2,6 +2,7 @@
 #define LABELS_H
 
 #include "util.h"
+#include "arena.h"
 
 /*
  * Label
@@ -9,10 +10,12 @@
  * Represents one symbol in the assembler (like a variable or jump target).
  * Fields:
  *   - label : the text name itself
- *   - table_row_index : points into the instruction/data table
+ *   - table_row_index : its word in the program (code rows + data words before it)
  *   - decimal_address : resolved numeric adress (after base offset)
  *   - type : code/data/ext/unkown
  *   - is_entry : flag if it was declared as .entry
+ *   - next_same : next row with the same name (a .entry and its definition
+ *                 end up linked like this), NOT_FOUND = last one
  */
 typedef struct {
     char label[MAX_LABEL_LEN];
@@ -20,24 +23,55 @@ typedef struct {
     unsigned int decimal_address;
     LabelTypes type : 2;       /* pack into 2 bits just to be fancy (lol) */
     unsigned int is_entry : 1; /* just a single bit flag */
+    int next_same;
 } Label;
 
+/*
+ * Symbol
+ * ------
+ * A name some operand uses, interned to an id while the first pass reads the
+ * operand (the label may only show up later). resolve_symbols ties every id
+ * to its label row once the first pass is done, so pass two and the .ext
+ * writer never compare names again.
+ * In one-pass mode label is kept up to date as labels come in, and the uses
+ * seen before the label hang off pending until it shows up.
+ */
+typedef struct {
+    char name[MAX_LABEL_LEN];
+    int label;      /* first row in Labels.data with this name, NOT_FOUND = undefined */
+    int pending;    /* one-pass: first Table.fixups entry waiting on it, NOT_FOUND = none */
+} Symbol;
+
 /*
  * Labels
  * ------
  * Dynamic array of Label entries.
  * Keeps track of capacity so we can realloc as needed.
+ * (with an arena both the wrapper and the array live in it)
+ * slots is an open addressing index name -> first row with that name
+ * (NOT_FOUND = empty), the rest of them hang off it through next_same,
+ * so a lookup doesnt strcmp every label.
+ * symbols/symbol_slots are the same thing for the names operands use.
  */
 typedef struct Labels {
     Label *data;
     int size;
     int capacity;
+    int *slots;
+    int slot_count;     /* power of 2, at least 2x name_count */
+    int name_count;     /* distinct names */
+    Symbol *symbols;
+    int symbol_count;
+    int symbol_capacity;
+    int *symbol_slots;
+    int symbol_slot_count;
+    Arena *arena;       /* NULL = malloc'd */
 } Labels;
 
 /* --------- Construction / Destruction --------- */
-Labels* create_label_table();
+Labels* create_label_table(Arena *arena);
 void free_label_table(Labels *lbls);
-void ensure_label_capacity(Labels *lbls);
+int ensure_label_capacity(Labels *lbls);
 
 /* --------- Mutation / Lookup --------- */
 int add_label_row(Labels *lbls, const char *label, int table_row_index,
@@ -47,10 +81,27 @@ Label* get_label(Labels *lbls, int index);
 
 /* find_label_by_name
  * ------------------
- * searches for a label with the same name (ignores optional trailing ':')
+ * first label (in the order they were added) with the same name
+ * (ignores surrounding spaces + an optional trailing ':'), NULL if none.
+ * the others with that name follow through next_same
  */
 Label* find_label_by_name(const Labels *lbls, const char *name);
 
+/* --------- Symbols (operand references) --------- */
+
+/* id of name (same key rules as find_label_by_name), a new one the first
+   time a name shows up. NOT_FOUND if memory ran out */
+int intern_symbol(Labels *lbls, const char *name);
+
+/* id of name if an operand already used it, NOT_FOUND if not */
+int find_symbol(const Labels *lbls, const char *name);
+
+/* point every symbol at its label (call once all labels are in) */
+void resolve_symbols(Labels *lbls);
+
+/* label a resolved symbol stands for, NULL if undefined */
+Label* symbol_label(const Labels *lbls, int symbol);
+
 /* Other helpers */
 int is_label(char *word);
 void reset_labels_addresses(Labels *lbls, unsigned int offset);
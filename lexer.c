@@ -0,0 +1,200 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "lexer.h"
+#include "scan.h"
+
+/* char classes (one table lookup instead of isspace/strchr calls per char) */
+#define CC_SPACE      0x01  /* isspace() in the C locale */
+#define CC_WORD_DELIM 0x02  /* " \t\r\n", what ends the first word */
+#define CC_DIGIT      0x04
+
+static const unsigned char char_class[256] = {
+    ['\t'] = CC_SPACE | CC_WORD_DELIM,
+    ['\n'] = CC_SPACE | CC_WORD_DELIM,
+    ['\v'] = CC_SPACE,
+    ['\f'] = CC_SPACE,
+    ['\r'] = CC_SPACE | CC_WORD_DELIM,
+    [' ']  = CC_SPACE | CC_WORD_DELIM,
+    ['0'] = CC_DIGIT, ['1'] = CC_DIGIT, ['2'] = CC_DIGIT, ['3'] = CC_DIGIT, ['4'] = CC_DIGIT,
+    ['5'] = CC_DIGIT, ['6'] = CC_DIGIT, ['7'] = CC_DIGIT, ['8'] = CC_DIGIT, ['9'] = CC_DIGIT
+};
+
+#define HAS_CLASS(c, cls) (char_class[(unsigned char)(c)] & (cls))
+
+/* span without leading/trailing spaces */
+static void trim_span(const char *start, size_t length, Token *token) {
+    while (length > 0 && HAS_CLASS(*start, CC_SPACE)) {
+        start++;
+        length--;
+    }
+    while (length > 0 && HAS_CLASS(start[length - 1], CC_SPACE)) length--;
+    token->start = start;
+    token->length = length;
+}
+
+/* what an operand piece looks like (on its trimmed span) */
+static TokenKind classify_operand(const Token *token) {
+    const char *s = token->start;
+    size_t n = token->length;
+
+    if (n == 0) return TOKEN_EMPTY;
+    if (s[0] == IMMEDIATE_CHAR) return TOKEN_IMMEDIATE;
+    /* same test as is_register() != FALSE: 'r' + 1 or 2 more chars */
+    if (s[0] == R_CHAR && (n == 2 || n == 3)) return TOKEN_REGISTER;
+    if (memchr(s, SQUARE_BRACKET_START_CHAR, n)) return TOKEN_MATRIX;
+    if (s[0] == '"') return TOKEN_STRING;
+    if (HAS_CLASS(s[0], CC_DIGIT) || s[0] == PLUS_CHAR || s[0] == MINUS_CHAR) return TOKEN_NUMBER;
+    return TOKEN_IDENTIFIER;
+}
+
+/* where the ':' ',' and null chars of a line are (one scan, see scan.h) */
+typedef struct {
+    size_t commas[MAX_LINE_TOKENS];
+    int comma_count;
+    size_t colon;       /* first ':', length if none */
+    size_t nul;         /* first null char, length if none */
+} LineMarks;
+
+/* lines are at most MAX_LINE_LENGTH - 1 chars, 2 blocks */
+#define LEX_SCAN_BLOCKS ((MAX_LINE_LENGTH + SCAN_BLOCK_SIZE - 1) / SCAN_BLOCK_SIZE)
+
+static ScanSet marks_set;
+static pthread_once_t marks_set_once = PTHREAD_ONCE_INIT;
+
+static void init_marks_set(void) {
+    scan_set_init(&marks_set, ":,\0", 3, FALSE);
+}
+
+static void find_marks(const char *line, size_t length, LineMarks *marks) {
+    int block;
+
+    marks->comma_count = 0;
+    marks->colon = length;
+    marks->nul = length;
+
+    for (block = 0; block < LEX_SCAN_BLOCKS; block++) {
+        size_t base = (size_t)block * SCAN_BLOCK_SIZE;
+        if (base >= length) break;
+
+        uint64_t bits = scan_partial(&marks_set, line + base, length - base);
+        while (bits) {
+            size_t pos = base + SCAN_FIRST_BIT(bits);
+            bits &= bits - 1;
+
+            if (line[pos] == NULL_CHAR) {
+                /* nothing after a null char counts */
+                marks->nul = pos;
+                if (marks->colon > pos) marks->colon = pos;
+                return;
+            }
+            if (line[pos] == SEMI_COLON_CHAR) {
+                if (marks->colon == length) marks->colon = pos;
+            } else {
+                marks->commas[marks->comma_count++] = pos;
+            }
+        }
+    }
+}
+
+/* the operand pieces + commas of line[from..to) (the cut rest) */
+static void lex_operands(const char *line, size_t from, size_t to, const LineMarks *marks,
+                         LineTokens *out) {
+    size_t piece = from;
+    int next = 0;
+
+    /* commas before the rest (in the label/word) dont split anything */
+    while (next < marks->comma_count && marks->commas[next] < from) next++;
+
+    for (;;) {
+        int has_comma = next < marks->comma_count && marks->commas[next] < to;
+        size_t piece_end = has_comma ? marks->commas[next] : to;
+
+        if (piece_end > piece) {
+            Token *token = &out->operands[out->token_count++];
+            token->raw = line + piece;
+            token->raw_length = piece_end - piece;
+            trim_span(token->raw, token->raw_length, token);
+            token->kind = classify_operand(token);
+            out->operand_count++;
+        }
+        if (!has_comma) break;
+
+        Token *token = &out->operands[out->token_count++];
+        token->kind = TOKEN_COMMA;
+        token->start = token->raw = line + piece_end;
+        token->length = token->raw_length = 1;
+        out->comma_count++;
+        piece = piece_end + 1;
+        next++;
+    }
+}
+
+void lex_line(const char *line, size_t length, LineTokens *out) {
+    LineMarks marks;
+
+    pthread_once(&marks_set_once, init_marks_set);
+    if (length > MAX_LINE_LENGTH - 1) length = MAX_LINE_LENGTH - 1;
+
+    /* a c-string line always ended at the first null char, keep it that way */
+    find_marks(line, length, &marks);
+    length = marks.nul;
+
+    const char *end = line + length;
+    const char *after = line;
+
+    out->has_colon = FALSE;
+    out->has_word = FALSE;
+    out->has_rest = FALSE;
+    out->rest = end;
+    out->rest_length = 0;
+    out->operand_count = 0;
+    out->token_count = 0;
+    out->comma_count = 0;
+
+    /* label: up to the first ':' anywhere in the line */
+    if (marks.colon < length) {
+        out->has_colon = TRUE;
+        out->label.kind = TOKEN_LABEL;
+        trim_span(line, marks.colon, &out->label);
+        out->label.raw = line;
+        out->label.raw_length = marks.colon;
+        after = line + marks.colon + 1;
+    }
+
+    /* first word */
+    while (after < end && HAS_CLASS(*after, CC_WORD_DELIM)) after++;
+    if (after == end) return;
+
+    const char *word_end = after;
+    while (word_end < end && !HAS_CLASS(*word_end, CC_WORD_DELIM)) word_end++;
+    out->has_word = TRUE;
+    out->word.kind = (*after == DOT_CHAR) ? TOKEN_DIRECTIVE : TOKEN_MNEMONIC;
+    out->word.start = out->word.raw = after;
+    out->word.length = out->word.raw_length = (size_t)(word_end - after);
+
+    /* rest: after the one delimiter that ended the word */
+    if (word_end + 1 >= end) return;
+    out->has_rest = TRUE;
+    out->rest = word_end + 1;
+    out->rest_length = (size_t)(end - out->rest);
+
+    size_t rest_from = (size_t)(out->rest - line);
+    size_t cut = out->rest_length < MAX_OPERAND_LEN - 1 ? out->rest_length : MAX_OPERAND_LEN - 1;
+    lex_operands(line, rest_from, rest_from + cut, &marks, out);
+}
+
+const Token *lex_operand(const LineTokens *tokens, int index) {
+    int i;
+    for (i = 0; i < tokens->token_count; i++) {
+        if (tokens->operands[i].kind == TOKEN_COMMA) continue;
+        if (index-- == 0) return &tokens->operands[i];
+    }
+    return NULL;
+}
+
+void lex_copy(const char *start, size_t length, char *buf, size_t size) {
+    if (length > size - 1) length = size - 1;
+    memcpy(buf, start, length);
+    buf[length] = NULL_CHAR;
+}
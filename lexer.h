@@ -0,0 +1,73 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <stddef.h>
+#include "util.h"
+
+/*
+ * lexer.h
+ * -------
+ * One scan over an expanded line → typed tokens that point back into the
+ * line (start + length, nothing copied, nothing written, no static state so
+ * any number of threads can lex at once). The first pass reads these
+ * instead of strchr/split_token/strcpy-ing the line over and over.
+ *
+ * The splitting rules are the ones the first pass always had:
+ *   - the label is whatever comes before the first ':' (trimmed)
+ *   - the word is the first run of non " \t\r\n" chars after it
+ *   - the rest is everything after the one delimiter that ended the word,
+ *     cut at MAX_OPERAND_LEN - 1 chars (the size of a row's operands_string)
+ *   - the rest splits on every ',' (even inside quotes), empty pieces are
+ *     skipped but a piece of only spaces is still an operand
+ */
+
+typedef enum {
+    TOKEN_LABEL = 0,        /* "X" of "X: ..." */
+    TOKEN_MNEMONIC,         /* mov, stop, ... (or any word not starting with '.') */
+    TOKEN_DIRECTIVE,        /* .data .string .mat .entry .extern (any word starting with '.') */
+    TOKEN_REGISTER,         /* r + 1-2 chars (digit checked later, same as is_register) */
+    TOKEN_IMMEDIATE,        /* #... */
+    TOKEN_MATRIX,           /* name[..][..] (name may be empty, like in .mat) */
+    TOKEN_STRING,           /* "... */
+    TOKEN_NUMBER,           /* anything starting with a digit or sign */
+    TOKEN_IDENTIFIER,       /* a symbol (label reference) */
+    TOKEN_EMPTY,            /* operand piece that is only spaces */
+    TOKEN_COMMA
+} TokenKind;
+
+typedef struct {
+    TokenKind kind;
+    const char *start;      /* trimmed span */
+    size_t length;
+    const char *raw;        /* operands: the whole piece between the commas */
+    size_t raw_length;
+} Token;
+
+/* at most one token per char of a line */
+#define MAX_LINE_TOKENS MAX_LINE_LENGTH
+
+typedef struct {
+    int has_colon;
+    Token label;            /* only if has_colon (length 0 = "Empty label") */
+    int has_word;
+    Token word;
+    int has_rest;           /* FALSE = nothing after the word (NULL rest) */
+    const char *rest;
+    size_t rest_length;
+    Token operands[MAX_LINE_TOKENS]; /* operand pieces + commas, in order */
+    int operand_count;      /* pieces only (not counting commas) */
+    int token_count;        /* everything in operands[] */
+    int comma_count;
+} LineTokens;
+
+/* lex line[0..length) (no '\n', no null char needed, past MAX_LINE_LENGTH - 1
+   chars is ignored). the ':' and ',' are found with the block scanner (scan.h) */
+void lex_line(const char *line, size_t length, LineTokens *out);
+
+/* the index-th operand piece (0 based), NULL if there arent that many */
+const Token *lex_operand(const LineTokens *tokens, int index);
+
+/* copy a span into buf as a c-string (cut at size - 1) */
+void lex_copy(const char *start, size_t length, char *buf, size_t size);
+
+#endif /* LEXER_H */
@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libasm.h"
+#include "labels.h"
+#include "ordering_into_table.h"
+#include "table.h"
+#include "binary_table_parsing.h"
+#include "pre_assembly.h"
+#include "file_formating.h"
+#include "output_capture.h"
+#include "asm_stats.h"
+#include "arena.h"
+#include "task_pool.h"
+
+/* first guess of table rows per expanded line (a command is 1-3 words,
+   labels/comments/blank lines none), capped at what a file may use */
+#define ROWS_PER_LINE 2
+
+/* bytes per line for sizing the expanded lines up front */
+#define BYTES_PER_LINE 16
+
+struct AsmArena {
+    Arena arena;
+};
+
+/* adapters so all three exporters fit one memory-writer helper */
+typedef int (*SectionWriter)(FILE *fp, Table *tbl, Labels *lbls);
+
+static int write_object_section(FILE *fp, Table *tbl, Labels *lbls) {
+    (void)lbls;
+    return write_object_stream(fp, tbl);
+}
+
+static int write_entry_section(FILE *fp, Table *tbl, Labels *lbls) {
+    (void)tbl;
+    return write_entry_stream(fp, lbls);
+}
+
+static int write_external_section(FILE *fp, Table *tbl, Labels *lbls) {
+    return write_external_stream(fp, tbl, lbls);
+}
+
+/* run one exporter into a malloc'd buffer (FALSE only if the stream couldnt open) */
+static int write_memory_section(char **data, size_t *size, Table *tbl, Labels *lbls,
+                                SectionWriter writer) {
+    FILE *fp = open_memstream(data, size);
+    if (!fp) {
+        err_printf("Error: failed to open in-memory output stream\n");
+        return FALSE;
+    }
+    writer(fp, tbl, lbls);
+    fclose(fp);
+    return TRUE;
+}
+
+/* close a stage: store its wall time, mark it as run */
+static void finish_stage(AsmStats *stats, AsmStage stage, double started) {
+    stats->stage_seconds[stage] = monotonic_seconds() - started;
+    stats->stages_run = stage + 1;
+}
+
+/*
+ * assemble_expanded
+ * -----------------
+ * Stages 2-4 on the macro-expanded lines (src_name is only for messages).
+ */
+static int assemble_expanded(const LineSink *expanded, const char *src_name, AsmResult *result,
+                             const AsmOptions *options, Arena *arena) {
+    int one_pass = options ? options->one_pass : FALSE;
+    int parallel_rows = options ? options->parallel_min_rows : 0;
+    int expected_rows = expanded->line_count < (MAX_TABLE_ROWS + 1) / ROWS_PER_LINE
+                      ? expanded->line_count * ROWS_PER_LINE : MAX_TABLE_ROWS + 1;
+    Table *tbl = create_table(arena, expected_rows); /* holds rows (IC/DC stuff) */
+    Labels *lbls = create_label_table(arena);        /* symbol table (entries, externs, etc) */
+
+    if (!tbl || !lbls) {
+        err_printf("Error: failed to allocate memory for table or labels\n");
+        if (tbl) free_table(tbl);
+        if (lbls) free_label_table(lbls);
+        return FALSE;
+    }
+    tbl->encode_now = one_pass; /* words go in as rows are added, see encode_added_row */
+    tbl->parallel_rows = parallel_rows == 0 ? ASM_PARALLEL_MIN_ROWS : (parallel_rows < 0 ? 0 : parallel_rows);
+
+    /* ---------- Stage 2: build table & labels ---------- */
+    /* parses tokens, fills Table + Labels; performs semantic checks (kinda strict) */
+    double started = monotonic_seconds();
+    int ok = !process_file_to_table_and_labels(tbl, lbls, expanded, src_name);
+    finish_stage(&result->stats, ASM_STAGE_FIRST_PASS, started);
+
+    if (ok) {
+        /* Set IC/DC base addresses (offset 100) consistently on both tables
+           (this keeps machine code addresses aligned to the spec’s base adress). */
+        reset_addresses(tbl, BASE_ADDRESS);
+
+        /* one-pass with every word already in: theres no second pass to run.
+           anything left over (errors, undefined labels) goes the normal way,
+           so the messages come out exactly like they always did */
+        if (!one_pass || !one_pass_complete(tbl, lbls)) {
+            reset_labels_addresses(lbls, BASE_ADDRESS);
+
+            /* ---------- Stage 3: translate table → binary using labels ---------- */
+            started = monotonic_seconds();
+            ok = parse_table_to_binary(tbl, lbls, src_name);
+            finish_stage(&result->stats, ASM_STAGE_SECOND_PASS, started);
+        } else {
+            result->stats.stages_skipped |= 1u << ASM_STAGE_SECOND_PASS;
+        }
+    }
+
+    /* ---------- Stage 4: export artifacts into memory ---------- */
+    if (ok) {
+        started = monotonic_seconds();
+        ok = write_memory_section(&result->object, &result->object_size, tbl, lbls, write_object_section) &&
+             write_memory_section(&result->entries, &result->entries_size, tbl, lbls, write_entry_section) &&
+             write_memory_section(&result->externals, &result->externals_size, tbl, lbls, write_external_section);
+        finish_stage(&result->stats, ASM_STAGE_EXPORT, started);
+    }
+
+    free_table(tbl);
+    free_label_table(lbls);
+    return ok;
+}
+
+/* a prelude is just a macro table nobody writes to after parsing */
+struct AsmPrelude {
+    MacroTable macros;
+};
+
+/* the actual pipeline (runs with a capture active) */
+static int run_pipeline(const char *source, size_t source_size, const char *name,
+                        const AsmOptions *options, AsmResult *result, Arena *arena) {
+    char src_name[MAX_FILENAME];
+    LineSink expanded;
+
+    /* lines in later msgs are .as lines (via the sink's line map), so name the .as */
+    snprintf(src_name, MAX_FILENAME, "%s.as", name);
+
+    /* ---------- Stage 1: pre-assembly, source buffer → line sink ---------- */
+    sink_init(&expanded, arena);
+    sink_reserve(&expanded, source_size + 1, (int)(source_size / BYTES_PER_LINE) + 1); /* just a head start */
+    double started = monotonic_seconds();
+    const MacroTable *prelude = (options && options->prelude) ? &options->prelude->macros : NULL;
+    int failed = run_pre_assembly_to_sink(source, source_size, &expanded, name, prelude, arena);
+    finish_stage(&result->stats, ASM_STAGE_PRE_ASSEMBLY, started);
+
+    /* the hook sees the same bytes a .am file would hold */
+    if (!failed && options && options->on_expanded &&
+        !options->on_expanded(expanded.text ? expanded.text : EMPTY_STRING, expanded.size, options->context)) {
+        failed = TRUE;
+    }
+
+    /* ---------- Stages 2-4 straight off the expanded lines (no re-read) ---------- */
+    int ok = !failed && assemble_expanded(&expanded, src_name, result, options, arena);
+    sink_free(&expanded);
+    return ok;
+}
+
+/* move captured text + diagnostics into the result (caller frees capture after) */
+static void take_capture(AsmResult *result, OutputCapture *cap) {
+    int i;
+    if (cap->chunk_count > 0) {
+        result->messages = calloc((size_t)cap->chunk_count, sizeof(AsmMessage));
+        for (i = 0; result->messages && i < cap->chunk_count; i++) {
+            AsmMessage *m = &result->messages[result->message_count];
+            m->text = malloc(cap->chunks[i].length + 1);
+            if (!m->text) break;
+            memcpy(m->text, cap->text + cap->chunks[i].offset, cap->chunks[i].length);
+            m->text[cap->chunks[i].length] = '\0';
+            m->size = cap->chunks[i].length;
+            m->is_error = cap->chunks[i].to_stderr;
+            result->message_count++;
+        }
+    }
+
+    /* diagnostics strings just change owner */
+    result->diagnostics = (AsmDiagnostic*)calloc((size_t)cap->diagnostic_count + 1, sizeof(AsmDiagnostic));
+    for (i = 0; result->diagnostics && i < cap->diagnostic_count; i++) {
+        result->diagnostics[i].file = cap->diagnostics[i].file;
+        result->diagnostics[i].line = cap->diagnostics[i].line;
+        result->diagnostics[i].message = cap->diagnostics[i].message;
+        result->diagnostic_count++;
+    }
+    if (result->diagnostics) cap->diagnostic_count = 0; /* so capture_free skips them */
+}
+
+int asm_assemble(const char *source, size_t source_size, const char *name,
+                 const AsmOptions *options, AsmResult *result) {
+    OutputCapture cap;
+    Arena own_arena;
+    Arena *arena = (options && options->arena) ? &options->arena->arena : NULL;
+    memset(result, 0, sizeof(*result));
+    memset(&cap, 0, sizeof(cap));
+    if (!arena) {
+        arena_init(&own_arena, 0);
+        arena = &own_arena;
+    }
+
+    OutputCapture *outer = capture_begin(&cap);
+    AsmStats *outer_stats = stats_begin(&result->stats);
+    int ok = run_pipeline(source ? source : "", source ? source_size : 0, name, options, result, arena);
+    stats_end(outer_stats);
+    capture_end(outer);
+
+    /* nothing in the result points into the arena */
+    if (arena == &own_arena) arena_release(arena);
+    else arena_reset(arena);
+
+    take_capture(result, &cap);
+    capture_free(&cap);
+
+    if (!ok) {
+        /* failed files never have outputs (same as the cli removing them) */
+        free(result->object);
+        free(result->entries);
+        free(result->externals);
+        result->object = result->entries = result->externals = NULL;
+        result->object_size = result->entries_size = result->externals_size = 0;
+    }
+    result->success = ok;
+    return ok;
+}
+
+void asm_free_result(AsmResult *result) {
+    if (!result) return;
+    int i;
+    for (i = 0; i < result->diagnostic_count; i++) {
+        free(result->diagnostics[i].file);
+        free(result->diagnostics[i].message);
+    }
+    for (i = 0; i < result->message_count; i++) free(result->messages[i].text);
+    free(result->diagnostics);
+    free(result->messages);
+    free(result->object);
+    free(result->entries);
+    free(result->externals);
+    memset(result, 0, sizeof(*result));
+}
+
+AsmPrelude *asm_prelude_create(const char *source, size_t source_size, const char *name,
+                               AsmResult *result) {
+    OutputCapture cap;
+    memset(result, 0, sizeof(*result));
+    memset(&cap, 0, sizeof(cap));
+
+    AsmPrelude *prelude = calloc(1, sizeof(AsmPrelude));
+    if (!prelude) return NULL;
+
+    OutputCapture *outer = capture_begin(&cap);
+    int had_error = parse_prelude(source ? source : "", source ? source_size : 0, name, &prelude->macros);
+    capture_end(outer);
+
+    take_capture(result, &cap);
+    capture_free(&cap);
+
+    result->success = !had_error;
+    if (had_error) {
+        asm_prelude_free(prelude);
+        return NULL;
+    }
+    return prelude;
+}
+
+void asm_prelude_free(AsmPrelude *prelude) {
+    if (!prelude) return;
+    free_macro_table(&prelude->macros);
+    free(prelude);
+}
+
+AsmArena *asm_arena_create(void) {
+    AsmArena *arena = malloc(sizeof(AsmArena));
+    if (arena) arena_init(&arena->arena, 0);
+    return arena;
+}
+
+void asm_arena_free(AsmArena *arena) {
+    if (!arena) return;
+    arena_release(&arena->arena);
+    free(arena);
+}
+
+size_t asm_arena_capacity(const AsmArena *arena) {
+    return arena ? arena_capacity(&arena->arena) : 0;
+}
+
+int asm_parallel_threads(int threads) {
+    return task_pool_threads(threads);
+}
@@ -0,0 +1,154 @@
+#ifndef LIBASM_H
+#define LIBASM_H
+
+#include <stddef.h>
+
+/*
+ * libasm.h
+ * --------
+ * In-memory assembler: source text in, .ob/.ent/.ext text + diagnostics out.
+ * No files are opened, nothing is printed, nothing calls exit(). Every call
+ * owns its own state so several threads can assemble at the same time.
+ */
+
+/* bump whenever output for the same source can change (cached results are keyed on it) */
+#define LIBASM_VERSION "1.2"
+
+/* one error reported by a stage (file is the name used in the msg, like "foo.as";
+   line is always the .as line, macro expansions report the line of the call) */
+typedef struct {
+    char *file;
+    int line;
+    char *message;
+} AsmDiagnostic;
+
+/* one piece of the text a cli run would have printed, in order */
+typedef struct {
+    int is_error;   /* 1 = would go to stderr, 0 = stdout */
+    char *text;
+    size_t size;
+} AsmMessage;
+
+/* called once the source is macro-expanded (before the first pass), text is
+   exactly what a .am file would hold. only there for callers who want it,
+   the first pass reads the expanded lines from memory either way.
+   anything printed from here lands in the messages at the right spot.
+   return FALSE to stop the assembly (counts as failed). */
+typedef int (*AsmExpandedHook)(const char *text, size_t size, void *context);
+
+/* macros shared by many assemblies (a batch's common mcro definitions).
+   parsed once by asm_prelude_create, after that only read, so any number of
+   threads can assemble with the same one */
+typedef struct AsmPrelude AsmPrelude;
+
+/* scratch memory for assemblies that run one after another (a batch worker,
+   a server thread): every table/buffer one file needs comes out of it and is
+   reset, not freed, when the file is done, so the next one reuses it.
+   one per thread, never shared while in use */
+typedef struct AsmArena AsmArena;
+
+/* optional knobs (pass NULL for defaults) */
+typedef struct {
+    AsmExpandedHook on_expanded;
+    void *context;
+    const AsmPrelude *prelude;  /* macros every file can call, NULL = none */
+    AsmArena *arena;            /* NULL = this call allocates (and frees) its own */
+    int one_pass;               /* encode words while the first pass reads the file, forward
+                                   refs get patched when their label shows up (same outputs
+                                   and messages as the default two passes) */
+    int parallel_min_rows;      /* pass two runs on the shared thread pool for tables
+                                   with at least this many rows. 0 = ASM_PARALLEL_MIN_ROWS,
+                                   -1 = never */
+} AsmOptions;
+
+/* default for parallel_min_rows. a normal program (255 words max) never gets
+   near it, its for builds with a raised MAX_TABLE_ROWS (see bench/encode_bench
+   for where the crossover is on a given machine) */
+#define ASM_PARALLEL_MIN_ROWS 4096
+
+/* the four stages, in the order they run */
+typedef enum {
+    ASM_STAGE_PRE_ASSEMBLY = 0,
+    ASM_STAGE_FIRST_PASS,
+    ASM_STAGE_SECOND_PASS,
+    ASM_STAGE_EXPORT,
+    ASM_STAGE_COUNT
+} AsmStage;
+
+/* hot calls we count (to see where a slow file spends its time) */
+typedef enum {
+    ASM_COUNT_FIND_LABEL = 0,     /* find_label_by_name */
+    ASM_COUNT_COUNT_LABEL,        /* count_label_by_name */
+    ASM_COUNT_IS_MATRIX,
+    ASM_COUNT_IS_REGISTER,
+    ASM_COUNT_IS_NUMBER,
+    ASM_COUNT_TABLE_REALLOC,      /* ensure_capacity actually growing the table */
+    ASM_COUNT_MACRO_EXPANSION,    /* macro calls expanded by the pre-assembler */
+    ASM_COUNTER_COUNT
+} AsmCounter;
+
+/* timing + counters of one assembly (stages_run = how many stages got to run) */
+typedef struct {
+    int stages_run;
+    double stage_seconds[ASM_STAGE_COUNT];
+    unsigned long counters[ASM_COUNTER_COUNT];
+    unsigned stages_skipped;  /* bit (1 << stage) per stage that had nothing to do
+                                 (second pass of a complete --one-pass), its time stays 0 */
+} AsmStats;
+
+/* stable names for the json ("pre_assembly", "find_label_by_name", ...) */
+const char *asm_stage_name(int stage);
+const char *asm_counter_name(int counter);
+
+/* everything one assembly produced (free with asm_free_result) */
+typedef struct {
+    int success;
+    char *object;      /* .ob text, size 0 = file would not exist */
+    size_t object_size;
+    char *entries;     /* .ent text */
+    size_t entries_size;
+    char *externals;   /* .ext text */
+    size_t externals_size;
+    AsmDiagnostic *diagnostics;
+    int diagnostic_count;
+    AsmMessage *messages;
+    int message_count;
+    AsmStats stats;
+} AsmResult;
+
+/*
+ * asm_assemble
+ * ------------
+ * Runs pre-assembly → first pass → encoding → export on source[0..source_size).
+ * name is the base name used in messages (same as the cli's argument).
+ * returns TRUE if it compiled. result is always filled (even on failure).
+ */
+int asm_assemble(const char *source, size_t source_size, const char *name,
+                 const AsmOptions *options, AsmResult *result);
+void asm_free_result(AsmResult *result);
+
+/*
+ * asm_prelude_create
+ * ------------------
+ * Parses source (only mcro ... mcroend blocks, comments and blank lines) into
+ * a prelude. A file using it gets those macros as if they were defined at its
+ * top: defining one of them again is the usual "already defined" error.
+ * returns NULL if the prelude has errors; result gets the messages either way
+ * (free it with asm_free_result, only messages/diagnostics are filled).
+ */
+AsmPrelude *asm_prelude_create(const char *source, size_t source_size, const char *name,
+                               AsmResult *result);
+void asm_prelude_free(AsmPrelude *prelude);
+
+/* NULL if out of memory (asm_assemble just works without one then) */
+AsmArena *asm_arena_create(void);
+void asm_arena_free(AsmArena *arena);
+
+/* bytes the arena keeps between files (for stats/benches) */
+size_t asm_arena_capacity(const AsmArena *arena);
+
+/* threads the shared pass-two pool starts (only before its first use, after
+   that it just says how many it has). 0 = one per cpu minus the caller */
+int asm_parallel_threads(int threads);
+
+#endif /* LIBASM_H */
@@ -0,0 +1,59 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "line_reader.h"
+#include "scan.h"
+#include "util.h"
+
+/* longest line we take (80 chars, the old fgets buffer held 80 + '\n' + null) */
+#define MAX_LINE_CHARS (MAX_LINE_LENGTH - 2)
+
+static ScanSet newline_set;
+static pthread_once_t newline_set_once = PTHREAD_ONCE_INIT;
+
+static void init_newline_set(void) {
+    scan_set_init(&newline_set, "\n", 1, FALSE);
+}
+
+/* newline bitmap of the 64 byte block at reader->block (shorter at the end) */
+static uint64_t scan_newlines(const LineReader *reader) {
+    return scan_partial(&newline_set, reader->block, (size_t)(reader->end - reader->block));
+}
+
+void line_reader_init(LineReader *reader, const char *text, size_t size) {
+    pthread_once(&newline_set_once, init_newline_set);
+    reader->pos = text;
+    reader->end = text + size;
+    reader->block = text;
+    reader->newlines = size > 0 ? scan_newlines(reader) : 0;
+}
+
+/* next '\n' from the bitmaps (each line eats exactly one), NULL if there is none left */
+static const char *next_newline(LineReader *reader) {
+    while (reader->newlines == 0) {
+        reader->block += SCAN_BLOCK_SIZE;
+        if (reader->block >= reader->end) {
+            reader->block = reader->end;
+            return NULL;
+        }
+        reader->newlines = scan_newlines(reader);
+    }
+
+    const char *newline = reader->block + SCAN_FIRST_BIT(reader->newlines);
+    reader->newlines &= reader->newlines - 1;
+    return newline;
+}
+
+int line_reader_next(LineReader *reader, LineView *line) {
+    if (reader->pos >= reader->end) return FALSE;
+
+    const char *newline = next_newline(reader);
+    const char *line_end = newline ? newline : reader->end;
+
+    line->start = reader->pos;
+    line->length = (size_t)(line_end - reader->pos);
+    line->too_long = line->length > MAX_LINE_CHARS;
+
+    reader->pos = newline ? newline + 1 : reader->end;
+    return TRUE;
+}
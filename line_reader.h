@@ -0,0 +1,35 @@
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * LineReader
+ * ----------
+ * Walks a source buffer (whole file already in memory) line by line and hands
+ * out views into it: pointer + length, no copy, no '\n', nothing gets written.
+ * The buffer doesnt need a null char at the end.
+ * A line longer than the 80 char limit comes back flagged too_long (its view
+ * still covers all of it, so the next line starts at the right spot).
+ * Newlines are found 64 bytes at a time with the structural scanner (scan.h).
+ */
+typedef struct {
+    const char *start;
+    size_t length;      /* without the '\n' */
+    int too_long;
+} LineView;
+
+typedef struct {
+    const char *pos;
+    const char *end;
+    const char *block;      /* 64 byte block the bitmap is for */
+    uint64_t newlines;      /* '\n's in it not handed out yet */
+} LineReader;
+
+void line_reader_init(LineReader *reader, const char *text, size_t size);
+
+/* next line into *line, FALSE when the buffer is done */
+int line_reader_next(LineReader *reader, LineView *line);
+
+#endif /* LINE_READER_H */
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "line_sink.h"
+#include "util.h"
+
+#define SINK_INITIAL_TEXT 4096
+#define SINK_INITIAL_LINES 128
+
+void sink_init(LineSink *sink, Arena *arena) {
+    memset(sink, 0, sizeof(*sink));
+    sink->arena = arena;
+}
+
+void sink_free(LineSink *sink) {
+    Arena *arena = sink->arena;
+    arena_free(arena, sink->text);
+    arena_free(arena, sink->lines);
+    memset(sink, 0, sizeof(*sink));
+    sink->arena = arena;
+}
+
+int sink_reserve(LineSink *sink, size_t extra_text, int extra_lines) {
+    if (sink->size + extra_text > sink->capacity) {
+        size_t capacity = sink->capacity ? sink->capacity : SINK_INITIAL_TEXT;
+        while (capacity < sink->size + extra_text) capacity *= GROWTH_FACTOR;
+        char *text = arena_realloc(sink->arena, sink->text, sink->size, capacity);
+        if (!text) return FALSE;
+        sink->text = text;
+        sink->capacity = capacity;
+    }
+    if (sink->line_count + extra_lines > sink->line_capacity) {
+        int capacity = sink->line_capacity ? sink->line_capacity : SINK_INITIAL_LINES;
+        while (capacity < sink->line_count + extra_lines) capacity *= GROWTH_FACTOR;
+        SinkLine *lines = arena_realloc(sink->arena, sink->lines, (size_t)sink->line_count * sizeof(SinkLine),
+                                        (size_t)capacity * sizeof(SinkLine));
+        if (!lines) return FALSE;
+        sink->lines = lines;
+        sink->line_capacity = capacity;
+    }
+    return TRUE;
+}
+
+int sink_add_line(LineSink *sink, const char *line, size_t length, int source_line) {
+    if (!sink_reserve(sink, length + 1, 1)) return FALSE;
+
+    SinkLine *entry = &sink->lines[sink->line_count++];
+    entry->offset = sink->size;
+    entry->length = length;
+    entry->source_line = source_line;
+
+    memcpy(sink->text + sink->size, line, length);
+    sink->size += length;
+    sink->text[sink->size++] = NEWLINE_CHAR;
+    return TRUE;
+}
+
+int sink_add_block(LineSink *sink, const char *text, size_t size, int source_line) {
+    int line_count = 0;
+    const char *p = text;
+    const char *end = text + size;
+    while (p < end && (p = memchr(p, NEWLINE_CHAR, (size_t)(end - p))) != NULL) {
+        line_count++;
+        p++;
+    }
+    if (!sink_reserve(sink, size, line_count)) return FALSE;
+
+    size_t start = sink->size;
+    memcpy(sink->text + start, text, size);
+    sink->size += size;
+
+    /* line map: walk the copy once more for the line starts */
+    p = sink->text + start;
+    end = sink->text + sink->size;
+    while (p < end) {
+        const char *newline = memchr(p, NEWLINE_CHAR, (size_t)(end - p));
+        SinkLine *entry = &sink->lines[sink->line_count++];
+        entry->offset = (size_t)(p - sink->text);
+        entry->length = (size_t)(newline - p);
+        entry->source_line = source_line;
+        p = newline + 1;
+    }
+    return TRUE;
+}
+
+int sink_copy_line(const LineSink *sink, int i, char *buf, size_t size) {
+    const SinkLine *entry = &sink->lines[i];
+    size_t length = entry->length < size - 1 ? entry->length : size - 1;
+    memcpy(buf, sink->text + entry->offset, length);
+    buf[length] = NULL_CHAR;
+    return entry->source_line;
+}
@@ -0,0 +1,51 @@
+#ifndef LINE_SINK_H
+#define LINE_SINK_H
+
+#include <stddef.h>
+#include "arena.h"
+
+/*
+ * LineSink
+ * --------
+ * Where the pre-assembler puts the expanded program: one growable text buffer
+ * (exactly what a .am file would hold, every line ends with '\n') plus a line
+ * map, so the first pass can read the lines straight from memory and still
+ * report errors with the .as line each one came from.
+ * Lines coming out of a macro map to the line that called the macro.
+ * With an arena both buffers come out of it (sink_free leaves them there).
+ */
+typedef struct {
+    size_t offset;      /* start inside LineSink.text */
+    size_t length;      /* without the '\n' */
+    int source_line;    /* line number in the .as file */
+} SinkLine;
+
+typedef struct {
+    char *text;
+    size_t size;
+    size_t capacity;
+    SinkLine *lines;
+    int line_count;
+    int line_capacity;
+    Arena *arena;       /* NULL = malloc'd */
+} LineSink;
+
+void sink_init(LineSink *sink, Arena *arena);
+void sink_free(LineSink *sink);
+
+/* room for extra_text more bytes and extra_lines more lines up front
+   (so a sink sized from the source doesnt grow while filling). FALSE if
+   memory ran out */
+int sink_reserve(LineSink *sink, size_t extra_text, int extra_lines);
+
+/* append line[0..length) (no newline in it) + '\n'; FALSE if memory ran out */
+int sink_add_line(LineSink *sink, const char *line, size_t length, int source_line);
+
+/* append text[0..size) that is already whole lines (each ending with '\n'),
+   all mapped to source_line. FALSE if memory ran out */
+int sink_add_block(LineSink *sink, const char *text, size_t size, int source_line);
+
+/* copy line i into buf as a c-string (cut at size-1), returns its .as line */
+int sink_copy_line(const LineSink *sink, int i, char *buf, size_t size);
+
+#endif /* LINE_SINK_H */
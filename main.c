@@ -2,134 +2,166 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "labels.h"
-#include "ordering_into_table.h"
-#include "table.h"
-#include "binary_table_parsing.h"
-#include "pre_assembly.h"
-#include "file_formating.h"
+#include "util.h"
+#include "batch_runner.h"
+#include "asm_server.h"
+#include "assembler.h"
+#include "batch_input.h"
+#include "output_cache.h"
+
+#define DEFAULT_SERVER_WORKERS 4
+
+/*
+ * option_value
+ * ------------
+ * Matches "--name VALUE" or "--name=VALUE" at argv[*i].
+ * returns the value (and moves *i past it), or NULL if argv[*i] isnt that option.
+ * missing value → returns "" so the caller complains.
+ */
+static const char *option_value(int argc, char *argv[], int *i, const char *name) {
+    size_t len = strlen(name);
+    if (strncmp(argv[*i], name, len) != 0) return NULL;
+
+    if (argv[*i][len] == '=') return argv[*i] + len + 1;
+    if (argv[*i][len] != NULL_CHAR) return NULL; /* some other option with same prefix */
+    if (*i + 1 >= argc) return EMPTY_STRING;
+    return argv[++(*i)];
+}
 
-int main(int argc, char *argv[]) {
-    FILE *fp;
-    char filename[MAX_FILENAME];
+/* parse a positive count like the N of "--jobs N" (returns 0 if its not one) */
+static int parse_count(const char *text) {
+    double value;
+    if (!is_number(text, &value) || value < 1) return 0;
+    return (int)value;
+}
 
-    /* CLI usage check — must pass at least one base file name (without ext) */
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <file1> [file2] [file3] ...\n", argv[0]);
+int main(int argc, char *argv[]) {
+    int jobs = 0;                 /* 0 = not given */
+    int queue_size = DEFAULT_SERVER_QUEUE;
+    const char *socket_path = NULL;
+    const char *cache_dir = NULL;
+    const char *stats_path = NULL;
+    const char *prelude_path = NULL;
+    AssembleSettings settings;
+    const char *value;
+    int first_file = 1;
+    int input_count = 0;
+
+    /* at most one input per argv word (dirs from --recursive, then the files) */
+    BatchInput *inputs = malloc((size_t)argc * sizeof(BatchInput));
+    if (!inputs) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
         return EXIT_FAILURE;
     }
-
-    int i;
-
-    /* iterate user-supplied input basenames: foo → foo.as → foo.am → outputs */
-    for (i = 1; i < argc; i++) {
-
-        /* ---------- Stage 1: pre-assembly on <file>.as ---------- */
-        /* expands macros etc; outputs a .am file on success */
-        snprintf(filename, MAX_FILENAME, "%s.as", argv[i]);     /* build source path */
-        fp = fopen(filename, "r");
-        if (fp == NULL) {
-            /* cant open input file — probably bad path or perms */
-            fprintf(stderr, "%s: Error - cannot open .as file\n", argv[i]);
-            fprintf(stderr,
-                    "%s: Due to errors no | .ob | .ext | .ent | files created\n",
-                    argv[i]);
-            continue; /* process next file (dont crash whole batch) */
-        }
-
-        int failed = run_pre_assembly(fp, argv[i]); /* argv[i] is base name w/o ext */
-        fclose(fp);
-        if (failed) {
-            /* pre-assembly reported an error; we skip later stages safely */
-            fprintf(stderr,
-                    "%s: Due to errors no | .ob | .ext | .ent | files created\n",
-                    argv[i]);
-            continue;
-        }
-
-        /* ---------- Stage 2: build table & labels from <file>.am ---------- */
-        /* parses tokens, fills Table + Labels; performs semantic checks (kinda strict) */
-        snprintf(filename, MAX_FILENAME, "%s.am", argv[i]);
-        fp = fopen(filename, "r");
-        if (fp == NULL) {
-            fprintf(stderr, "%s: Error - cannot open .am file\n", argv[i]);
-            fprintf(stderr,
-                    "%s: Due to errors no | .ob | .ext | .ent | files created\n",
-                    argv[i]);
-            continue; /* process next file */
-        }
-
-        Table *tbl = create_table();            /* holds rows (IC/DC stuff) */
-        Labels *lbls = create_label_table();    /* symbol table (entries, externs, etc) */
-
-        if (!tbl || !lbls) {
-            fprintf(stderr, "Error: failed to allocate memory for table or labels\n");
-            fclose(fp);
-            if (tbl) free_table(tbl);
-            if (lbls) free_label_table(lbls);
-            continue; /* process next file */
-        }
-
-        failed = process_file_to_table_and_labels(tbl, lbls, fp, filename);
-        fclose(fp);
-        if (failed) {
-            /* parsing error — free memory and bail out for this file */
-            free_table(tbl);
-            free_label_table(lbls);
-            fprintf(stderr,
-                    "%s: Due to errors no | .ob | .ext | .ent | files created\n",
-                    argv[i]);
-            continue;
-        }
-
-        /* Set IC/DC base addresses (offset 100) consistently on both tables
-           (this keeps machine code addresses aligned to the spec’s base adress). */
-        reset_addresses(tbl, 100);
-        reset_labels_addresses(lbls, 100);
-
-        /* ---------- Stage 3: translate table → binary using labels ---------- */
-        /* resolves symbols and outputs the internal binary representation (kinda cool) */
-        if (!parse_table_to_binary(tbl, lbls, filename)) {
-            fprintf(stderr,
-                    "%s: Due to errors no | .ob | .ext | .ent | files created\n",
-                    argv[i]);
-            free_table(tbl);
-            free_label_table(lbls);
-            continue;
+    memset(&settings, 0, sizeof(settings));
+
+    /* options come before file names ("-" alone is a file name: stdin) */
+    while (first_file < argc && strncmp(argv[first_file], "--", 2) == 0) {
+        if ((value = option_value(argc, argv, &first_file, "--jobs")) != NULL) {
+            jobs = parse_count(value);
+            if (jobs == 0) {
+                fprintf(stderr, "%s: --jobs needs a positive number\n", argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if ((value = option_value(argc, argv, &first_file, "--queue")) != NULL) {
+            queue_size = parse_count(value);
+            if (queue_size == 0) {
+                fprintf(stderr, "%s: --queue needs a positive number\n", argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if ((value = option_value(argc, argv, &first_file, "--serve")) != NULL) {
+            if (*value == NULL_CHAR) {
+                fprintf(stderr, "%s: --serve needs a socket path\n", argv[0]);
+                return EXIT_FAILURE;
+            }
+            socket_path = value;
+        } else if (strcmp(argv[first_file], "--stdout") == 0) {
+            settings.framed_output = TRUE; /* frames on stdout instead of files */
+        } else if (strcmp(argv[first_file], "--emit-am") == 0) {
+            settings.emit_am = TRUE; /* keep writing the .am debug copy */
+        } else if (strcmp(argv[first_file], "--one-pass") == 0) {
+            settings.one_pass = TRUE; /* encode while reading, backpatch forward refs */
+        } else if ((value = option_value(argc, argv, &first_file, "--cache")) != NULL) {
+            if (*value == NULL_CHAR) {
+                fprintf(stderr, "%s: --cache needs a directory\n", argv[0]);
+                return EXIT_FAILURE;
+            }
+            cache_dir = value;
+        } else if ((value = option_value(argc, argv, &first_file, "--stats")) != NULL) {
+            if (*value == NULL_CHAR) {
+                fprintf(stderr, "%s: --stats needs a file to write the json to\n", argv[0]);
+                return EXIT_FAILURE;
+            }
+            stats_path = value;
+        } else if ((value = option_value(argc, argv, &first_file, "--prelude")) != NULL) {
+            if (*value == NULL_CHAR) {
+                fprintf(stderr, "%s: --prelude needs a file of macro definitions\n", argv[0]);
+                return EXIT_FAILURE;
+            }
+            prelude_path = value;
+        } else if ((value = option_value(argc, argv, &first_file, "--recursive")) != NULL) {
+            if (*value == NULL_CHAR) {
+                fprintf(stderr, "%s: --recursive needs a directory\n", argv[0]);
+                return EXIT_FAILURE;
+            }
+            inputs[input_count].kind = INPUT_DIRECTORY; /* every *.as below it */
+            inputs[input_count].value = value;
+            input_count++;
+        } else {
+            fprintf(stderr, "%s: unknown option %s\n", argv[0], argv[first_file]);
+            return EXIT_FAILURE;
         }
+        first_file++;
+    }
 
-        /* ---------- Export artifacts (.ob / .ent / .ext) ---------- */
-        /* object file (final opcodes + data) */
-        if (!export_object_file(tbl, argv[i])) {
-            fprintf(stdout,"%s: .ob file not created\n", argv[i]);
-        }
-        else {
-            fprintf(stdout, "%s: .ob file created\n", argv[i]);
-        }
+    /* shared macros: parsed once here, every file (or request) reads the same table */
+    if (prelude_path && !load_prelude(prelude_path, &settings)) {
+        fprintf(stderr, "%s: nothing assembled (prelude %s unusable)\n", argv[0], prelude_path);
+        free(inputs);
+        return EXIT_FAILURE;
+    }
 
-        /* entry file (symbols marked as .entry) */
-        if (!export_entry_file(lbls, argv[i])) {
-            fprintf(stdout, "%s: .ent file not created\n", argv[i]);
-        }
-        else {
-            fprintf(stdout, "%s: .ent file created\n", argv[i]);
-        }
+    /* daemon mode: no file names, requests come over the socket */
+    if (socket_path) {
+        int status = run_server(socket_path, jobs ? jobs : DEFAULT_SERVER_WORKERS, queue_size,
+                                settings.prelude);
+        asm_prelude_free(settings.prelude);
+        free(inputs);
+        return status;
+    }
 
-        /* external references file (for .extern usages) */
-        if (!export_external_file(tbl, lbls, argv[i])) {
-            fprintf(stdout, "%s: .ext file not created\n", argv[i]);
-        }
-        else {
-            fprintf(stdout, "%s: .ext file created", argv[i]);
-        }
+    /* CLI usage check — must pass at least one base file name (without ext) or a dir */
+    if (first_file >= argc && input_count == 0) {
+        fprintf(stderr, "Usage: %s [--jobs N] [--cache DIR] [--emit-am] [--one-pass] [--stdout] [--stats FILE] [--prelude FILE] [--recursive DIR] <file1> [file2] [@manifest] ...\n", argv[0]);
+        fprintf(stderr, "       (\"-\" as a file = read the source from stdin, reply frame on stdout;\n");
+        fprintf(stderr, "        @manifest = file with one base name per line)\n");
+        fprintf(stderr, "       %s --serve <socket> [--jobs N] [--queue N] [--prelude FILE]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
 
-        /* Cleanup per file (no globals, so leak-free yay) */
-        free_table(tbl);
-        free_label_table(lbls);
+    /* iterate user-supplied input basenames: foo → foo.as → outputs */
+    for (; first_file < argc; first_file++) {
+        inputs[input_count++] = input_from_arg(argv[first_file]);
+    }
+    if (cache_dir && (settings.cache = cache_open(cache_dir)) == NULL) {
+        fprintf(stderr, "%s: cache disabled\n", argv[0]);
+    }
+    if (stats_path && (settings.stats = batch_stats_create()) == NULL) {
+        fprintf(stderr, "%s: stats disabled (out of memory)\n", argv[0]);
+    }
 
-        /* lil success message (kinda verbose but nice for users) */
-        fprintf(stdout,"%s: Successfully compiled\n", argv[i]);
+    double started = monotonic_seconds();
+    run_batch(inputs, input_count, jobs, &settings);
+    if (settings.stats) {
+        batch_stats_write_json(settings.stats, stats_path, monotonic_seconds() - started);
+        batch_stats_free(settings.stats);
+    }
+    if (settings.cache) {
+        cache_print_stats(settings.cache, stderr);
+        cache_close(settings.cache);
     }
+    asm_prelude_free(settings.prelude);
+    free(inputs);
 
     return EXIT_SUCCESS;
 }
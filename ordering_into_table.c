@@ -5,30 +5,58 @@
 #include "util.h"
 #include "table.h"
 #include "labels.h"
+#include "lexer.h"
+#include "binary_table_parsing.h"
+#include "isa.h"
 
 /* assumes find_label_by_name(...) is declared in labels.h:
    Label* find_label_by_name(const Labels *lbls, const char *name); */
 
-/* Hard cap on number of rows (program lines) allowed in the table. */
-#ifndef MAX_TABLE_ROWS
-#define MAX_TABLE_ROWS 255
-#endif
-
 /*
  * check_table_overflow
  * --------------------
- * After any add_row, we validate we didn't blow past MAX_TABLE_ROWS.
+ * After any add_row / data word, we validate we didn't blow past MAX_TABLE_ROWS.
  * Emits a nice error with filename + source line.
  * returns TRUE if ok, FALSE if overflow.
  */
 static int check_table_overflow(Table *tbl, const char *src_filename, int src_line) {
-    if (tbl && tbl->size > MAX_TABLE_ROWS) {
+    if (tbl && table_words(tbl) > MAX_TABLE_ROWS) {
         print_error(src_filename, src_line, "Program exceeds maximum of 255 lines");
         return FALSE;
     }
     return TRUE;
 }
 
+/*
+ * add_described_row
+ * -----------------
+ * add_row + describe_row on the new row: the operand text gets parsed here,
+ * once, and the second pass only encodes from tbl->operand[]. A symbol
+ * operand also gets its id + fixup right away (link_symbol_row).
+ */
+static void add_described_row(Table *tbl, Labels *lbls, const char *label, CommandType command,
+                              int is_cmd_line, const char *operands, unsigned int binary_code,
+                              unsigned int src_line_no) {
+    int before = tbl->size;
+    add_row(tbl, label, command, is_cmd_line, operands, binary_code, src_line_no);
+    if (tbl->size == before) return;
+
+    describe_row(tbl, tbl->size - 1);
+    if (tbl->operand[tbl->size - 1].kind == OPERAND_SYMBOL) link_symbol_row(tbl, lbls, tbl->size - 1);
+    if (tbl->encode_now) encode_added_row(tbl, lbls, tbl->size - 1);
+}
+
+/* add_label_row, and in one-pass mode patch whatever was waiting on it */
+static int add_label(Table *tbl, Labels *lbls, const char *label, int table_row_index,
+                     LabelTypes label_type, unsigned int is_entry,
+                     int src_line, const char *src_filename) {
+    if (!add_label_row(lbls, label, table_row_index, label_type, is_entry, src_line, src_filename)) {
+        return FALSE;
+    }
+    if (tbl->encode_now) backpatch_label(tbl, lbls, lbls->size - 1);
+    return TRUE;
+}
+
 /*
  * split_matrix_name_and_location
  * ------------------------------
@@ -55,6 +83,36 @@ void split_matrix_name_and_location(const char *input, char *name, char *rest, s
     }
 }
 
+/*
+ * add_operand_text
+ * ----------------
+ * Appends the row(s) of one already trimmed operand: matrix operands are split
+ * into 2 rows (name and index part), anything else is one row.
+ * returns TRUE on success, FALSE on any error.
+ */
+static int add_operand_text(Table *tbl, Labels *lbls, const char *operand, int command, int operand_number,
+                            unsigned int src_line_no, const char *src_filename) {
+    /* matrix operand is split into 2 rows: name and index part(s) */
+    if (is_matrix(operand) != NOT_FOUND) {
+        char matrix_name[MAX_OPERAND_LEN];
+        char index_pair[MAX_OPERAND_LEN];
+
+        split_matrix_name_and_location(operand, matrix_name, index_pair, MAX_OPERAND_LEN);
+
+        add_described_row(tbl, lbls, EMPTY_STRING, command, 0, matrix_name, operand_number, src_line_no);
+        if (!check_table_overflow(tbl, src_filename, (int)src_line_no)) return FALSE;
+
+        add_described_row(tbl, lbls, EMPTY_STRING, command, 0, index_pair, operand_number, src_line_no);
+        if (!check_table_overflow(tbl, src_filename, (int)src_line_no)) return FALSE;
+    } else {
+        /* normal (non-matrix) operand */
+        add_described_row(tbl, lbls, EMPTY_STRING, command, 0, operand, operand_number, src_line_no);
+        if (!check_table_overflow(tbl, src_filename, (int)src_line_no)) return FALSE;
+    }
+
+    return TRUE;
+}
+
 /*
  * add_operand
  * -----------
@@ -62,14 +120,14 @@ void split_matrix_name_and_location(const char *input, char *name, char *rest, s
  * and appends the corresponding row(s) into the table.
  * Note: returns TRUE on success, FALSE on any error (keeps behavior same).
  */
-int add_operand(Table *tbl, char *operand, int command, int operand_number,
+int add_operand(Table *tbl, Labels *lbls, char *operand, int command, int operand_number,
                 unsigned int src_line_no, const char *src_filename) {
     if (strcmp(operand, EMPTY_STRING) == 0) {
         /* empty operand is valid for some directives (e.g. .string terminator) */
         if (command == STR) {
-            add_row(tbl, EMPTY_STRING, command, 0, "\0", 0, src_line_no);
+            add_described_row(tbl, lbls, EMPTY_STRING, command, 0, "\0", 0, src_line_no);
         } else {
-            add_row(tbl, EMPTY_STRING, command, 0, "0", 0, src_line_no);
+            add_described_row(tbl, lbls, EMPTY_STRING, command, 0, "0", 0, src_line_no);
         }
         return check_table_overflow(tbl, src_filename, (int)src_line_no);
     }
@@ -80,25 +138,15 @@ int add_operand(Table *tbl, char *operand, int command, int operand_number,
     while (end > operand && isspace((unsigned char)*end)) *end-- = NULL_CHAR;
     *(end + 1) = NULL_CHAR;
 
-    /* matrix operand is split into 2 rows: name and index part(s) */
-    if (is_matrix(operand) != NOT_FOUND) {
-        char matrix_name[MAX_OPERAND_LEN];
-        char index_pair[MAX_OPERAND_LEN];
-
-        split_matrix_name_and_location(operand, matrix_name, index_pair, MAX_OPERAND_LEN);
-
-        add_row(tbl, EMPTY_STRING, command, 0, matrix_name, operand_number, src_line_no);
-        if (!check_table_overflow(tbl, src_filename, (int)src_line_no)) return FALSE;
-
-        add_row(tbl, EMPTY_STRING, command, 0, index_pair, operand_number, src_line_no);
-        if (!check_table_overflow(tbl, src_filename, (int)src_line_no)) return FALSE;
-    } else {
-        /* normal (non-matrix) operand */
-        add_row(tbl, EMPTY_STRING, command, 0, operand, operand_number, src_line_no);
-        if (!check_table_overflow(tbl, src_filename, (int)src_line_no)) return FALSE;
-    }
+    return add_operand_text(tbl, lbls, operand, command, operand_number, src_line_no, src_filename);
+}
 
-    return TRUE;
+/* same as add_operand for a lexed operand piece (the lexer already trimmed it) */
+static int add_operand_token(Table *tbl, Labels *lbls, const Token *operand, int command, int operand_number,
+                             unsigned int src_line_no, const char *src_filename) {
+    char text[MAX_OPERAND_LEN];
+    lex_copy(operand->start, operand->length, text, sizeof(text));
+    return add_operand_text(tbl, lbls, text, command, operand_number, src_line_no, src_filename);
 }
 
 /*
@@ -108,25 +156,18 @@ int add_operand(Table *tbl, char *operand, int command, int operand_number,
  * validates the number of operands, and records packed registers when posible.
  */
 int add_command_to_table(Table *tbl, Labels *lbls, char *label, int command,
-                         char *operands_string, int src_line, const char *src_filename) {
+                         const LineTokens *tokens, int src_line, const char *src_filename) {
 
-    char operands_copy[MAX_OPERAND_LEN];
-    strncpy(operands_copy, operands_string, MAX_OPERAND_LEN - 1);
-    operands_copy[MAX_OPERAND_LEN - 1] = NULL_CHAR;
-
-    /* quick comma count to catch extra/missing commas later */
-    int comma_count = 0;
-    const char *p;
-    for (p = operands_copy; *p; p++) {
-        if (*p == ',') comma_count++;
-    }
+    /* raw operands text (the master row keeps it as is) */
+    char operands_string[MAX_LINE_LENGTH];
+    lex_copy(tokens->rest, tokens->rest_length, operands_string, sizeof(operands_string));
 
-    /* tokenize into up to 2 operands (fits ISA specs) */
-    char *operand1 = strtok(operands_copy, COMMA_STRING);
-    char *operand2 = NULL;
-    if (operand1 != NULL) {
-        operand2 = strtok(NULL, COMMA_STRING);
-    }
+    /* commas were counted by the lexer (to catch extra/missing commas later) */
+    int comma_count = tokens->comma_count;
+
+    /* up to 2 operands (fits ISA specs) */
+    const Token *operand1 = lex_operand(tokens, 0);
+    const Token *operand2 = operand1 ? lex_operand(tokens, 1) : NULL;
 
     if (strcmp(label, EMPTY_STRING) != 0) {
         /* Labels can be reused only in very specific .entry scenarious (enforced below).
@@ -139,17 +180,17 @@ int add_command_to_table(Table *tbl, Labels *lbls, char *label, int command,
             print_error(src_filename, src_line, msg);
             return FALSE;
         }
-        /* record code label location (IC) */
-        if (!add_label_row(lbls, label, tbl->size, CODE, FALSE, src_line, src_filename)) {
+        /* record code label location (IC, the data so far included) */
+        if (!add_label(tbl, lbls, label, table_words(tbl), CODE, FALSE, src_line, src_filename)) {
             return FALSE;
         }
     }
 
     /* master row for the command line (records original source line number) */
-    add_row(tbl, label, command, 1, operands_string, 0, (unsigned int)src_line);
+    add_described_row(tbl, lbls, label, command, 1, operands_string, 0, (unsigned int)src_line);
     if (!check_table_overflow(tbl, src_filename, src_line)) return FALSE;
 
-    int expected = command_operands[command];
+    int expected = isa_instructions[command].operands;
 
     /* validate arity — classic fence-post checks */
     if (expected == 0 && (operand1 != NULL || operand2 != NULL)) {
@@ -174,7 +215,7 @@ int add_command_to_table(Table *tbl, Labels *lbls, char *label, int command,
             print_error(src_filename, src_line, msg);
             return FALSE;
         }
-        if (!add_operand(tbl, operand1, command, 1, (unsigned int)src_line, src_filename))
+        if (!add_operand_token(tbl, lbls, operand1, command, 1, (unsigned int)src_line, src_filename))
             return FALSE;
     }
     else if (expected == 2) {
@@ -194,13 +235,13 @@ int add_command_to_table(Table *tbl, Labels *lbls, char *label, int command,
         }
 
         /* micro-optimization: 2 registers can be packed into 1 row */
-        if (is_register(operand1) != FALSE && is_register(operand2) != FALSE) {
-            if (!add_operand(tbl, operands_string, command, 1, (unsigned int)src_line, src_filename))
+        if (operand1->kind == TOKEN_REGISTER && operand2->kind == TOKEN_REGISTER) {
+            if (!add_operand(tbl, lbls, operands_string, command, 1, (unsigned int)src_line, src_filename))
                 return FALSE;
         } else {
-            if (!add_operand(tbl, operand1, command, 1, (unsigned int)src_line, src_filename))
+            if (!add_operand_token(tbl, lbls, operand1, command, 1, (unsigned int)src_line, src_filename))
                 return FALSE;
-            if (!add_operand(tbl, operand2, command, 2, (unsigned int)src_line, src_filename))
+            if (!add_operand_token(tbl, lbls, operand2, command, 2, (unsigned int)src_line, src_filename))
                 return FALSE;
         }
     }
@@ -218,6 +259,91 @@ int add_command_to_table(Table *tbl, Labels *lbls, char *label, int command,
     return TRUE;
 }
 
+/*
+ * put_data_word
+ * -------------
+ * Data word the first pass already knows the value of: straight into the
+ * data segment (no row, no text, nothing left for pass two to do).
+ */
+static int put_data_word(Table *tbl, unsigned short word, int src_line, const char *src_filename) {
+    if (!add_data_word(tbl, word)) return FALSE;
+    return check_table_overflow(tbl, src_filename, src_line);
+}
+
+/*
+ * put_data_value
+ * --------------
+ * A value parse_data_word didnt take: same rules a row with this text had
+ * (cut to an operand's length, is_number/strtod). A bad one still takes its
+ * word's place and pass two reports it in order.
+ */
+static int put_data_value(Table *tbl, const char *text, int src_line, const char *src_filename) {
+    char value[MAX_OPERAND_LEN];
+    unsigned short word = 0;
+    strncpy(value, text, sizeof(value) - 1);
+    value[sizeof(value) - 1] = NULL_CHAR;
+
+    OperandError error = describe_data_value(value, &word);
+    if (error != OPERAND_OK) {
+        if (!add_data_error(tbl, error)) return FALSE;
+        return check_table_overflow(tbl, src_filename, src_line);
+    }
+    return put_data_word(tbl, word, src_line, src_filename);
+}
+
+/* put_data_value for a lexed value, split in 2 like a matrix operand would
+   be when it looks like one (each half is its own word, and its own error) */
+static int put_data_token(Table *tbl, const Token *operand, int src_line, const char *src_filename) {
+    char text[MAX_OPERAND_LEN];
+    lex_copy(operand->start, operand->length, text, sizeof(text));
+
+    if (is_matrix(text) != NOT_FOUND) {
+        char matrix_name[MAX_OPERAND_LEN];
+        char index_pair[MAX_OPERAND_LEN];
+        split_matrix_name_and_location(text, matrix_name, index_pair, MAX_OPERAND_LEN);
+        if (!put_data_value(tbl, matrix_name, src_line, src_filename)) return FALSE;
+        return put_data_value(tbl, index_pair, src_line, src_filename);
+    }
+    return put_data_value(tbl, text, src_line, src_filename);
+}
+
+/* most digits parse_data_word takes (a long and a double both hold them exactly) */
+#define MAX_FAST_DIGITS 15
+
+/*
+ * parse_data_word
+ * ---------------
+ * The usual .data/.mat value straight off the line: what is_number takes
+ * (spaces around, one sign, digits) and short enough that nothing would
+ * have cut it. Gives the same word the strtod path gives.
+ * FALSE = anything else (brackets, junk, huge), the old path handles it
+ * and its errors.
+ */
+static int parse_data_word(const char *text, size_t length, unsigned short *word) {
+    size_t i = 0;
+    long value = 0;
+    int digits = 0;
+    int negative = FALSE;
+
+    if (length >= MAX_OPERAND_LEN - 1) return FALSE;
+    while (i < length && isspace((unsigned char)text[i])) i++;
+    if (i < length && (text[i] == PLUS_CHAR || text[i] == MINUS_CHAR)) {
+        negative = (text[i] == MINUS_CHAR);
+        i++;
+    }
+    while (i < length && isdigit((unsigned char)text[i])) {
+        if (++digits > MAX_FAST_DIGITS) return FALSE;
+        value = value * 10 + (text[i] - '0');
+        i++;
+    }
+    if (digits == 0) return FALSE;
+    while (i < length && isspace((unsigned char)text[i])) i++;
+    if (i != length) return FALSE;
+
+    *word = (unsigned short)((negative ? -value : value) & TEN_BIT_MASK);
+    return TRUE;
+}
+
 /*
  * add_data_to_table
  * -----------------
@@ -225,10 +351,12 @@ int add_command_to_table(Table *tbl, Labels *lbls, char *label, int command,
  * Careful with quotes and matrix sizes; we mimic the assembler rules exactly.
  */
 int add_data_to_table(Table *tbl, Labels *lbls, char *label, int command,
-                      char *operands_string, int src_line, const char *src_filename) {
+                      const LineTokens *tokens, int src_line, const char *src_filename) {
+    /* whole rest for messages/is_matrix, the .string scan only sees the cut copy */
+    char operands_string[MAX_LINE_LENGTH];
     char operands_copy[MAX_OPERAND_LEN];
-    strncpy(operands_copy, operands_string, MAX_OPERAND_LEN - 1);
-    operands_copy[MAX_OPERAND_LEN - 1] = NULL_CHAR;
+    lex_copy(tokens->rest, tokens->rest_length, operands_string, sizeof(operands_string));
+    lex_copy(tokens->rest, tokens->rest_length, operands_copy, sizeof(operands_copy));
 
     if (strcmp(label, EMPTY_STRING) != 0) {
         /* Same reuse rule as in commands. Keep original message strings (typos and all). */
@@ -240,11 +368,14 @@ int add_data_to_table(Table *tbl, Labels *lbls, char *label, int command,
             print_error(src_filename, src_line, msg);
             return FALSE;
         }
-        if (!add_label_row(lbls, label, tbl->size, DATA, FALSE, src_line, src_filename)) {
+        if (!add_label(tbl, lbls, label, table_words(tbl), DATA, FALSE, src_line, src_filename)) {
             return FALSE;
         }
     }
 
+    /* the words go in the data segment, under one directive for this line */
+    if (!add_data_directive(tbl, label, (unsigned int)src_line)) return FALSE;
+
     int first = TRUE;
 
     if (command == STR) {
@@ -273,15 +404,12 @@ int add_data_to_table(Table *tbl, Labels *lbls, char *label, int command,
             }
 
             if (in_quotes) {
-                char c[2] = {operands_copy[i], NULL_CHAR};
-                if (first) {
-                    add_row(tbl, label, command, TRUE, c, 0, (unsigned int)src_line);
-                    if (!check_table_overflow(tbl, src_filename, src_line)) return FALSE;
-                    first = FALSE;
-                } else {
-                    if (!add_operand(tbl, c, command, 0, (unsigned int)src_line, src_filename))
-                        return FALSE;
-                }
+                unsigned char c = (unsigned char)operands_copy[i];
+                /* only the first char goes in untrimmed, any later space
+                   always came out of add_operand's trim as a 0 word */
+                if (!first && isspace(c)) c = 0;
+                if (!put_data_word(tbl, c, src_line, src_filename)) return FALSE;
+                first = FALSE;
             }
         }
 
@@ -303,14 +431,13 @@ int add_data_to_table(Table *tbl, Labels *lbls, char *label, int command,
         }
 
         /* terminating null byte of string (end-of-text marker) */
-        if (!add_operand(tbl, "", command, 0, (unsigned int)src_line, src_filename))
-            return FALSE;
+        if (!put_data_word(tbl, 0, src_line, src_filename)) return FALSE;
     }
     else if (command == MAT) {
         /* MAT expects a fixed count of values based on the matrix size specifier */
         int size = is_matrix(operands_string);
-
-        char *operand = strtok(operands_copy, COMMA_STRING);
+        int next = 0;
+        const Token *operand = lex_operand(tokens, next++);
         int count = 0;
 
         while (count < size) {
@@ -318,68 +445,76 @@ int add_data_to_table(Table *tbl, Labels *lbls, char *label, int command,
                 if (first) {
                     /* For the first item, we must strip the "[..][..]" part and keep the value.
                        This is a bit fiddly but works fine — dont change pls :) */
-                    char first_str[MAX_OPERAND_LEN];
+                    char first_str[MAX_OPERAND_LEN] = EMPTY_STRING;
+                    unsigned short word;
                     int bracket_count = 0;
-                    char *ptr = operand;
-                    while (*ptr) {
-                        if (*ptr == ']') {
-                            bracket_count++;
-                            if (bracket_count == 2) {
-                                ptr++;
-                                strncpy(first_str, ptr, MAX_OPERAND_LEN - 1);
-                                first_str[MAX_OPERAND_LEN - 1] = NULL_CHAR;
-                                break;
-                            }
+                    size_t k;
+                    for (k = 0; k < operand->raw_length; k++) {
+                        if (operand->raw[k] == ']' && ++bracket_count == 2) {
+                            lex_copy(operand->raw + k + 1, operand->raw_length - k - 1,
+                                     first_str, sizeof(first_str));
+                            break;
                         }
-                        ptr++;
                     }
-                    add_row(tbl, label, command, TRUE, first_str, 0, (unsigned int)src_line);
-                    if (!check_table_overflow(tbl, src_filename, src_line)) return FALSE;
+                    if (bracket_count == 2 &&
+                        parse_data_word(operand->raw + k + 1, operand->raw_length - k - 1, &word)) {
+                        if (!put_data_word(tbl, word, src_line, src_filename)) return FALSE;
+                    } else {
+                        if (!put_data_value(tbl, first_str, src_line, src_filename)) return FALSE;
+                    }
                     first = FALSE;
                 } else {
-                    if (!add_operand(tbl, operand, command, 0, (unsigned int)src_line, src_filename))
+                    unsigned short word;
+                    if (parse_data_word(operand->start, operand->length, &word)) {
+                        if (!put_data_word(tbl, word, src_line, src_filename)) return FALSE;
+                    } else if (!put_data_token(tbl, operand, src_line, src_filename)) {
                         return FALSE;
+                    }
                 }
-                operand = strtok(NULL, COMMA_STRING);
+                operand = lex_operand(tokens, next++);
             } else {
                 /* If fewer values than needed, pad with EMPTY_STRING (assembler semantics) */
                 if (first) {
-                    add_row(tbl, label, command, TRUE, operands_string, 0, (unsigned int)src_line);
-                    if (!check_table_overflow(tbl, src_filename, src_line)) return FALSE;
+                    /* no values at all: the whole "[..][..]" is the first value (an error) */
+                    if (!put_data_value(tbl, operands_string, src_line, src_filename)) return FALSE;
                     first = FALSE;
                 } else {
-                    if (!add_operand(tbl, EMPTY_STRING, command, 0, (unsigned int)src_line, src_filename))
-                        return FALSE;
+                    if (!put_data_word(tbl, 0, src_line, src_filename)) return FALSE;
                 }
             }
             count++;
         }
-        /* If there are *more* values than size, thats an error */
-        if (operand != NULL) {
-            operand = strtok(NULL, COMMA_STRING);
-            if (operand != NULL) {
-                char msg[128];
-                snprintf(msg, sizeof(msg), "Too many values for matrix directive \"%s\"",
-                         operands_string);
-                print_error(src_filename, src_line, msg);
-                return FALSE;
-            }
+        /* If there are *more* values than size, thats an error
+           (one spare value is let through, that's how it always was) */
+        if (operand != NULL && lex_operand(tokens, next) != NULL) {
+            char msg[128];
+            snprintf(msg, sizeof(msg), "Too many values for matrix directive \"%s\"",
+                     operands_string);
+            print_error(src_filename, src_line, msg);
+            return FALSE;
         }
     }
     else {
-        /* .data-like list of numbers/operands separated by commas */
-        char *operand = strtok(operands_copy, COMMA_STRING);
-
-        while (operand != NULL) {
-            if (first) {
-                add_row(tbl, label, command, TRUE, operand, 0, (unsigned int)src_line);
-                if (!check_table_overflow(tbl, src_filename, src_line)) return FALSE;
-                first = FALSE;
+        /* .data-like list of numbers/operands separated by commas
+           (first value goes in untrimmed, the rest through add_operand) */
+        int k;
+        for (k = 0; k < tokens->token_count; k++) {
+            const Token *operand = &tokens->operands[k];
+            if (operand->kind == TOKEN_COMMA) continue;
+            unsigned short word;
+            /* the first value always went in raw (untrimmed), the rest trimmed */
+            const char *text = first ? operand->raw : operand->start;
+            size_t length = first ? operand->raw_length : operand->length;
+            if (parse_data_word(text, length, &word)) {
+                if (!put_data_word(tbl, word, src_line, src_filename)) return FALSE;
+            } else if (first) {
+                char first_str[MAX_OPERAND_LEN];
+                lex_copy(operand->raw, operand->raw_length, first_str, sizeof(first_str));
+                if (!put_data_value(tbl, first_str, src_line, src_filename)) return FALSE;
             } else {
-                if (!add_operand(tbl, operand, command, 0, (unsigned int)src_line, src_filename))
-                    return FALSE;
+                if (!put_data_token(tbl, operand, src_line, src_filename)) return FALSE;
             }
-            operand = strtok(NULL, COMMA_STRING);
+            first = FALSE;
         }
     }
 
@@ -392,155 +527,124 @@ int add_data_to_table(Table *tbl, Labels *lbls, char *label, int command,
  * Top-level driver: loops over input lines, splits optional label, detects directive
  * vs command, and dispatches to the proper helper. Keeps the original error text.
  */
-int process_file_to_table_and_labels(Table *tbl, Labels *lbls, FILE *file, const char *src_filename) {
-    char line[MAX_LINE_LENGTH];
+int process_file_to_table_and_labels(Table *tbl, Labels *lbls, const LineSink *lines, const char *src_filename) {
+    LineTokens tokens;
     int error = FALSE;
-    int src_line = 0;
-
-    rewind(file);
-
-    while (fgets(line, sizeof(line), file)) {
-        src_line++;
-
-        /* -------- Remove trailing newline, if any -------- */
-        {
-            char *nl = strchr(line, '\n');
-            if (nl) *nl = NULL_CHAR;
-        }
+    int i;
 
-        /* skip empty/comment-only lines early for speed (tiny micro-optim) */
-        if (line[0] == NULL_CHAR || line[0] == NEWLINE_CHAR || line[0] == COMMENT_CHAR) {
-            /* Skip empty lines */
+    for (i = 0; i < lines->line_count; i++) {
+        /* skip empty/comment-only lines straight off the sink, before lexing anything */
+        const SinkLine *view = &lines->lines[i];
+        if (view->length == 0 || lines->text[view->offset] == COMMENT_CHAR) {
             continue;
         }
-        if (line[0] == SEMI_COLON_CHAR) {
-            /* colon at start means there was a ':' with no label chars before it */
-            print_error(src_filename, src_line, "Empty label");
-            error = TRUE;
-        }
 
-        /* -------- Split optional label by first ':' -------- */
+        /* errors point at the .as line this came from (macro call line for expansions) */
+        int src_line = view->source_line;
+        lex_line(lines->text + view->offset,
+                 view->length < MAX_LINE_LENGTH - 1 ? view->length : MAX_LINE_LENGTH - 1, &tokens);
+
+        /* -------- Optional label (before the first ':') -------- */
         char label[MAX_LABEL_LEN] = EMPTY_STRING;
-        char *after = line;
-        char *colon = strchr(line, SEMI_COLON_CHAR); /* ':' */
-
-        if (colon) {
-            *colon = NULL_CHAR;           /* terminate label part */
-            after  = colon + 1;           /* rest of the line */
-
-            /* Trim the label part (leading/trailing spaces) */
-            {
-                char *start = line;
-                while (*start && isspace((unsigned char)*start)) start++;
-                char *end = start + (int)strlen(start);
-                while (end > start && isspace((unsigned char)*(end - 1))) end--;
-                *end = NULL_CHAR;
-
-                if (strlen(start) >= MAX_LABEL_LEN) {
-                    char msg[128];
-                    snprintf(msg, sizeof(msg), "Label too long: \"%s\"", start);
-                    print_error(src_filename, src_line, msg);
-                    error = TRUE;
-                }
+        if (tokens.has_colon) {
+            if (tokens.label.raw_length == 0) {
+                /* colon at start means there was a ':' with no label chars before it */
+                print_error(src_filename, src_line, "Empty label");
+                error = TRUE;
+            }
 
-                /* store label (already without ':') */
-                if (*start) {
-                    strncpy(label, start, MAX_LABEL_LEN - 1);
-                    label[MAX_LABEL_LEN - 1] = NULL_CHAR;
-                }
+            if (tokens.label.length >= MAX_LABEL_LEN) {
+                char text[MAX_LINE_LENGTH];
+                char msg[128];
+                lex_copy(tokens.label.start, tokens.label.length, text, sizeof(text));
+                snprintf(msg, sizeof(msg), "Label too long: \"%s\"", text);
+                print_error(src_filename, src_line, msg);
+                error = TRUE;
+            }
+
+            /* store label (already without ':', cut to fit) */
+            if (tokens.label.length > 0) {
+                lex_copy(tokens.label.start, tokens.label.length, label, sizeof(label));
             }
         }
 
-        /* -------- Tokenize the rest of the line for directive/command -------- */
-        char *word = strtok(after, " \t\r\n"); 
+        /* -------- Directive/command word, then its operands -------- */
+        if (tokens.has_word) {
+            char word[MAX_LINE_LENGTH];
+            lex_copy(tokens.word.start, tokens.word.length, word, sizeof(word));
+
+            if (strcmp(word, ENTRY) == 0 || strcmp(word, EXTERN) == 0) {
+                int is_entry = (strcmp(word, ENTRY) == 0);
+                /* .entry/.extern <label> — the label name is the raw rest of the line */
+                char rest[MAX_LINE_LENGTH];
+                lex_copy(tokens.rest, tokens.rest_length, rest, sizeof(rest));
 
-        if (word != NULL) {
-            if (strcmp(word, ENTRY) == 0) {
-                /* .entry <label> — mark a symbol as entry point */
-                char *rest = strtok(NULL, NEW_LINE_STRING); /* label name (no ':') */
-                if (!rest) {
-                    print_error(src_filename, src_line, ".entry requires a label");
+                if (!tokens.has_rest) {
+                    print_error(src_filename, src_line,
+                                is_entry ? ".entry requires a label" : ".extern requires a label");
                     error = TRUE;
                 }
-                else {
+                else if (is_entry) {
+                    /* .entry <label> — mark a symbol as entry point */
                     Label *existing = find_label_by_name(lbls, rest);
 
                     if (existing && (existing->is_entry || count_label_by_name(lbls, rest) > 1)) {
                         char msg[128];
                         /* exact phrasing requested */
-                        snprintf(msg, sizeof(msg), "lable alrady exists: \"%s\"", rest ? rest : "(null)");
+                        snprintf(msg, sizeof(msg), "lable alrady exists: \"%s\"", rest);
                         print_error(src_filename, src_line, msg);
                         error = TRUE;
                     } else {
-                        if (!add_label_row(lbls, rest, 0, UNKNOWN, TRUE, src_line, src_filename)) {
+                        if (!add_label(tbl, lbls, rest, 0, UNKNOWN, TRUE, src_line, src_filename)) {
                             error = TRUE;  /* fixed: was FALSE */
                         }
                     }
                 }
-            }
-            else if (strcmp(word, EXTERN) == 0) {
-                /* .extern <label> — declare an external symbol */
-                char *rest = strtok(NULL, NEW_LINE_STRING); /* label name (no ':') */
-
-                if (!rest) {
-                    print_error(src_filename, src_line, ".extern requires a label");
-                    error = TRUE;
-                }
                 else {
+                    /* .extern <label> — declare an external symbol */
                     Label *existing = find_label_by_name(lbls, rest);
                     if (existing) {
                         char msg[128];
                         /* exact phrasing requested */
-                        snprintf(msg, sizeof(msg), "lable alrady exists: \"%s\"", rest ? rest : "(null)");
+                        snprintf(msg, sizeof(msg), "lable alrady exists: \"%s\"", rest);
                         print_error(src_filename, src_line, msg);
                         error = TRUE;
                     } else {
-                        if (!add_label_row(lbls, rest, 0, EXT, FALSE, src_line, src_filename)) {
+                        if (!add_label(tbl, lbls, rest, 0, EXT, FALSE, src_line, src_filename)) {
                             error = TRUE;  /* fixed: was FALSE */
                         }
                     }
                 }
             }
             else {
-                /* otherwise it's a regular command or a data directive */
-                int command = NOT_FOUND;
-                char operands_string[MAX_OPERAND_LEN] = EMPTY_STRING;
-
-                /* Find command using the (possibly empty) label detected before ':' */
-                command = find_command(word, label);
+                /* otherwise it's a regular command or a data directive.
+                   Find command using the (possibly empty) label detected before ':' */
+                int command = find_command(word, label);
 
                 if (command == NOT_FOUND) {
                     /* Unrecognized mnemonic or directive */
                     char msg[128];
-                    snprintf(msg, sizeof(msg), "Command \"%s\" not recognised", word ? word : "(null)");
+                    snprintf(msg, sizeof(msg), "Command \"%s\" not recognised", word);
                     print_error(src_filename, src_line, msg);
                     error = TRUE;
                 }
-                else {
-                    /* grab rest of the line as raw operands string (could be empty) */
-                    char *rest = strtok(NULL, NEW_LINE_STRING);
-                    if (rest != NULL) {
-                        strcpy(operands_string, rest);
+                /* command range: < NUMBER_OF_COMMANDS means “real instruction” */
+                else if (command < NUMBER_OF_COMMANDS) {
+                    if (!add_command_to_table(tbl, lbls, label, command, &tokens,
+                                              src_line, src_filename)) {
+                        error = TRUE;
                     }
-
-                    /* command range: < NUMBER_OF_COMMANDS means “real instruction” */
-                    if (command < NUMBER_OF_COMMANDS) {
-                        if (!add_command_to_table(tbl, lbls, label, command, operands_string,
-                                                  src_line, src_filename)) {
-                            error = TRUE;
-                        }
-                    } else {
-                        if (!add_data_to_table(tbl, lbls, label, command, operands_string,
-                                               src_line, src_filename)) {
-                            error = TRUE;
-                        }
+                } else {
+                    if (!add_data_to_table(tbl, lbls, label, command, &tokens,
+                                           src_line, src_filename)) {
+                        error = TRUE;
                     }
                 }
             }
         }
 
         /* Early-out if we already overflowed to avoid cascading errors (good UX) */
-        if (tbl->size > MAX_TABLE_ROWS) {
+        if (table_words(tbl) > MAX_TABLE_ROWS) {
             /* Specific overflow error should have been printed at point of failure. */
             break;
         }
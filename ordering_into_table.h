@@ -3,19 +3,20 @@
 #include <stdio.h>
 #include "table.h"
 #include "labels.h"
+#include "line_sink.h"
 
 /*
  * process_file_to_table_and_labels
  * --------------------------------
- * Reads one source file line-by-line and populates:
+ * Walks the pre-assembled lines one by one and populates:
  *   - tbl  : the Table of rows (each row describes a thing the assembler needs)
  *   - lbls : the Labels struct (holds label infos)
- *   - file : already-opened FILE* you pass in
+ *   - lines : expanded program straight from the pre-assembler (line map included)
  *   - src_filename : only for error messages (so users see wich file had the issue)
  *
  * returns: 0 if no errors, non-zero if there were parsing errs.
- * note: doesn’t own/close 'file'. Caller should close it when done.
+ * line numbers in errors/rows are the original .as ones (from the line map).
  */
-int process_file_to_table_and_labels(Table *tbl, Labels *lbls, FILE *file, const char *src_filename);
+int process_file_to_table_and_labels(Table *tbl, Labels *lbls, const LineSink *lines, const char *src_filename);
 
 #endif /* ORDERING_INTO_TABLE_H */
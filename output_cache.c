@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "output_cache.h"
+#include "util.h"
+
+#define CACHE_MAGIC "ASMCACHE1"
+#define CACHE_FILE_EXT ".asmc"
+#define NAME_PLACEHOLDER '\001'   /* stands in for the base name inside stored msgs */
+#define MEMO_INITIAL_CAPACITY 64
+#define MAX_CACHE_SECTIONS 64
+
+/* state of one key inside this process */
+typedef enum {
+    SLOT_EMPTY = 0,
+    SLOT_BUSY,          /* some worker is reading/assembling it right now */
+    SLOT_DONE,          /* entry is on disk */
+    SLOT_UNCACHEABLE    /* store failed, everyone just assembles it */
+} SlotState;
+
+typedef struct {
+    CacheKey key;
+    SlotState state;
+} MemoSlot;
+
+struct OutputCache {
+    char *dir;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    MemoSlot *slots;      /* open addressing, linear probe */
+    int slot_capacity;
+    int slot_count;
+    unsigned long temp_counter;
+    long disk_hits;
+    long batch_hits;
+    long misses;
+    long store_failures;
+    double saved_seconds;   /* sum of the stored assemble times of every hit */
+};
+
+/* ---------------- hashing ---------------- */
+
+/* two differently seeded 64-bit FNV-1a runs over version + variant + source */
+static unsigned long long fnv1a(unsigned long long h, const unsigned char *p, size_t n, int mix) {
+    size_t i;
+    for (i = 0; i < n; i++) {
+        unsigned char c = mix ? (unsigned char)(p[i] ^ (unsigned char)(i * 0x9Du)) : p[i];
+        h ^= c;
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+CacheKey cache_key(const char *source, size_t size, const char *variant) {
+    CacheKey key;
+    const unsigned char *version = (const unsigned char*)LIBASM_VERSION;
+    size_t version_len = strlen(LIBASM_VERSION) + 1; /* keep the nulls as separators */
+    size_t variant_len = strlen(variant) + 1;
+
+    key.hi = fnv1a(0xCBF29CE484222325ULL, version, version_len, 0);
+    key.hi = fnv1a(key.hi, (const unsigned char*)variant, variant_len, 0);
+    key.hi = fnv1a(key.hi, (const unsigned char*)source, size, 0);
+    key.lo = fnv1a(0x84222325CBF29CE4ULL, version, version_len, 1);
+    key.lo = fnv1a(key.lo, (const unsigned char*)variant, variant_len, 1);
+    key.lo = fnv1a(key.lo, (const unsigned char*)source, size, 1);
+    return key;
+}
+
+static int same_key(CacheKey a, CacheKey b) {
+    return a.hi == b.hi && a.lo == b.lo;
+}
+
+/* ---------------- in-process memo (guarded by cache->lock) ---------------- */
+
+static MemoSlot *memo_find(OutputCache *cache, CacheKey key) {
+    int i = (int)(key.lo % (unsigned long long)cache->slot_capacity);
+    while (cache->slots[i].state != SLOT_EMPTY) {
+        if (same_key(cache->slots[i].key, key)) return &cache->slots[i];
+        i = (i + 1) % cache->slot_capacity;
+    }
+    return NULL;
+}
+
+/* double the table when half full (returns FALSE if realloc dies) */
+static int memo_grow(OutputCache *cache) {
+    int old_capacity = cache->slot_capacity;
+    MemoSlot *old = cache->slots;
+    MemoSlot *grown = calloc((size_t)old_capacity * 2, sizeof(MemoSlot));
+    if (!grown) return FALSE;
+
+    cache->slots = grown;
+    cache->slot_capacity = old_capacity * 2;
+    int i;
+    for (i = 0; i < old_capacity; i++) {
+        if (old[i].state == SLOT_EMPTY) continue;
+        int j = (int)(old[i].key.lo % (unsigned long long)cache->slot_capacity);
+        while (cache->slots[j].state != SLOT_EMPTY) j = (j + 1) % cache->slot_capacity;
+        cache->slots[j] = old[i];
+    }
+    free(old);
+    return TRUE;
+}
+
+static MemoSlot *memo_insert(OutputCache *cache, CacheKey key, SlotState state) {
+    if ((cache->slot_count + 1) * 2 > cache->slot_capacity && !memo_grow(cache)) return NULL;
+
+    int i = (int)(key.lo % (unsigned long long)cache->slot_capacity);
+    while (cache->slots[i].state != SLOT_EMPTY) i = (i + 1) % cache->slot_capacity;
+    cache->slots[i].key = key;
+    cache->slots[i].state = state;
+    cache->slot_count++;
+    return &cache->slots[i];
+}
+
+/* ---------------- name <-> placeholder in stored messages ---------------- */
+
+/* swap `from` for `to` wherever it starts a line and is followed by ':' or '.' */
+static char *swap_line_prefix(const char *text, size_t size, const char *from, const char *to,
+                              size_t *out_size) {
+    size_t from_len = strlen(from), to_len = strlen(to);
+    size_t cap = size + 1 + (to_len > from_len ? (size / (from_len ? from_len : 1) + 1) * (to_len - from_len) : 0);
+    char *out = malloc(cap);
+    if (!out) return NULL;
+
+    size_t i = 0, o = 0;
+    int line_start = TRUE;
+    while (i < size) {
+        if (line_start && from_len > 0 && i + from_len < size + 1 &&
+            strncmp(text + i, from, from_len) == 0 &&
+            (text[i + from_len] == ':' || text[i + from_len] == DOT_CHAR)) {
+            memcpy(out + o, to, to_len);
+            o += to_len;
+            i += from_len;
+            line_start = FALSE;
+            continue;
+        }
+        line_start = (text[i] == NEWLINE_CHAR);
+        out[o++] = text[i++];
+    }
+    out[o] = NULL_CHAR;
+    *out_size = o;
+    return out;
+}
+
+/* ---------------- entry files ---------------- */
+
+static void entry_path(const OutputCache *cache, CacheKey key, char *path, size_t cap) {
+    snprintf(path, cap, "%s/%016llx%016llx%s", cache->dir, key.hi, key.lo, CACHE_FILE_EXT);
+}
+
+static void write_section(FILE *fp, const char *tag, const char *data, size_t size) {
+    fprintf(fp, "%s %lu\n", tag, (unsigned long)size);
+    if (size > 0) fwrite(data, 1, size, fp);
+    fputc(NEWLINE_CHAR, fp);
+}
+
+/* write to a temp name, then rename (readers never see half an entry) */
+static int write_entry(OutputCache *cache, CacheKey key, size_t source_size, const char *name,
+                       const AsmResult *result, const char *am_text, size_t am_size, double seconds) {
+    char path[FILENAME_MAX], temp[FILENAME_MAX + 64];
+    entry_path(cache, key, path, sizeof(path));
+
+    pthread_mutex_lock(&cache->lock);
+    unsigned long n = cache->temp_counter++;
+    pthread_mutex_unlock(&cache->lock);
+    snprintf(temp, sizeof(temp), "%s.tmp%ld-%lu", path, (long)getpid(), n);
+
+    FILE *fp = fopen(temp, "wb");
+    if (!fp) return FALSE;
+
+    int sections = result->message_count + (am_text ? 1 : 0) +
+                   (result->object_size > 0) + (result->entries_size > 0) + (result->externals_size > 0);
+    fprintf(fp, "%s %lu %d %d %.6f\n", CACHE_MAGIC, (unsigned long)source_size, result->success,
+            sections, seconds);
+
+    if (am_text) write_section(fp, "am", am_text, am_size);
+    if (result->object_size > 0)    write_section(fp, "ob", result->object, result->object_size);
+    if (result->entries_size > 0)   write_section(fp, "ent", result->entries, result->entries_size);
+    if (result->externals_size > 0) write_section(fp, "ext", result->externals, result->externals_size);
+
+    char placeholder[2] = {NAME_PLACEHOLDER, NULL_CHAR};
+    int i, ok = TRUE;
+    for (i = 0; i < result->message_count && ok; i++) {
+        size_t size;
+        char *relative = swap_line_prefix(result->messages[i].text, result->messages[i].size,
+                                          name, placeholder, &size);
+        if (!relative) {
+            ok = FALSE;
+            break;
+        }
+        write_section(fp, result->messages[i].is_error ? "err" : "out", relative, size);
+        free(relative);
+    }
+
+    if (ferror(fp)) ok = FALSE;
+    if (fclose(fp) != 0) ok = FALSE;
+    if (ok && rename(temp, path) != 0) ok = FALSE;
+    if (!ok) remove(temp);
+    return ok;
+}
+
+/* read "<tag> <len>\n<bytes>\n" (payload malloc'd + null terminated) */
+static int read_section(FILE *fp, char *tag, char **data, size_t *size) {
+    unsigned long len;
+    if (fscanf(fp, "%15s %lu", tag, &len) != 2 || fgetc(fp) != NEWLINE_CHAR) return FALSE;
+    if (len > (1UL << 28)) return FALSE; /* not ours / corrupted */
+
+    *data = malloc(len + 1);
+    if (!*data) return FALSE;
+    if (fread(*data, 1, len, fp) != len || fgetc(fp) != NEWLINE_CHAR) {
+        free(*data);
+        *data = NULL;
+        return FALSE;
+    }
+    (*data)[len] = NULL_CHAR;
+    *size = len;
+    return TRUE;
+}
+
+static int read_entry(OutputCache *cache, CacheKey key, size_t source_size, const char *name,
+                      AsmResult *result, char **am_text, size_t *am_size, double *seconds) {
+    char path[FILENAME_MAX], magic[16];
+    unsigned long stored_size;
+    int success, sections;
+
+    memset(result, 0, sizeof(*result));
+    *am_text = NULL;
+    *am_size = 0;
+
+    entry_path(cache, key, path, sizeof(path));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return FALSE;
+
+    if (fscanf(fp, "%15s %lu %d %d %lf", magic, &stored_size, &success, &sections, seconds) != 5 ||
+        fgetc(fp) != NEWLINE_CHAR || strcmp(magic, CACHE_MAGIC) != 0 ||
+        stored_size != source_size || sections < 0 || sections > MAX_CACHE_SECTIONS) {
+        fclose(fp);
+        return FALSE;
+    }
+
+    result->messages = calloc((size_t)sections + 1, sizeof(AsmMessage));
+    int ok = (result->messages != NULL);
+    int i;
+    for (i = 0; i < sections && ok; i++) {
+        char tag[16];
+        char *data;
+        size_t size;
+        if (!read_section(fp, tag, &data, &size)) {
+            ok = FALSE;
+            break;
+        }
+
+        if (strcmp(tag, "am") == 0) {
+            *am_text = data;
+            *am_size = size;
+        } else if (strcmp(tag, "ob") == 0) {
+            result->object = data;
+            result->object_size = size;
+        } else if (strcmp(tag, "ent") == 0) {
+            result->entries = data;
+            result->entries_size = size;
+        } else if (strcmp(tag, "ext") == 0) {
+            result->externals = data;
+            result->externals_size = size;
+        } else if (strcmp(tag, "out") == 0 || strcmp(tag, "err") == 0) {
+            char placeholder[2] = {NAME_PLACEHOLDER, NULL_CHAR};
+            AsmMessage *m = &result->messages[result->message_count];
+            m->text = swap_line_prefix(data, size, placeholder, name, &m->size);
+            m->is_error = (tag[0] == 'e');
+            free(data);
+            if (!m->text) ok = FALSE;
+            else result->message_count++;
+        } else {
+            free(data);
+            ok = FALSE;
+        }
+    }
+    fclose(fp);
+
+    if (!ok) {
+        asm_free_result(result);
+        free(*am_text);
+        *am_text = NULL;
+        return FALSE;
+    }
+    result->success = success;
+    return TRUE;
+}
+
+/* ---------------- API ---------------- */
+
+OutputCache *cache_open(const char *dir) {
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "%s: Error - cannot create cache directory\n", dir);
+        return NULL;
+    }
+
+    OutputCache *cache = calloc(1, sizeof(OutputCache));
+    if (!cache) return NULL;
+    cache->dir = malloc(strlen(dir) + 1);
+    cache->slots = calloc(MEMO_INITIAL_CAPACITY, sizeof(MemoSlot));
+    if (!cache->dir || !cache->slots) {
+        free(cache->dir);
+        free(cache->slots);
+        free(cache);
+        return NULL;
+    }
+    strcpy(cache->dir, dir);
+    cache->slot_capacity = MEMO_INITIAL_CAPACITY;
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->changed, NULL);
+    return cache;
+}
+
+void cache_close(OutputCache *cache) {
+    if (!cache) return;
+    pthread_cond_destroy(&cache->changed);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->slots);
+    free(cache->dir);
+    free(cache);
+}
+
+int cache_fetch(OutputCache *cache, CacheKey key, size_t source_size, const char *name,
+                AsmResult *result, char **am_text, size_t *am_size) {
+    pthread_mutex_lock(&cache->lock);
+
+    /* same source already in flight on another worker? wait for it */
+    MemoSlot *slot = memo_find(cache, key);
+    while (slot && slot->state == SLOT_BUSY) {
+        pthread_cond_wait(&cache->changed, &cache->lock);
+        slot = memo_find(cache, key);
+    }
+
+    int seen_before = (slot != NULL);
+    if (slot && slot->state == SLOT_UNCACHEABLE) {
+        cache->misses++;
+        pthread_mutex_unlock(&cache->lock);
+        return FALSE; /* store already failed once, dont bother */
+    }
+    if (!slot) slot = memo_insert(cache, key, SLOT_BUSY); /* claim it (NULL if oom, still works) */
+    pthread_mutex_unlock(&cache->lock);
+
+    double seconds = 0.0;
+    int hit = read_entry(cache, key, source_size, name, result, am_text, am_size, &seconds);
+
+    pthread_mutex_lock(&cache->lock);
+    slot = memo_find(cache, key);
+    if (hit) {
+        if (seen_before) cache->batch_hits++;
+        else cache->disk_hits++;
+        cache->saved_seconds += seconds;
+        if (slot) slot->state = SLOT_DONE;
+        pthread_cond_broadcast(&cache->changed);
+    } else {
+        cache->misses++;
+        if (slot) slot->state = SLOT_BUSY; /* ours now, cache_store releases it */
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return hit;
+}
+
+void cache_store(OutputCache *cache, CacheKey key, size_t source_size, const char *name,
+                 const AsmResult *result, const char *am_text, size_t am_size, double seconds) {
+    int written = write_entry(cache, key, source_size, name, result, am_text, am_size, seconds);
+
+    pthread_mutex_lock(&cache->lock);
+    if (!written) cache->store_failures++;
+    MemoSlot *slot = memo_find(cache, key);
+    if (!slot) slot = memo_insert(cache, key, SLOT_DONE);
+    if (slot) slot->state = written ? SLOT_DONE : SLOT_UNCACHEABLE;
+    pthread_cond_broadcast(&cache->changed);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void cache_print_stats(OutputCache *cache, FILE *out) {
+    pthread_mutex_lock(&cache->lock);
+    long hits = cache->disk_hits + cache->batch_hits;
+
+    fprintf(out, "cache: %ld hits (%ld from disk, %ld repeats in this batch), %ld misses",
+            hits, cache->disk_hits, cache->batch_hits, cache->misses);
+    if (cache->store_failures > 0) fprintf(out, ", %ld not stored", cache->store_failures);
+    fprintf(out, ", ~%.3f s saved\n", cache->saved_seconds);
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,51 @@
+#ifndef OUTPUT_CACHE_H
+#define OUTPUT_CACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "libasm.h"
+
+/*
+ * output_cache.h
+ * --------------
+ * Opt-in content-addressed cache (--cache DIR). The key is a hash of the
+ * .as bytes plus LIBASM_VERSION (and a variant string for options that change
+ * the output, like --emit-am), so a new assembler version never reuses old
+ * results. Each entry holds everything a run produces: the .am/.ob/.ent/.ext
+ * text and the printed messages (stored with the base name cut out, so the
+ * same source under another name still hits). Failing files are cached too.
+ *
+ * Inside one process identical sources are assembled once: the first worker
+ * claims the key, the others wait for it and then read its entry.
+ */
+
+typedef struct {
+    unsigned long long hi;
+    unsigned long long lo;
+} CacheKey;
+
+typedef struct OutputCache OutputCache;
+
+OutputCache *cache_open(const char *dir);   /* NULL (+ msg) if dir is unusable */
+void cache_close(OutputCache *cache);
+
+CacheKey cache_key(const char *source, size_t size, const char *variant);
+
+/*
+ * cache_fetch
+ * -----------
+ * TRUE on a hit: result (messages + outputs, no diagnostics) and am_text are
+ * filled for name. FALSE on a miss: the caller now owns the key and must call
+ * cache_store (even if the file failed) so other workers stop waiting.
+ */
+int cache_fetch(OutputCache *cache, CacheKey key, size_t source_size, const char *name,
+                AsmResult *result, char **am_text, size_t *am_size);
+
+/* publish a fresh result (seconds = how long assembling took, for the stats) */
+void cache_store(OutputCache *cache, CacheKey key, size_t source_size, const char *name,
+                 const AsmResult *result, const char *am_text, size_t am_size, double seconds);
+
+/* hit/miss counters + time saved (what the hits originally took to assemble) */
+void cache_print_stats(OutputCache *cache, FILE *out);
+
+#endif /* OUTPUT_CACHE_H */
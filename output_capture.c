@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "output_capture.h"
+
+/* each thread has its own capture target (NULL means print for real) */
+static __thread OutputCapture *current_capture = NULL;
+
+/* ---------------- internal helpers ---------------- */
+
+/* grow text buffer so it fits extra bytes (returns 0 if malloc died) */
+static int reserve_text(OutputCapture *cap, size_t extra) {
+    if (cap->text_size + extra <= cap->text_capacity) return 1;
+
+    size_t new_cap = (cap->text_capacity == 0) ? 256 : cap->text_capacity * 2;
+    while (new_cap < cap->text_size + extra) new_cap *= 2;
+
+    char *new_text = realloc(cap->text, new_cap);
+    if (!new_text) return 0;
+    cap->text = new_text;
+    cap->text_capacity = new_cap;
+    return 1;
+}
+
+/* grow chunk list by one slot */
+static int reserve_chunk(OutputCapture *cap) {
+    if (cap->chunk_count < cap->chunk_capacity) return 1;
+
+    int new_cap = (cap->chunk_capacity == 0) ? 16 : cap->chunk_capacity * 2;
+    CaptureChunk *new_chunks = realloc(cap->chunks, (size_t)new_cap * sizeof(CaptureChunk));
+    if (!new_chunks) return 0;
+    cap->chunks = new_chunks;
+    cap->chunk_capacity = new_cap;
+    return 1;
+}
+
+/* add bytes as (part of) a chunk of the given stream (capacity already reserved) */
+static void append_chunk(OutputCapture *cap, int to_stderr, size_t length) {
+    /* glue onto previous chunk when same stream (keeps chunk list short) */
+    if (cap->chunk_count > 0 && cap->chunks[cap->chunk_count - 1].to_stderr == to_stderr) {
+        cap->chunks[cap->chunk_count - 1].length += length;
+    } else {
+        CaptureChunk *c = &cap->chunks[cap->chunk_count++];
+        c->to_stderr = to_stderr;
+        c->offset = cap->text_size;
+        c->length = length;
+    }
+    cap->text_size += length;
+}
+
+/* format into capture, or straight to the stream if no capture is active */
+static void capture_vprintf(int to_stderr, const char *fmt, va_list args) {
+    OutputCapture *cap = current_capture;
+    FILE *stream = to_stderr ? stderr : stdout;
+
+    if (!cap) {
+        vfprintf(stream, fmt, args);
+        return;
+    }
+
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+    if (needed <= 0) return;
+
+    if (!reserve_text(cap, (size_t)needed + 1) || !reserve_chunk(cap)) {
+        vfprintf(stream, fmt, args); /* out of mem: better unordered than lost */
+        return;
+    }
+
+    vsnprintf(cap->text + cap->text_size, (size_t)needed + 1, fmt, args);
+    append_chunk(cap, to_stderr, (size_t)needed);
+}
+
+/* ---------------- API ---------------- */
+
+OutputCapture *capture_begin(OutputCapture *cap) {
+    OutputCapture *previous = current_capture;
+    current_capture = cap;
+    return previous;
+}
+
+void capture_end(OutputCapture *previous) {
+    current_capture = previous;
+}
+
+/* malloc'd copy of a string (NULL stays NULL) */
+static char *copy_text(const char *s) {
+    if (!s) return NULL;
+    size_t n = strlen(s) + 1;
+    char *copy = malloc(n);
+    if (copy) memcpy(copy, s, n);
+    return copy;
+}
+
+void capture_diagnostic(const char *file, int line, const char *message) {
+    OutputCapture *cap = current_capture;
+    if (!cap) return;
+
+    if (cap->diagnostic_count >= cap->diagnostic_capacity) {
+        int new_cap = (cap->diagnostic_capacity == 0) ? 8 : cap->diagnostic_capacity * 2;
+        CaptureDiagnostic *grown = realloc(cap->diagnostics, (size_t)new_cap * sizeof(CaptureDiagnostic));
+        if (!grown) return; /* text version still made it into the capture */
+        cap->diagnostics = grown;
+        cap->diagnostic_capacity = new_cap;
+    }
+
+    CaptureDiagnostic *d = &cap->diagnostics[cap->diagnostic_count];
+    d->file = copy_text(file);
+    d->line = line;
+    d->message = copy_text(message);
+    if (!d->file || !d->message) {
+        free(d->file);
+        free(d->message);
+        return;
+    }
+    cap->diagnostic_count++;
+}
+
+void capture_flush(OutputCapture *cap) {
+    if (!cap) return;
+    int i;
+    for (i = 0; i < cap->chunk_count; i++) {
+        FILE *stream = cap->chunks[i].to_stderr ? stderr : stdout;
+        fwrite(cap->text + cap->chunks[i].offset, 1, cap->chunks[i].length, stream);
+        fflush(stream); /* keep stdout/stderr interleaving like a serial run */
+    }
+    cap->chunk_count = 0;
+    cap->text_size = 0;
+}
+
+char *capture_collect(const OutputCapture *cap, int to_stderr, size_t *size) {
+    size_t total = 0;
+    int i;
+    for (i = 0; i < cap->chunk_count; i++) {
+        if (cap->chunks[i].to_stderr == to_stderr) total += cap->chunks[i].length;
+    }
+
+    char *joined = malloc(total + 1);
+    if (!joined) return NULL;
+
+    size_t at = 0;
+    for (i = 0; i < cap->chunk_count; i++) {
+        if (cap->chunks[i].to_stderr != to_stderr) continue;
+        memcpy(joined + at, cap->text + cap->chunks[i].offset, cap->chunks[i].length);
+        at += cap->chunks[i].length;
+    }
+    joined[at] = '\0';
+    *size = at;
+    return joined;
+}
+
+void capture_free(OutputCapture *cap) {
+    if (!cap) return;
+    int i;
+    for (i = 0; i < cap->diagnostic_count; i++) {
+        free(cap->diagnostics[i].file);
+        free(cap->diagnostics[i].message);
+    }
+    free(cap->diagnostics);
+    free(cap->text);
+    free(cap->chunks);
+    memset(cap, 0, sizeof(*cap));
+}
+
+void out_printf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    capture_vprintf(0, fmt, args);
+    va_end(args);
+}
+
+void err_printf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    capture_vprintf(1, fmt, args);
+    va_end(args);
+}
+
+void out_write(const char *data, size_t size) {
+    OutputCapture *cap = current_capture;
+    if (size == 0) return;
+
+    if (!cap || !reserve_text(cap, size) || !reserve_chunk(cap)) {
+        fwrite(data, 1, size, stdout);
+        return;
+    }
+    memcpy(cap->text + cap->text_size, data, size);
+    append_chunk(cap, 0, size);
+}
@@ -0,0 +1,60 @@
+#ifndef OUTPUT_CAPTURE_H
+#define OUTPUT_CAPTURE_H
+
+#include <stddef.h>
+
+/*
+ * OutputCapture
+ * -------------
+ * Collects everything one file would print (stdout + stderr) while it runs
+ * on a worker thread, so the batch can replay it later in the original order.
+ * Each chunk remembers which stream it belongs to (so the split stays the same).
+ */
+typedef struct {
+    int to_stderr;   /* 1 = stderr, 0 = stdout */
+    size_t offset;   /* where the text starts inside OutputCapture.text */
+    size_t length;
+} CaptureChunk;
+
+/* one print_error() call, kept apart so callers get file/line/msg without parsing */
+typedef struct {
+    char *file;
+    int line;
+    char *message;
+} CaptureDiagnostic;
+
+typedef struct {
+    char *text;             /* all chunks back to back (not null terminated) */
+    size_t text_size;
+    size_t text_capacity;
+    CaptureChunk *chunks;
+    int chunk_count;
+    int chunk_capacity;
+    CaptureDiagnostic *diagnostics;
+    int diagnostic_count;
+    int diagnostic_capacity;
+} OutputCapture;
+
+/* route this thread's out_printf/err_printf into cap. captures can nest:
+   begin returns the previous target and end puts it back */
+OutputCapture *capture_begin(OutputCapture *cap);
+void capture_end(OutputCapture *previous);
+
+/* remember an error's parts (only if a capture is active, text still goes via err_printf) */
+void capture_diagnostic(const char *file, int line, const char *message);
+
+/* write captured chunks to stdout/stderr in order, then forget them */
+void capture_flush(OutputCapture *cap);
+void capture_free(OutputCapture *cap);
+
+/* all text of one stream joined into a malloc'd string (for sending it elsewhere) */
+char *capture_collect(const OutputCapture *cap, int to_stderr, size_t *size);
+
+/* printf replacements used by every stage (thread aware) */
+void out_printf(const char *fmt, ...);
+void err_printf(const char *fmt, ...);
+
+/* raw bytes to stdout (same routing as out_printf, for payloads that arent text lines) */
+void out_write(const char *data, size_t size);
+
+#endif /* OUTPUT_CAPTURE_H */
@@ -4,183 +4,245 @@
 #include <ctype.h>
 #include "pre_assembly.h"
 #include "util.h"
+#include "output_capture.h"
+#include "asm_stats.h"
 
 /* =========================================================================
  * helpers: safe allocation (filename-aware)
- * these just wrap malloc/realloc so when memory dies we cry less :)
+ * these just wrap malloc/realloc so when memory dies we get an error msg
+ * (and NULL back) instead of a silent crash. no exit() here, the assembler
+ * may live inside a bigger program (libasm) so we just fail this file.
  * ========================================================================= */
 
-static void *checked_malloc(const char *filename, size_t size) {
-    void *ptr = malloc(size);
+static void *checked_malloc(const char *filename, Arena *arena, size_t size) {
+    void *ptr = arena_alloc(arena, size);
     if (!ptr) {
         print_error(filename, 0, "Memory allocation failed");
-        exit(1);
     }
     return ptr;
 }
 
-static void *checked_realloc(const char *filename, void *ptr, size_t size) {
-    void *new_ptr = realloc(ptr, size);
+/* on failure the old block is still valid (and still owned by caller) */
+static void *checked_realloc(const char *filename, Arena *arena, void *ptr, size_t old_size,
+                             size_t size) {
+    void *new_ptr = arena_realloc(arena, ptr, old_size, size);
     if (!new_ptr) {
         print_error(filename, 0, "Memory reallocation failed");
-        exit(1);
     }
     return new_ptr;
 }
 
-static char *safe_strdup(const char *filename, const char *s) {
-    size_t n = strlen(s) + 1;
-    char *copy = checked_malloc(filename, n);
-    strcpy(copy, s);
-    return copy;
-}
-
 /* =========================================================================
  * helpers: small string utils (trimming, classification)
  * ========================================================================= */
 
-/* trims line of \r / \n and leading spaces (basic but works fine) */
-static void trim_line(char *line) {
-    size_t len = strlen(line);
-    while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == NEWLINE_CHAR))
-        line[--len] = NULL_CHAR;
+/* trims the view of trailing \r / \n and leading spaces (basic but works fine) */
+static void trim_line(LineView *line) {
+    while (line->length > 0 &&
+           (line->start[line->length - 1] == '\r' || line->start[line->length - 1] == NEWLINE_CHAR))
+        line->length--;
 
-    char *start = line;
-    while (isspace((unsigned char)*start))
-        start++;
+    while (line->length > 0 && isspace((unsigned char)*line->start)) {
+        line->start++;
+        line->length--;
+    }
+}
 
-    if (start != line)
-        memmove(line, start, strlen(start) + 1);
+/* line is keyword alone or keyword + space + whatever */
+static int starts_with_keyword(const LineView *line, const char *keyword, size_t keyword_len) {
+    return line->length >= keyword_len && memcmp(line->start, keyword, keyword_len) == 0 &&
+           (line->length == keyword_len || isspace((unsigned char)line->start[keyword_len]));
 }
 
 /* detect "mcro" start (with optional space after) */
-static int is_macro_start(const char *line) {
-    return strncmp(line, MACRO_KEYWORD, MACRO_LEN) == 0 &&
-           (line[MACRO_LEN] == NULL_CHAR || isspace((unsigned char)line[MACRO_LEN]));
+static int is_macro_start(const LineView *line) {
+    return starts_with_keyword(line, MACRO_KEYWORD, MACRO_LEN);
 }
 
 /* detect "mcroend" end (with optional space after) */
-static int is_macro_end(const char *line) {
-    return strncmp(line, MACRO_END_KEYWORD, MACRO_END_LEN) == 0 &&
-           (line[MACRO_END_LEN] == NULL_CHAR || isspace((unsigned char)line[MACRO_END_LEN]));
-}
-
-/* too long means user forgot newline or line exploded past 80 chars */
-static int is_line_too_long(const char *line) {
-    return strlen(line) == MAX_LINE_LENGTH - 1 && line[MAX_LINE_LENGTH - 2] != NEWLINE_CHAR;
+static int is_macro_end(const LineView *line) {
+    return starts_with_keyword(line, MACRO_END_KEYWORD, MACRO_END_LEN);
 }
 
 /* when inside invalid macro, skip until mcroend to avoid mess */
-static void skip_until_macro_end(FILE *in, int *line_number) {
-    char temp[MAX_LINE_LENGTH];
-    while (fgets(temp, MAX_LINE_LENGTH, in)) {
+static void skip_until_macro_end(LineReader *reader, int *line_number) {
+    LineView temp;
+    while (line_reader_next(reader, &temp)) {
         (*line_number)++;
-        if (is_macro_end(temp)) break;
+        if (is_macro_end(&temp)) break;
     }
 }
 
 /* after 'mcroend' we dont allow extra text (keeps syntax tidy) */
-static int has_text_after_macroend(const char *line) {
-    const char *after = line + strlen(MACRO_END_KEYWORD);
-    while (isspace((unsigned char)*after)) after++;
-    return *after != NULL_CHAR;
+static int has_text_after_macroend(const LineView *line) {
+    size_t i = MACRO_END_LEN;
+    while (i < line->length && isspace((unsigned char)line->start[i])) i++;
+    return i < line->length;
 }
 
 /* =========================================================================
  * helpers: macro table management (no globals)
  * ========================================================================= */
 
-/* copy macro into table (deep copy of lines cuz we free later) */
-static void add_macro(const char *filename, MacroTable *mtbl, const Macro *macro) {
-    if (mtbl->count >= mtbl->capacity) {
-        mtbl->capacity = (mtbl->capacity == 0) ? DEFAULT_MACRO_CAPACITY : mtbl->capacity * GROWTH_FACTOR;
-        mtbl->data = checked_realloc(filename, mtbl->data, mtbl->capacity * sizeof(Macro));
+/* first size of the name index (power of 2, mask instead of %) */
+#define INITIAL_MACRO_SLOTS 32
+/* first size of the macro bodies buffer (bytes) */
+#define INITIAL_BODIES_SIZE 1024
+
+/* slot holding name[0..len) in the index, or the empty slot it would go in */
+static int find_macro_slot(const MacroTable *mtbl, const char *name, size_t len, unsigned int hash) {
+    unsigned int mask = (unsigned int)mtbl->slot_count - 1;
+    unsigned int i = hash & mask;
+    while (mtbl->slots[i] != NOT_FOUND) {
+        const Macro *macro = &mtbl->data[mtbl->slots[i]];
+        if (macro->hash == hash && strncmp(macro->name, name, len) == 0 && macro->name[len] == NULL_CHAR)
+            return (int)i;
+        i = (i + 1) & mask;
     }
+    return (int)i;
+}
 
-    Macro copy;
-    strcpy(copy.name, macro->name);
-    copy.line_count = macro->line_count;
-    copy.capacity   = macro->capacity;
+/* macro called name[0..len) or NULL (name doesnt need a null char at len) */
+static const Macro *find_macro(const MacroTable *mtbl, const char *name, size_t len) {
+    if (mtbl->slot_count == 0) return NULL;
+    int slot = find_macro_slot(mtbl, name, len, hash_name(name, len));
+    return (mtbl->slots[slot] == NOT_FOUND) ? NULL : &mtbl->data[mtbl->slots[slot]];
+}
 
-    copy.lines = checked_malloc(filename, copy.capacity * sizeof(char *));
-    int i;
-for (i = 0; i < copy.line_count; i++) {
-        copy.lines[i] = safe_strdup(filename, macro->lines[i]);
+/* name[0..len) in this table or the prelude under it (*owner = the table the body is in) */
+static const Macro *lookup_macro(const MacroTable *mtbl, const char *name, size_t len,
+                                 const MacroTable **owner) {
+    for (; mtbl; mtbl = mtbl->prelude) {
+        const Macro *macro = find_macro(mtbl, name, len);
+        if (macro) {
+            if (owner) *owner = mtbl;
+            return macro;
+        }
+    }
+    return NULL;
+}
+
+/* put data[index] in the index (grows it at half full). a name thats already
+   there keeps pointing at its first definition. returns TRUE on error */
+static int index_macro(const char *filename, MacroTable *mtbl, int index) {
+    if ((index + 1) * 2 > mtbl->slot_count) {
+        int new_count = (mtbl->slot_count == 0) ? INITIAL_MACRO_SLOTS : mtbl->slot_count * GROWTH_FACTOR;
+        int *new_slots;
+        int i;
+
+        new_slots = checked_malloc(filename, mtbl->arena, (size_t)new_count * sizeof(int));
+        if (!new_slots) return TRUE;
+        for (i = 0; i < new_count; i++) new_slots[i] = NOT_FOUND;
+
+        int *old_slots = mtbl->slots;
+        int old_count = mtbl->slot_count;
+        mtbl->slots = new_slots;
+        mtbl->slot_count = new_count;
+        for (i = 0; i < old_count; i++) {
+            if (old_slots[i] == NOT_FOUND) continue;
+            const Macro *macro = &mtbl->data[old_slots[i]];
+            new_slots[find_macro_slot(mtbl, macro->name, strlen(macro->name), macro->hash)] = old_slots[i];
+        }
+        arena_free(mtbl->arena, old_slots);
+    }
+
+    const Macro *macro = &mtbl->data[index];
+    int slot = find_macro_slot(mtbl, macro->name, strlen(macro->name), macro->hash);
+    if (mtbl->slots[slot] == NOT_FOUND)
+        mtbl->slots[slot] = index;
+    return FALSE;
+}
+
+/* move the finished macro into the table (its body is already in mtbl->bodies)
+   returns TRUE on error (same convention as add_line_to_macro) */
+static int add_macro(const char *filename, MacroTable *mtbl, const Macro *macro) {
+    if (mtbl->count >= mtbl->capacity) {
+        int new_capacity = (mtbl->capacity == 0) ? DEFAULT_MACRO_CAPACITY : mtbl->capacity * GROWTH_FACTOR;
+        Macro *new_data = checked_realloc(filename, mtbl->arena, mtbl->data, mtbl->capacity * sizeof(Macro),
+                                          new_capacity * sizeof(Macro));
+        if (!new_data) return TRUE;
+        mtbl->data = new_data;
+        mtbl->capacity = new_capacity;
     }
 
-    mtbl->data[mtbl->count++] = copy;
+    Macro *slot = &mtbl->data[mtbl->count++];
+    *slot = *macro;
+    slot->hash = hash_name(slot->name, strlen(slot->name));
+    return index_macro(filename, mtbl, mtbl->count - 1);
 }
 
 /* dont allow macro names to collide with commands / data names */
 static int is_reserved_macro_name(const char *name) {
-    int i;
-for (i = 0; i < NUMBER_OF_COMMANDS + NUMBER_OF_DATA_TYPES; i++) {
-        if (strcmp(name, command_names[i]) == 0)
-            return TRUE;
-    }
-    return FALSE;
+    return find_reserved_word(name, strlen(name)) != NOT_FOUND;
 }
 
 /* already defined? thats a user mistake (we block it) */
 static int is_macro_already_defined(const MacroTable *mtbl, const char *name) {
-    int i;
-for (i = 0; i < mtbl->count; i++) {
-        if (strcmp(name, mtbl->data[i].name) == 0)
-            return TRUE;
-    }
-    return FALSE;
+    return lookup_macro(mtbl, name, strlen(name), NULL) != NULL;
 }
 
 /* public free (pls call me or you’ll leak mem) */
 void free_macro_table(MacroTable *mtbl) {
     if (!mtbl) return;
-    int i;
-for (i = 0; i < mtbl->count; i++) {
-        int j;
-for (j = 0; j < mtbl->data[i].line_count; j++)
-            free(mtbl->data[i].lines[j]);
-        free(mtbl->data[i].lines);
-    }
-    free(mtbl->data);
+    arena_free(mtbl->arena, mtbl->data);
+    arena_free(mtbl->arena, mtbl->slots);
+    arena_free(mtbl->arena, mtbl->bodies);
     mtbl->data = NULL;
     mtbl->count = 0;
     mtbl->capacity = 0;
+    mtbl->slots = NULL;
+    mtbl->slot_count = 0;
+    mtbl->bodies = NULL;
+    mtbl->bodies_size = 0;
+    mtbl->bodies_capacity = 0;
 }
 
 /* =========================================================================
  * helpers: building a macro (collect lines, grow arrays)
  * ========================================================================= */
 
-/* push a line into current macro, realloc when needed */
-static int add_line_to_macro(const char *filename, Macro *macro, const char *line) {
-    if (macro->line_count >= macro->capacity) {
-        int new_capacity = (macro->capacity == 0) ? INITIAL_LINE_CAPACITY : macro->capacity * GROWTH_FACTOR;
-        char **new_lines = realloc(macro->lines, new_capacity * sizeof(char *));
-        if (!new_lines) {
+/* push a line (+ '\n') onto the end of the bodies buffer, current macro grows by it */
+static int add_line_to_macro(const char *filename, MacroTable *mtbl, Macro *macro, const LineView *line) {
+    size_t length = line->length;
+
+    if (mtbl->bodies_size + length + 1 > mtbl->bodies_capacity) {
+        size_t new_capacity = (mtbl->bodies_capacity == 0) ? INITIAL_BODIES_SIZE : mtbl->bodies_capacity;
+        while (new_capacity < mtbl->bodies_size + length + 1) new_capacity *= GROWTH_FACTOR;
+        char *new_bodies = arena_realloc(mtbl->arena, mtbl->bodies, mtbl->bodies_size, new_capacity);
+        if (!new_bodies) {
             print_error(filename, -1, "Memory allocation failed while expanding macro lines");
             return TRUE;
         }
-        macro->lines    = new_lines;
-        macro->capacity = new_capacity;
+        mtbl->bodies = new_bodies;
+        mtbl->bodies_capacity = new_capacity;
     }
 
-    macro->lines[macro->line_count++] = safe_strdup(filename, line);
+    memcpy(mtbl->bodies + mtbl->bodies_size, line->start, length);
+    mtbl->bodies_size += length;
+    mtbl->bodies[mtbl->bodies_size++] = NEWLINE_CHAR;
+    macro->body_size += length + 1;
+    macro->line_count++;
     return FALSE;
 }
 
 /* parse and validate "mcro <name>" line, init the macro */
 static void handle_macro_definition(const char *filename,
-                                    char *line,
+                                    const LineView *view,
                                     int line_number,
                                     int *inside_macro,
                                     int *inside_an_invalid_macro,
                                     int *had_error,
                                     Macro *current_macro,
                                     MacroTable *mtbl) {
+    char line[MAX_LINE_LENGTH];
     char name[MAX_LINE_LENGTH];
     char extra[MAX_LINE_LENGTH];
     int items_read;
 
+    /* sscanf wants a c-string (fits, too long lines never get here) */
+    memcpy(line, view->start, view->length);
+    line[view->length] = NULL_CHAR;
+
     *inside_macro = FALSE;
     *inside_an_invalid_macro = TRUE;
 
@@ -219,14 +281,9 @@ static void handle_macro_definition(const char *filename,
     }
 
     strcpy(current_macro->name, name);
-    current_macro->capacity   = 10;
-    current_macro->line_count = 0;
-    current_macro->lines      = checked_malloc(filename, current_macro->capacity * sizeof(char *));
-    if (!current_macro->lines) {
-        print_error(filename, 0, "Memory allocation failed for macro lines");
-        *had_error = TRUE;
-        return;
-    }
+    current_macro->body_offset = mtbl->bodies_size;
+    current_macro->body_size   = 0;
+    current_macro->line_count  = 0;
 
     *inside_macro = TRUE;
     *inside_an_invalid_macro = FALSE;
@@ -236,54 +293,59 @@ static void handle_macro_definition(const char *filename,
  * helpers: emitting to output (macro expansion / normal line)
  * ========================================================================= */
 
-/* if the first token matches a macro name, expand it (and complain on extra text) */
-static int expand_macro_if_match(FILE *out,
+/* if the first token matches a macro name, expand it (and complain on extra text).
+   line is already trimmed, so the token is everything up to the first space */
+static int expand_macro_if_match(LineSink *out,
                                  const char *filename,
-                                 const char *line,
+                                 const LineView *line,
                                  int line_number,
                                  const MacroTable *mtbl,
                                  int *had_error) {
-    char first_token[MAX_LINE_LENGTH];
+    const char *line_end = line->start + line->length;
+    const char *token_end = line->start;
+    while (token_end < line_end && !isspace((unsigned char)*token_end)) token_end++;
+    if (token_end == line->start)
+        return FALSE;
 
-    if (sscanf(line, "%s", first_token) != 1)
+    const MacroTable *owner;
+    const Macro *macro = lookup_macro(mtbl, line->start, (size_t)(token_end - line->start), &owner);
+    if (!macro)
         return FALSE;
 
-    int i;
-for (i = 0; i < mtbl->count; ++i) {
-        if (strcmp(first_token, mtbl->data[i].name) == 0) {
-            const char *p = line + strlen(first_token);
-            while (isspace((unsigned char)*p)) p++;
-
-            if (*p != '\0') {
-                print_error(filename, line_number, "unexpected text after macro invocation");
-                *had_error = TRUE;
-            }
+    const char *p = token_end;
+    while (p < line_end && isspace((unsigned char)*p)) p++;
 
-            int j;
-for (j = 0; j < mtbl->data[i].line_count; ++j)
-                fprintf(out, "%s\n", mtbl->data[i].lines[j]);
+    if (p < line_end) {
+        print_error(filename, line_number, "unexpected text after macro invocation");
+        *had_error = TRUE;
+    }
 
-            return TRUE; /* expanded */
-        }
+    STATS_COUNT(ASM_COUNT_MACRO_EXPANSION);
+
+    /* whole body in one go, every line maps back to the line that called the macro */
+    if (!sink_add_block(out, owner->bodies + macro->body_offset, macro->body_size, line_number)) {
+        print_error(filename, line_number, "Memory allocation failed");
+        *had_error = TRUE;
     }
-    return FALSE;
+
+    return TRUE; /* expanded */
 }
 
-/* write a normal line, make sure it ends with newline (or printf will look ugly) */
-static void write_normal_line(FILE *out, const char *line) {
-    fprintf(out, "%s", line);
-    size_t len = strlen(line);
-    if (len == 0 || line[len - 1] != NEWLINE_CHAR)
-        fprintf(out, "%c", NEWLINE_CHAR);
+/* pass a normal line through (the sink adds the newline) */
+static int write_normal_line(LineSink *out, const char *filename, const LineView *line, int line_number) {
+    if (sink_add_line(out, line->start, line->length, line_number)) return FALSE;
+    print_error(filename, line_number, "Memory allocation failed");
+    return TRUE;
 }
 
 /* =========================================================================
- * core api: preprocess_file  (reads in, writes out, handles macros)
+ * core api: preprocess_source  (reads lines, writes out, handles macros)
  * ========================================================================= */
 
-int preprocess_file(FILE *in, FILE *out, const char *filename, MacroTable *mtbl) {
+int preprocess_source(const char *source, size_t size, LineSink *out, const char *filename, MacroTable *mtbl) {
     int had_error = FALSE;
-    char line[MAX_LINE_LENGTH];
+    LineReader reader;
+    LineView line;
     int inside_macro = FALSE;
     int inside_an_invalid_macro = FALSE;
     Macro current_macro;
@@ -294,28 +356,28 @@ int preprocess_file(FILE *in, FILE *out, const char *filename, MacroTable *mtbl)
         return FALSE;
     }
 
-    while (fgets(line, MAX_LINE_LENGTH, in)) {
-        if (is_line_too_long(line)) {
+    line_reader_init(&reader, source, size);
+    while (line_reader_next(&reader, &line)) {
+        if (line.too_long) {
             print_error(filename, line_number, "line exceeds 80 characters");
             had_error = TRUE;
             inside_an_invalid_macro = TRUE;
-            int ch;
-            while ((ch = fgetc(in)) != NEWLINE_CHAR && ch != EOF) { }
             line_number++;
             continue;
         }
 
-        trim_line(line);
+        trim_line(&line);
 
-        if (inside_macro && is_macro_start(line)) {
+        if (inside_macro && is_macro_start(&line)) {
             print_error(filename, line_number, "cannot define a macro inside another macro");
             had_error = TRUE;
-            skip_until_macro_end(in, &line_number);
+            skip_until_macro_end(&reader, &line_number);
+            mtbl->bodies_size = current_macro.body_offset; /* drop the half-made body */
             inside_macro = FALSE;
             continue;
         }
 
-        if (!inside_macro && !inside_an_invalid_macro && is_macro_end(line)) {
+        if (!inside_macro && !inside_an_invalid_macro && is_macro_end(&line)) {
             print_error(filename, line_number, "'mcroend' without matching 'mcro'");
             had_error = TRUE;
             line_number++;
@@ -323,36 +385,38 @@ int preprocess_file(FILE *in, FILE *out, const char *filename, MacroTable *mtbl)
         }
 
         if (inside_macro) {
-            if (is_macro_end(line)) {
-                if (has_text_after_macroend(line)) {
+            if (is_macro_end(&line)) {
+                if (has_text_after_macroend(&line)) {
                     print_error(filename, line_number, "text after 'mcroend' is not allowed");
                     had_error = TRUE;
                 }
-                add_macro(filename, mtbl, &current_macro);
+                if (add_macro(filename, mtbl, &current_macro))
+                    had_error = TRUE;
                 inside_macro = FALSE;
                 inside_an_invalid_macro = FALSE;
             } else {
-                if (add_line_to_macro(filename, &current_macro, line))
+                if (add_line_to_macro(filename, mtbl, &current_macro, &line))
                     had_error = TRUE;
             }
             line_number++;
             continue;
         }
 
-        if (is_macro_start(line)) {
-            handle_macro_definition(filename, line, line_number,
+        if (is_macro_start(&line)) {
+            handle_macro_definition(filename, &line, line_number,
                                     &inside_macro, &inside_an_invalid_macro, &had_error,
                                     &current_macro, mtbl);
             line_number++;
             continue;
         }
 
-        if (expand_macro_if_match(out, filename, line, line_number, mtbl, &had_error)) {
+        if (expand_macro_if_match(out, filename, &line, line_number, mtbl, &had_error)) {
             line_number++;
             continue;
         }
 
-        write_normal_line(out, line);
+        if (write_normal_line(out, filename, &line, line_number))
+            had_error = TRUE;
         line_number++;
     }
 
@@ -360,34 +424,39 @@ int preprocess_file(FILE *in, FILE *out, const char *filename, MacroTable *mtbl)
 }
 
 /* =========================================================================
- * top-level runner: run_pre_assembly (creates .am file and cleans up)
+ * top-level runner: run_pre_assembly_to_sink (expanded lines stay in memory)
  * ========================================================================= */
 
-int run_pre_assembly(FILE *in, const char *base_filename) {
-    char output_filename[MAX_FILENAME];
-    snprintf(output_filename, MAX_FILENAME, "%s.am", base_filename);
-
-    FILE *out = fopen(output_filename, "w");
-    if (!out) {
-        char buf[256];
-        snprintf(buf, sizeof(buf), "cannot create output file: %s", output_filename);
-        print_error(base_filename, 0, buf);
-        return 1;
-    }
-
-    printf("%s: Starting preprocessing\n", base_filename);
+int run_pre_assembly_to_sink(const char *source, size_t size, LineSink *out, const char *base_filename,
+                             const MacroTable *prelude, Arena *arena) {
+    out_printf("%s: Starting preprocessing\n", base_filename);
 
     MacroTable mtbl = (MacroTable){0};
-    int had_error = preprocess_file(in, out, base_filename, &mtbl);
+    mtbl.prelude = prelude;
+    mtbl.arena = arena;
+    int had_error = preprocess_source(source, size, out, base_filename, &mtbl);
+    free_macro_table(&mtbl);
 
-    if (had_error) {
-        remove(output_filename);
-    } else {
-        printf("%s: .am file created\n", base_filename);
-    }
+    return had_error;
+}
 
-    fclose(out);
-    free_macro_table(&mtbl);
+/* =========================================================================
+ * prelude: macros parsed once and shared by every file of a batch
+ * ========================================================================= */
+
+int parse_prelude(const char *source, size_t size, const char *filename, MacroTable *mtbl) {
+    LineSink leftover;
+    int i;
 
+    /* whatever isnt a definition comes out as an expanded line */
+    sink_init(&leftover, NULL);
+    int had_error = preprocess_source(source, size, &leftover, filename, mtbl);
+    for (i = 0; i < leftover.line_count; i++) {
+        const SinkLine *line = &leftover.lines[i];
+        if (line->length == 0 || leftover.text[line->offset] == COMMENT_CHAR) continue;
+        print_error(filename, line->source_line, "only macro definitions are allowed in a prelude");
+        had_error = TRUE;
+    }
+    sink_free(&leftover);
     return had_error;
 }
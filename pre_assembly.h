@@ -3,27 +3,57 @@
 
 #include <stdio.h>
 #include "util.h"
+#include "line_sink.h"
+#include "line_reader.h"
+#include "arena.h"
 
-/* macro object - kinda simple: name + captured lines */
+/* macro object - kinda simple: name + where its body sits in the table's
+   bodies buffer (the body lines back to back, each ending with '\n', so an
+   expansion is one copy of that range) */
 typedef struct {
     char name[MAX_LINE_LENGTH];
-    char **lines;
+    unsigned int hash;      /* hash_name(name), checked before the strcmp */
+    size_t body_offset;
+    size_t body_size;
     int line_count;
-    int capacity;
 } Macro;
 
-/* table of macros (encapsulated state, no globals here) */
-typedef struct {
+/* table of macros (encapsulated state, no globals here).
+   slots is an open addressing index into data (NOT_FOUND = empty) so looking
+   a name up doesnt strcmp every macro (files with hundreds of them).
+   bodies is one growing buffer for every macro body of the file, the macro
+   being defined writes straight into its end.
+   prelude = macros shared by the whole batch (--prelude), looked up after
+   this table's own and never written to (many files read it at once).
+   arena = where data/slots/bodies come from (NULL = malloc, like a prelude) */
+typedef struct MacroTable {
     Macro *data;
     int count;
     int capacity;
+    int *slots;
+    int slot_count;     /* power of 2, at least 2x count */
+    char *bodies;
+    size_t bodies_size;
+    size_t bodies_capacity;
+    const struct MacroTable *prelude;
+    Arena *arena;
 } MacroTable;
 
 /* lifecycle (freeing mem is imporant lol) */
 void free_macro_table(MacroTable *mtbl);
 
-/* main api (preprocess runs on a FILE*, runner makes .am file) */
-int preprocess_file(FILE *in, FILE *out, const char *filename, MacroTable *mtbl);
-int run_pre_assembly(FILE *in, const char *base_filename);
+/* main api (preprocess reads the source buffer into a line sink).
+   source is the whole .as text, no null char needed at the end */
+int preprocess_source(const char *source, size_t size, LineSink *out, const char *filename, MacroTable *mtbl);
+/* preprocess with the start message, the expanded lines stay in memory (the
+   cli's --emit-am writes them out, the library never makes a .am file).
+   prelude = shared macros the file can call (NULL = none), arena = where the
+   file's macro table lives (NULL = malloc) */
+int run_pre_assembly_to_sink(const char *source, size_t size, LineSink *out, const char *base_filename,
+                             const MacroTable *prelude, Arena *arena);
+
+/* parse a prelude (only macro definitions, comments and blank lines) into mtbl.
+   returns TRUE if it had errors */
+int parse_prelude(const char *source, size_t size, const char *filename, MacroTable *mtbl);
 
 #endif /* PRE_ASSEMBLY_H */
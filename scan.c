@@ -0,0 +1,151 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "scan.h"
+#include "util.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SCAN_HAVE_X86 1
+#include <immintrin.h>
+#else
+#define SCAN_HAVE_X86 0
+#endif
+
+typedef uint64_t (*ScanBlockFn)(const ScanSet *set, const char *block);
+
+/* ===== scalar (always there) ===== */
+
+static uint64_t scan_block_scalar(const ScanSet *set, const char *block) {
+    uint64_t mask = 0;
+    int i;
+    for (i = 0; i < SCAN_BLOCK_SIZE; i++) {
+        mask |= (uint64_t)set->member[(unsigned char)block[i]] << i;
+    }
+    return mask;
+}
+
+#if SCAN_HAVE_X86
+
+/* ===== sse2: 4 x 16 bytes ===== */
+
+static uint64_t scan_16_sse2(const ScanSet *set, const char *p) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+    __m128i hits = _mm_setzero_si128();
+    int i;
+
+    for (i = 0; i < set->char_count; i++) {
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(set->chars[i])));
+    }
+    if (set->with_space) {
+        /* ' ' or '\t'..'\r' (unsigned c - '\t' <= 4) */
+        __m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted));
+    }
+    return (uint64_t)(unsigned int)_mm_movemask_epi8(hits);
+}
+
+static uint64_t scan_block_sse2(const ScanSet *set, const char *block) {
+    return scan_16_sse2(set, block)
+         | scan_16_sse2(set, block + 16) << 16
+         | scan_16_sse2(set, block + 32) << 32
+         | scan_16_sse2(set, block + 48) << 48;
+}
+
+/* ===== avx2: 2 x 32 bytes (only called if the cpu says it has avx2) ===== */
+
+__attribute__((target("avx2")))
+static uint64_t scan_32_avx2(const ScanSet *set, const char *p) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i *)p);
+    __m256i hits = _mm256_setzero_si256();
+    int i;
+
+    for (i = 0; i < set->char_count; i++) {
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(set->chars[i])));
+    }
+    if (set->with_space) {
+        __m256i shifted = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')));
+        hits = _mm256_or_si256(hits,
+                               _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted));
+    }
+    return (uint64_t)(unsigned int)_mm256_movemask_epi8(hits);
+}
+
+__attribute__((target("avx2")))
+static uint64_t scan_block_avx2(const ScanSet *set, const char *block) {
+    return scan_32_avx2(set, block) | scan_32_avx2(set, block + 32) << 32;
+}
+
+#endif /* SCAN_HAVE_X86 */
+
+/* ===== picking a path ===== */
+
+static ScanBlockFn scan_fns[SCAN_IMPL_COUNT];
+static ScanImpl active_impl = SCAN_IMPL_SCALAR;
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+
+static void detect_impls(void) {
+    scan_fns[SCAN_IMPL_SCALAR] = scan_block_scalar;
+#if SCAN_HAVE_X86
+    __builtin_cpu_init();
+    scan_fns[SCAN_IMPL_SSE2] = scan_block_sse2;   /* every x86-64 has sse2 */
+    active_impl = SCAN_IMPL_SSE2;
+    if (__builtin_cpu_supports("avx2")) {
+        scan_fns[SCAN_IMPL_AVX2] = scan_block_avx2;
+        active_impl = SCAN_IMPL_AVX2;
+    }
+#endif
+}
+
+void scan_set_init(ScanSet *set, const char *chars, int count, int with_space) {
+    int i;
+    pthread_once(&detect_once, detect_impls);
+
+    memset(set, 0, sizeof(*set));
+    set->char_count = count < SCAN_MAX_CHARS ? count : SCAN_MAX_CHARS;
+    set->with_space = with_space;
+    for (i = 0; i < set->char_count; i++) {
+        set->chars[i] = chars[i];
+        set->member[(unsigned char)chars[i]] = 1;
+    }
+    if (with_space) {
+        set->member[' '] = set->member['\t'] = set->member['\n'] = 1;
+        set->member['\v'] = set->member['\f'] = set->member['\r'] = 1;
+    }
+}
+
+uint64_t scan_block(const ScanSet *set, const char *block) {
+    return scan_fns[active_impl](set, block);
+}
+
+uint64_t scan_partial(const ScanSet *set, const char *p, size_t length) {
+    char padded[SCAN_BLOCK_SIZE];
+
+    if (length >= SCAN_BLOCK_SIZE) return scan_block(set, p);
+    /* zeros past the end only match if '\0' is in the set, mask those off */
+    memcpy(padded, p, length);
+    memset(padded + length, 0, SCAN_BLOCK_SIZE - length);
+    return scan_block(set, padded) & (((uint64_t)1 << length) - 1);
+}
+
+ScanImpl scan_active_impl(void) {
+    pthread_once(&detect_once, detect_impls);
+    return active_impl;
+}
+
+const char *scan_impl_name(ScanImpl impl) {
+    switch (impl) {
+    case SCAN_IMPL_SCALAR: return "scalar";
+    case SCAN_IMPL_SSE2: return "sse2";
+    case SCAN_IMPL_AVX2: return "avx2";
+    default: return "?";
+    }
+}
+
+int scan_force_impl(ScanImpl impl) {
+    pthread_once(&detect_once, detect_impls);
+    if (impl < 0 || impl >= SCAN_IMPL_COUNT || scan_fns[impl] == NULL) return FALSE;
+    active_impl = impl;
+    return TRUE;
+}
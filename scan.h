@@ -0,0 +1,58 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * scan.h
+ * ------
+ * Structural scanner: finds a small set of chars (newlines, ':', ',', ...)
+ * 64 bytes at a time and hands back a bitmap, bit i set = byte i is one of
+ * them. Callers walk the set bits instead of going char by char.
+ *
+ * On x86-64 the block scan uses AVX2 or SSE2 (picked once at runtime from
+ * what the cpu has), anywhere else (or if forced) a plain table loop.
+ * All three give the exact same bitmaps.
+ */
+
+#define SCAN_BLOCK_SIZE 64
+#define SCAN_MAX_CHARS 8
+
+typedef enum {
+    SCAN_IMPL_SCALAR = 0,
+    SCAN_IMPL_SSE2,
+    SCAN_IMPL_AVX2,
+    SCAN_IMPL_COUNT
+} ScanImpl;
+
+/* the chars to look for (build once, then read only: share it between threads) */
+typedef struct {
+    char chars[SCAN_MAX_CHARS];
+    int char_count;
+    int with_space;                 /* also isspace() chars (C locale) */
+    unsigned char member[256];      /* same set as a table, for the scalar path */
+} ScanSet;
+
+/* chars[0..count) (may hold '\0'), count <= SCAN_MAX_CHARS */
+void scan_set_init(ScanSet *set, const char *chars, int count, int with_space);
+
+/* bitmap of block[0..64), all 64 bytes must be readable */
+uint64_t scan_block(const ScanSet *set, const char *block);
+
+/* same for p[0..length) with length <= 64, nothing past it is read
+   (bits from length on are 0) */
+uint64_t scan_partial(const ScanSet *set, const char *p, size_t length);
+
+/* the path scan_block uses (best one the cpu has, unless forced) */
+ScanImpl scan_active_impl(void);
+const char *scan_impl_name(ScanImpl impl);
+
+/* switch paths (for benches/checks, not while other threads scan).
+   FALSE if this cpu/build doesnt have it */
+int scan_force_impl(ScanImpl impl);
+
+/* index of the lowest set bit (mask != 0) */
+#define SCAN_FIRST_BIT(mask) ((size_t)__builtin_ctzll(mask))
+
+#endif /* SCAN_H */
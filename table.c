@@ -2,27 +2,189 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "output_capture.h"
+#include "asm_stats.h"
 
 /* --------- internal helper funcs --------- */
 
-/* safer copy of str to buffer (avoid overflow kinda) */
-static void safe_copy(char *dst, const char *src, size_t cap) {
-    if (!dst || cap == 0) return;
-    if (!src) src = EMPTY_STRING;
-    strncpy(dst, src, cap - 1);
-    dst[cap - 1] = NULL_CHAR;
+#define INITIAL_TABLE_ROWS 16
+#define INITIAL_POOL_SIZE 256
+#define INITIAL_POOL_SLOTS 64
+#define MAX_POOL_SLOTS 1024         /* presizing stops here (MAX_TABLE_ROWS * 2 texts, half full) */
+#define INITIAL_FIXUPS 32
+#define INITIAL_DATA_WORDS 64
+#define INITIAL_DIRECTIVES 16
+#define INITIAL_DATA_ERRORS 4
+#define POOL_BYTES_PER_ROW 8        /* typical program: ~4 bytes of distinct text per row */
+
+/* bytes one row takes over all the arrays */
+#define ROW_BYTES (4 * sizeof(unsigned int) + sizeof(Operand) + sizeof(unsigned short) + 2)
+
+/* --------- string pool --------- */
+
+static int pool_init(StringPool *pool, Arena *arena, size_t text_size, int slot_count) {
+    pool->text = (char*)arena_alloc(arena, text_size);
+    pool->slots = (int*)arena_alloc(arena, (size_t)slot_count * sizeof(int));
+    if (!pool->text || !pool->slots) {
+        arena_free(arena, pool->text);
+        arena_free(arena, pool->slots);
+        return FALSE;
+    }
+    pool->text[0] = NULL_CHAR; /* offset 0 = "" */
+    pool->size = 1;
+    pool->capacity = text_size;
+    pool->slot_count = slot_count;
+    pool->count = 0;
+    int i;
+for (i = 0; i < pool->slot_count; i++) pool->slots[i] = NOT_FOUND;
+    return TRUE;
 }
 
-/* init row with default values (basicaly reset) */
-static void init_row(Row *r) {
-    if (!r) return;
-    r->label[0] = NULL_CHAR;
-    r->decimal_address = 0;
-    r->command = 0;
-    r->is_command_line = 0;
-    r->operands_string[0] = NULL_CHAR;
-    r->binary_machine_code = 0;
-    r->original_line_number = 0;
+static void pool_free(StringPool *pool, Arena *arena) {
+    arena_free(arena, pool->text);
+    arena_free(arena, pool->slots);
+    pool->text = NULL;
+    pool->slots = NULL;
+}
+
+/* slot of text[0..len) (or the empty slot it would go in) */
+static int pool_slot(const StringPool *pool, const char *text, size_t len, unsigned int hash) {
+    unsigned int mask = (unsigned int)pool->slot_count - 1;
+    unsigned int i = hash & mask;
+    while (pool->slots[i] != NOT_FOUND) {
+        const char *stored = pool->text + pool->slots[i];
+        if (strncmp(stored, text, len) == 0 && stored[len] == NULL_CHAR) return (int)i;
+        i = (i + 1) & mask;
+    }
+    return (int)i;
+}
+
+/* double the slots (at half full, like the macro index) */
+static int pool_grow_slots(StringPool *pool, Arena *arena) {
+    int new_count = pool->slot_count * 2;
+    int *old_slots = pool->slots;
+    int old_count = pool->slot_count;
+    int *new_slots = (int*)arena_alloc(arena, (size_t)new_count * sizeof(int));
+    if (!new_slots) return FALSE;
+
+    int i;
+for (i = 0; i < new_count; i++) new_slots[i] = NOT_FOUND;
+    pool->slots = new_slots;
+    pool->slot_count = new_count;
+    for (i = 0; i < old_count; i++) {
+        if (old_slots[i] == NOT_FOUND) continue;
+        const char *stored = pool->text + old_slots[i];
+        size_t len = strlen(stored);
+        new_slots[pool_slot(pool, stored, len, hash_name(stored, len))] = old_slots[i];
+    }
+    arena_free(arena, old_slots);
+    return TRUE;
+}
+
+/* offset of src (cut at cap-1 chars, like the old fixed buffers), added if new.
+   NOT_FOUND if memory ran out */
+static int pool_intern(StringPool *pool, Arena *arena, const char *src, size_t cap) {
+    if (!src || !*src) return 0;
+
+    size_t len = strnlen(src, cap - 1);
+    unsigned int hash = hash_name(src, len);
+    int slot = pool_slot(pool, src, len, hash);
+    if (pool->slots[slot] != NOT_FOUND) return pool->slots[slot];
+
+    /* keep the index at most half full */
+    if ((pool->count + 1) * 2 > pool->slot_count) {
+        if (!pool_grow_slots(pool, arena)) return NOT_FOUND;
+        slot = pool_slot(pool, src, len, hash);
+    }
+
+    if (pool->size + len + 1 > pool->capacity) {
+        size_t new_capacity = pool->capacity * 2;
+        while (pool->size + len + 1 > new_capacity) new_capacity *= 2;
+        char *new_text = (char*)arena_realloc(arena, pool->text, pool->size, new_capacity);
+        if (!new_text) return NOT_FOUND;
+        pool->text = new_text;
+        pool->capacity = new_capacity;
+    }
+
+    int offset = (int)pool->size;
+    memcpy(pool->text + offset, src, len);
+    pool->text[offset + len] = NULL_CHAR;
+    pool->size += len + 1;
+    pool->slots[slot] = offset;
+    pool->count++;
+    return offset;
+}
+
+/* --------- row arrays --------- */
+
+/* move the arrays into one block of new_cap rows (all of them in one
+   allocation, address points at its start). FALSE if memory ran out */
+static int resize_arrays(Table *tbl, int new_cap) {
+    size_t n = (size_t)new_cap;
+    char *block = (char*)arena_calloc(tbl->arena, n, ROW_BYTES);
+    if (!block) return FALSE;
+
+    /* widest first so every array stays aligned */
+    unsigned int *address  = (unsigned int*)block;
+    unsigned int *line     = address + n;
+    unsigned int *label    = line + n;
+    unsigned int *operands = label + n;
+    Operand *operand       = (Operand*)(operands + n);
+    unsigned short *code   = (unsigned short*)(operand + n);
+    unsigned char *command = (unsigned char*)(code + n);
+    unsigned char *flags   = command + n;
+
+    if (tbl->size > 0) {
+        size_t used = (size_t)tbl->size;
+        memcpy(address, tbl->address, used * sizeof(*address));
+        memcpy(line, tbl->line, used * sizeof(*line));
+        memcpy(label, tbl->label, used * sizeof(*label));
+        memcpy(operands, tbl->operands, used * sizeof(*operands));
+        memcpy(operand, tbl->operand, used * sizeof(*operand));
+        memcpy(code, tbl->code, used * sizeof(*code));
+        memcpy(command, tbl->command, used * sizeof(*command));
+        memcpy(flags, tbl->flags, used * sizeof(*flags));
+    }
+    arena_free(tbl->arena, tbl->address);
+
+    tbl->address = address;
+    tbl->line = line;
+    tbl->label = label;
+    tbl->operands = operands;
+    tbl->operand = operand;
+    tbl->code = code;
+    tbl->command = command;
+    tbl->flags = flags;
+    tbl->capacity = new_cap;
+    return TRUE;
+}
+
+/* intern a row's label + operand text (cut like the old fixed buffers were).
+   FALSE if memory ran out */
+static int intern_row_text(Table *tbl, const char *label, const char *operands,
+                           unsigned int *label_offset, unsigned int *operands_offset) {
+    int l = pool_intern(&tbl->strings, tbl->arena, label, MAX_LABEL_LEN);
+    int o = pool_intern(&tbl->strings, tbl->arena, operands, MAX_OPERAND_LEN);
+    if (l == NOT_FOUND || o == NOT_FOUND) {
+        err_printf("table: out of memory for row text\n");
+        return FALSE;
+    }
+    *label_offset = (unsigned int)l;
+    *operands_offset = (unsigned int)o;
+    return TRUE;
+}
+
+/* fill row index (address left alone) */
+static void store_row(Table *tbl, int index, unsigned int label_offset, CommandType cmd, int is_cmd_line,
+                      unsigned int operands_offset, unsigned int binary_code,
+                      unsigned int original_line_number) {
+    tbl->label[index] = label_offset;
+    tbl->operands[index] = operands_offset;
+    tbl->command[index] = (unsigned char)cmd;
+    tbl->flags[index] = is_cmd_line ? ROW_COMMAND_LINE : 0;
+    tbl->code[index] = (unsigned short)(binary_code & 0x3FFu); // only 10 bits
+    tbl->line[index] = original_line_number;
+    memset(&tbl->operand[index], 0, sizeof(Operand)); // text changed, describe again
 }
 
 /* print number as 10-bit binary (simple ver) */
@@ -37,28 +199,40 @@ for (i = 0; i < 10; ++i) {
 
 /* --------- API funcs --------- */
 
-/* create a table with some capacity */
-Table* create_table() {
-    Table *tbl = (Table*)malloc(sizeof(Table));
+/* create a table with room for expected_rows (so a normal file never grows it) */
+Table* create_table(Arena *arena, int expected_rows) {
+    Table *tbl = (Table*)arena_calloc(arena, 1, sizeof(Table));
     if (!tbl) return NULL;
+    tbl->arena = arena;
 
-    tbl->size = 0;
-    tbl->capacity = 16; // start with 16 rows
-    tbl->data = (Row*)malloc((size_t)tbl->capacity * sizeof(Row));
-    if (!tbl->data) {
-        free(tbl);
+    int rows = expected_rows > INITIAL_TABLE_ROWS ? expected_rows : INITIAL_TABLE_ROWS;
+    /* a label + an operand text per row at most, index kept under half full */
+    int slots = INITIAL_POOL_SLOTS;
+    while (slots < rows * 2 && slots < MAX_POOL_SLOTS) slots *= 2;
+    size_t text = (size_t)rows * POOL_BYTES_PER_ROW;
+    if (text < INITIAL_POOL_SIZE) text = INITIAL_POOL_SIZE;
+
+    if (!pool_init(&tbl->strings, arena, text, slots)) {
+        arena_free(arena, tbl);
+        return NULL;
+    }
+    if (!resize_arrays(tbl, rows)) {
+        pool_free(&tbl->strings, arena);
+        arena_free(arena, tbl);
         return NULL;
     }
-
-    int i;
-for (i = 0; i < tbl->capacity; ++i) init_row(&tbl->data[i]);
     return tbl;
 }
 
-/* free the table mem (dont forget to call) */
+/* free the table mem (dont forget to call, does nothing with an arena) */
 void free_table(Table *tbl) {
-    if (!tbl) return;
+    if (!tbl || tbl->arena) return;
+    free(tbl->address); // all the arrays are one block
+    free(tbl->fixups);
     free(tbl->data);
+    free(tbl->directives);
+    free(tbl->data_errors);
+    pool_free(&tbl->strings, NULL);
     free(tbl);
 }
 
@@ -70,60 +244,44 @@ void ensure_capacity(Table *tbl) {
     int new_cap = tbl->capacity * 2;
     if (new_cap < 1) new_cap = 1;
 
-    Row *new_data = (Row*)realloc(tbl->data, (size_t)new_cap * sizeof(Row));
-    if (!new_data) {
-        fprintf(stderr, "ensure_capacity: realloc fail (req cap=%d)\n", new_cap);
-        return;
+    STATS_COUNT(ASM_COUNT_TABLE_REALLOC);
+    if (!resize_arrays(tbl, new_cap)) {
+        err_printf("ensure_capacity: realloc fail (req cap=%d)\n", new_cap);
     }
-
-    int i;
-for (i = tbl->capacity; i < new_cap; ++i) init_row(&new_data[i]);
-
-    tbl->data = new_data;
-    tbl->capacity = new_cap;
 }
 
 /* add new row to the end */
 void add_row(Table *tbl, const char *label, CommandType cmd, int is_cmd_line,
              const char *operands, unsigned int binary_code, unsigned int original_line_number) {
+    unsigned int label_offset, operands_offset;
     if (!tbl) return;
     ensure_capacity(tbl);
     if (tbl->size >= tbl->capacity) return; // realloc failed maybe
+    if (!intern_row_text(tbl, label, operands, &label_offset, &operands_offset)) return;
 
-    Row *r = &tbl->data[tbl->size];
-    init_row(r);
-
-    safe_copy(r->label, label, sizeof(r->label));
-    r->command = cmd;
-    r->is_command_line = (is_cmd_line != 0);
-    safe_copy(r->operands_string, operands, sizeof(r->operands_string));
-    r->binary_machine_code = (binary_code & 0x3FFu); // only 10 bits
-    r->original_line_number = original_line_number;
-    r->decimal_address = 0; // will reset later
-
+    store_row(tbl, tbl->size, label_offset, cmd, is_cmd_line, operands_offset, binary_code,
+              original_line_number);
+    tbl->address[tbl->size] = 0; // will reset later
     tbl->size += 1;
 }
 
 /* edit a row at given index (keep addr same) */
 void edit_row(Table *tbl, int index, const char *label, CommandType cmd, int is_cmd_line,
               const char *operands, unsigned int binary_code, unsigned int original_line_number) {
+    unsigned int label_offset, operands_offset;
     if (!tbl) return;
     if (index < 0 || index >= tbl->size) return;
+    if (!intern_row_text(tbl, label, operands, &label_offset, &operands_offset)) return;
 
-    Row *r = &tbl->data[index];
-
-    safe_copy(r->label, label, sizeof(r->label));
-    r->command = cmd;
-    r->is_command_line = (is_cmd_line != 0);
-    safe_copy(r->operands_string, operands, sizeof(r->operands_string));
-    r->binary_machine_code = (binary_code & 0x3FFu);
-    r->original_line_number = original_line_number;
+    store_row(tbl, index, label_offset, cmd, is_cmd_line, operands_offset, binary_code,
+              original_line_number);
     // note: decimal addr not changed here
 }
 
 /* insert new row at index (shift right) */
 void insert_row(Table *tbl, int index, const char *label, CommandType cmd, int is_cmd_line,
                 const char *operands, unsigned int binary_code, unsigned int original_line_number) {
+    unsigned int label_offset, operands_offset;
     if (!tbl) return;
 
     if (index < 0) index = 0;
@@ -131,31 +289,135 @@ void insert_row(Table *tbl, int index, const char *label, CommandType cmd, int i
 
     ensure_capacity(tbl);
     if (tbl->size >= tbl->capacity) return;
+    if (!intern_row_text(tbl, label, operands, &label_offset, &operands_offset)) return;
+
+    // move old rows to the right (every array)
+    size_t moved = (size_t)(tbl->size - index);
+    memmove(&tbl->address[index + 1], &tbl->address[index], moved * sizeof(*tbl->address));
+    memmove(&tbl->line[index + 1], &tbl->line[index], moved * sizeof(*tbl->line));
+    memmove(&tbl->label[index + 1], &tbl->label[index], moved * sizeof(*tbl->label));
+    memmove(&tbl->operands[index + 1], &tbl->operands[index], moved * sizeof(*tbl->operands));
+    memmove(&tbl->operand[index + 1], &tbl->operand[index], moved * sizeof(*tbl->operand));
+    memmove(&tbl->code[index + 1], &tbl->code[index], moved * sizeof(*tbl->code));
+    memmove(&tbl->command[index + 1], &tbl->command[index], moved * sizeof(*tbl->command));
+    memmove(&tbl->flags[index + 1], &tbl->flags[index], moved * sizeof(*tbl->flags));
+
+    store_row(tbl, index, label_offset, cmd, is_cmd_line, operands_offset, binary_code,
+              original_line_number);
+    tbl->address[index] = 0;
+    tbl->size += 1;
 
-    // move old rows to the right
-    int i;
-for (i = tbl->size; i > index; --i) {
-        tbl->data[i] = tbl->data[i - 1];
+    // data that came after the old row index now comes after the new one too
+    int d;
+    for (d = 0; d < tbl->directive_count; d++) {
+        if (tbl->directives[d].code_before > index) tbl->directives[d].code_before++;
+    }
+}
+
+/* room for one more item in a data segment array (doubling, arena aware).
+   FALSE if memory ran out */
+static int grow_items(Table *tbl, void **items, int count, int *capacity, size_t item_size, int initial) {
+    if (count < *capacity) return TRUE;
+    int new_cap = *capacity ? *capacity * 2 : initial;
+    void *grown = arena_realloc(tbl->arena, *items, (size_t)*capacity * item_size, (size_t)new_cap * item_size);
+    if (!grown) {
+        err_printf("table: out of memory for the data segment (req cap=%d)\n", new_cap);
+        return FALSE;
     }
-    init_row(&tbl->data[index]);
+    *items = grown;
+    *capacity = new_cap;
+    return TRUE;
+}
 
-    Row *r = &tbl->data[index];
-    safe_copy(r->label, label, sizeof(r->label));
-    r->command = cmd;
-    r->is_command_line = (is_cmd_line != 0);
-    safe_copy(r->operands_string, operands, sizeof(r->operands_string));
-    r->binary_machine_code = (binary_code & 0x3FFu);
-    r->original_line_number = original_line_number;
-    r->decimal_address = 0;
+int add_data_directive(Table *tbl, const char *label, unsigned int original_line_number) {
+    if (!tbl) return FALSE;
+    if (!grow_items(tbl, (void**)&tbl->directives, tbl->directive_count, &tbl->directive_capacity,
+                    sizeof(DataDirective), INITIAL_DIRECTIVES)) return FALSE;
 
-    tbl->size += 1;
+    int label_offset = pool_intern(&tbl->strings, tbl->arena, label, MAX_LABEL_LEN);
+    if (label_offset == NOT_FOUND) {
+        err_printf("table: out of memory for row text\n");
+        return FALSE;
+    }
+
+    DataDirective *directive = &tbl->directives[tbl->directive_count++];
+    directive->label = (unsigned int)label_offset;
+    directive->line = original_line_number;
+    directive->first = tbl->data_size;
+    directive->count = 0;
+    directive->code_before = tbl->size;
+    directive->address = 0; // will reset later
+    return TRUE;
 }
 
-/* get row pointer (or null if invalid index) */
-Row* get_row(Table *tbl, int index) {
-    if (!tbl) return NULL;
-    if (index < 0 || index >= tbl->size) return NULL;
-    return &tbl->data[index];
+int add_data_word(Table *tbl, unsigned short word) {
+    if (!tbl || tbl->directive_count == 0) return FALSE;
+    if (!grow_items(tbl, (void**)&tbl->data, tbl->data_size, &tbl->data_capacity,
+                    sizeof(unsigned short), INITIAL_DATA_WORDS)) return FALSE;
+
+    tbl->data[tbl->data_size++] = (unsigned short)(word & 0x3FFu); // only 10 bits
+    tbl->directives[tbl->directive_count - 1].count++;
+    return TRUE;
+}
+
+int add_data_error(Table *tbl, OperandError error) {
+    if (!tbl || tbl->directive_count == 0) return FALSE;
+    if (!grow_items(tbl, (void**)&tbl->data_errors, tbl->data_error_count, &tbl->data_error_capacity,
+                    sizeof(DataError), INITIAL_DATA_ERRORS)) return FALSE;
+
+    tbl->data_errors[tbl->data_error_count].directive = tbl->directive_count - 1;
+    tbl->data_errors[tbl->data_error_count].error = (int)error;
+    tbl->data_error_count++;
+    return add_data_word(tbl, 0);
+}
+
+int table_words(const Table *tbl) {
+    return tbl->size + tbl->data_size;
+}
+
+int add_fixup(Table *tbl, int row, int symbol) {
+    if (!tbl) return FALSE;
+    if (tbl->fixup_count >= tbl->fixup_capacity) {
+        int new_cap = tbl->fixup_capacity ? tbl->fixup_capacity * 2 : INITIAL_FIXUPS;
+        Fixup *fixups = (Fixup*)arena_realloc(tbl->arena, tbl->fixups,
+                                              (size_t)tbl->fixup_capacity * sizeof(Fixup),
+                                              (size_t)new_cap * sizeof(Fixup));
+        if (!fixups) {
+            err_printf("add_fixup: realloc fail (req cap=%d)\n", new_cap);
+            return FALSE;
+        }
+        tbl->fixups = fixups;
+        tbl->fixup_capacity = new_cap;
+    }
+    tbl->fixups[tbl->fixup_count].row = row;
+    tbl->fixups[tbl->fixup_count].symbol = symbol;
+    tbl->fixups[tbl->fixup_count].next = NOT_FOUND;
+    tbl->fixup_count++;
+    return TRUE;
+}
+
+/* copy row out (FALSE if invalid index) */
+int get_row(const Table *tbl, int index, Row *row) {
+    if (!tbl || !row) return FALSE;
+    if (index < 0 || index >= tbl->size) return FALSE;
+
+    row->label = row_label(tbl, index);
+    row->decimal_address = tbl->address[index];
+    row->command = (CommandType)tbl->command[index];
+    row->is_command_line = (tbl->flags[index] & ROW_COMMAND_LINE) != 0;
+    row->operands_string = row_operands(tbl, index);
+    row->binary_machine_code = tbl->code[index];
+    row->original_line_number = tbl->line[index];
+    row->operand = tbl->operand[index];
+    return TRUE;
+}
+
+const char *row_label(const Table *tbl, int index) {
+    return tbl->strings.text + tbl->label[index];
+}
+
+const char *row_operands(const Table *tbl, int index) {
+    return tbl->strings.text + tbl->operands[index];
 }
 
 /* reset decimal addresses starting from offset */
@@ -163,11 +425,16 @@ void reset_addresses(Table *tbl, unsigned int offset) {
     if (!tbl) return;
 
     unsigned int addr = offset;
+    int d = 0;
     int i;
-for (i = 0; i < tbl->size; ++i) {
-        Row *r = &tbl->data[i];
-        r->decimal_address = addr;
-        addr++;
+    for (i = 0; i <= tbl->size; ++i) {
+        /* directives that sit before row i (after the last row for i == size) */
+        while (d < tbl->directive_count && tbl->directives[d].code_before <= i) {
+            tbl->directives[d].address = addr;
+            addr += (unsigned int)tbl->directives[d].count;
+            d++;
+        }
+        if (i < tbl->size) tbl->address[i] = addr++;
     }
 }
 
@@ -180,18 +447,36 @@ void print_table(Table *tbl) {
     printf("-----+-" "--------------------" "-+-" "------" "-+-" "---" "-+-"
            "------------------------------" "-+-" "------------" "-+-" "------" "\n");
 
+    int d = 0;
     int i;
-for (i = 0; i < tbl->size; ++i) {
-        Row *r = &tbl->data[i];
+    for (i = 0; i <= tbl->size; ++i) {
+        /* data lines between the code rows (one line per word, label on the first) */
+        while (d < tbl->directive_count && tbl->directives[d].code_before <= i) {
+            const DataDirective *directive = &tbl->directives[d];
+            int w;
+            for (w = 0; w < directive->count; w++) {
+                printf("%-5u | %-20s | %-6s | %-3u | %-30s | ",
+                       directive->address + (unsigned int)w,
+                       w == 0 ? tbl->strings.text + directive->label : EMPTY_STRING,
+                       "data", (unsigned)(w == 0), EMPTY_STRING);
+                print_10bit_binary(tbl->data[directive->first + w]);
+                printf(" | %-6u\n", directive->line);
+            }
+            d++;
+        }
+        if (i == tbl->size) break;
+
+        Row r;
+        get_row(tbl, i, &r);
 
         printf("%-5u | %-20s | %-6u | %-3u | %-30s | ",
-               r->decimal_address,
-               r->label,
-               (unsigned)r->command,
-               (unsigned)r->is_command_line,
-               r->operands_string);
-
-        print_10bit_binary(r->binary_machine_code);
-        printf(" | %-6u\n", r->original_line_number);
+               r.decimal_address,
+               r.label,
+               (unsigned)r.command,
+               (unsigned)r.is_command_line,
+               r.operands_string);
+
+        print_10bit_binary(r.binary_machine_code);
+        printf(" | %-6u\n", r.original_line_number);
     }
 }
@@ -2,27 +2,159 @@
 #define TABLE_H
 
 #include "util.h"
+#include "arena.h"
+
+/* Hard cap on number of rows (program lines) allowed in the table. */
+#ifndef MAX_TABLE_ROWS
+#define MAX_TABLE_ROWS 255
+#endif
+
+/* address of row 0 (the spec loads programs at 100) */
+#define BASE_ADDRESS 100
+
+/* what a row's operand text turned out to be (filled by describe_row in the
+   first pass, so the second pass never has to look at the text again) */
+typedef enum {
+    OPERAND_NONE = 0,           /* not described (row added by hand) */
+    OPERAND_INSTRUCTION,        /* first row of a command: addressing modes */
+    OPERAND_IMMEDIATE,          /* #value */
+    OPERAND_REGISTER,           /* rN, as source or destination (role) */
+    OPERAND_REGISTER_PAIR,      /* rX, rY packed in one word */
+    OPERAND_MATRIX_INDEX,       /* [rX][rY] part of a matrix operand */
+    OPERAND_SYMBOL,             /* label / matrix name, resolved in pass two */
+    OPERAND_DATA,               /* .data/.mat value or one .string char */
+    OPERAND_INVALID             /* bad text, pass two reports the error */
+} OperandKind;
+
+/* why an OPERAND_INVALID row is bad (each one has its own message) */
+typedef enum {
+    OPERAND_OK = 0,
+    OPERAND_ERR_MISSING_TEXT,
+    OPERAND_ERR_MATRIX_REGISTERS,   /* [..][..] with a bad register */
+    OPERAND_ERR_REGISTER_PAIR,      /* rX, rY out of r0..r7 */
+    OPERAND_ERR_MATRIX_BRACKETS,
+    OPERAND_ERR_MATRIX_PATTERN,
+    OPERAND_ERR_IMMEDIATE,
+    OPERAND_ERR_REGISTER_RANGE,
+    OPERAND_ERR_ROLE,
+    OPERAND_ERR_DATA_NUMBER,
+    OPERAND_ERR_DATA_DIRECTIVE
+} OperandError;
 
-/* one row of the table (basicly one line of asm info) */
 typedef struct {
-    char label[MAX_LABEL_LEN];
+    unsigned char kind;         /* OperandKind */
+    unsigned char error;        /* OperandError (OPERAND_INVALID only) */
+    unsigned char role;         /* 1 = source, 2 = destination */
+    unsigned char reg1;         /* register / pair / matrix row register */
+    unsigned char reg2;         /* pair / matrix column register */
+    unsigned char operand_count;/* instruction: operands given (0..2) */
+    unsigned char src_mode;     /* instruction: AddressingMode of each */
+    unsigned char dest_mode;
+    unsigned short value;       /* immediate payload (8 bits) / data word (10 bits) /
+                                   symbol id (NO_SYMBOL = not interned, look the text up) */
+} Operand;
+
+#define NO_SYMBOL 0xFFFFu
+
+/* one row of the table, unpacked (what get_row copies out). the text
+   pointers point into the table's string pool: good until the next
+   add_row/insert_row/edit_row */
+typedef struct {
+    const char *label;
     unsigned int decimal_address;
-    CommandType command : 5;
-    unsigned int is_command_line : 1;
-    char operands_string[MAX_OPERAND_LEN];
-    unsigned int binary_machine_code : 10;
+    CommandType command;
+    unsigned int is_command_line;
+    const char *operands_string;
+    unsigned int binary_machine_code;
     unsigned int original_line_number; // line num in src file
+    Operand operand;                   // operands_string, already parsed
 } Row;
 
-/* whole table (array of rows) */
+/* every distinct label/operand text once, rows keep offsets into it
+   (offset 0 is always "") */
 typedef struct {
-    Row *data;
-    int size;
+    char *text;
+    size_t size;
+    size_t capacity;
+    int *slots;                 /* open addressing over offsets, NOT_FOUND = empty */
+    int slot_count;
+    int count;
+} StringPool;
+
+#define ROW_COMMAND_LINE 0x1    /* flags: first row of a command/directive line */
+
+/* a row whose word is a symbol's address: pass two patches these, the .ext
+   writer lists the extern ones (both in row order, no name lookups) */
+typedef struct {
+    int row;
+    int symbol;     /* id from intern_symbol (labels.h) */
+    int next;       /* one-pass: next use still waiting on the same symbol */
+} Fixup;
+
+/* one .data/.string/.mat line: its words are Table.data[first..first+count).
+   it sits after code_before code rows, so its address is the IC there plus
+   where it starts in the segment (reset_addresses fills address) */
+typedef struct {
+    unsigned int label;     /* offset into strings (0 = no label) */
+    unsigned int line;      /* original .as line */
+    int first;
+    int count;
+    int code_before;
+    unsigned int address;
+} DataDirective;
+
+/* a data value that didnt parse (pass two reports it where the word would be) */
+typedef struct {
+    int directive;
+    int error;              /* OperandError */
+} DataError;
+
+/*
+ * Table
+ * -----
+ * One entry per code word, each field in its own array (so a pass that
+ * only walks codes/addresses doesnt drag the text along). Text lives in the
+ * string pool, rows only hold offsets.
+ * Data words dont get rows: they are final once parsed, so they go in the
+ * data segment (2 bytes each) with one DataDirective per line. Code and data
+ * still share one address space in source order.
+ * With an arena every array comes out of it (free_table is then a no-op,
+ * resetting the arena frees it all).
+ */
+typedef struct {
+    unsigned int *address;      /* decimal address (reset_addresses) */
+    unsigned short *code;       /* 10-bit machine word */
+    unsigned char *command;     /* CommandType */
+    unsigned char *flags;       /* ROW_COMMAND_LINE */
+    unsigned int *line;         /* original .as line */
+    Operand *operand;
+    unsigned int *label;        /* offsets into strings */
+    unsigned int *operands;
+    StringPool strings;
+    Fixup *fixups;              /* in row order */
+    int fixup_count;
+    int fixup_capacity;
+    int size;                   /* code rows */
     int capacity;
+    unsigned short *data;       /* data segment: every data word, in source order */
+    int data_size;
+    int data_capacity;
+    DataDirective *directives;  /* in source order */
+    int directive_count;
+    int directive_capacity;
+    DataError *data_errors;     /* in segment order */
+    int data_error_count;
+    int data_error_capacity;
+    int encode_now;             /* one-pass mode: rows get their word as theyre added */
+    int unencoded;              /* one-pass: rows that didnt (pass two runs to report them) */
+    int parallel_rows;          /* pass two splits the rows over the task pool from this
+                                   many up (0 = always one thread) */
+    Arena *arena;               /* NULL = malloc'd */
 } Table;
 
 /* funcs for table managment */
-Table* create_table();
+/* expected_rows = how many rows to make room for up front (0 = a few) */
+Table* create_table(Arena *arena, int expected_rows);
 void free_table(Table *tbl);
 void ensure_capacity(Table *tbl);
 
@@ -33,7 +165,29 @@ void edit_row  (Table *tbl, int index, const char *label, CommandType cmd, int i
 void insert_row(Table *tbl, int index, const char *label, CommandType cmd, int is_cmd_line,
                 const char *operands, unsigned int binary_code, unsigned int original_line_number);
 
-Row* get_row(Table *tbl, int index);
+/* data segment: a directive line, then its words (they go to the last
+   directive). FALSE if memory ran out */
+int add_data_directive(Table *tbl, const char *label, unsigned int original_line_number);
+int add_data_word(Table *tbl, unsigned short word);
+/* a value that isnt a number: takes its word's place (0), pass two reports error */
+int add_data_error(Table *tbl, OperandError error);
+
+/* code rows + data words (what MAX_TABLE_ROWS caps) */
+int table_words(const Table *tbl);
+
+/* row is a use of symbol (appended, so keep adding in row order). FALSE if
+   memory ran out */
+int add_fixup(Table *tbl, int row, int symbol);
+
+/* copy row index into *row, FALSE if there is no such row */
+int get_row(const Table *tbl, int index, Row *row);
+
+/* text of a row (index must be < size) */
+const char *row_label(const Table *tbl, int index);
+const char *row_operands(const Table *tbl, int index);
+
+/* code rows and data directives get their addresses from offset up, in
+   source order (a directive's words follow right after its code_before rows) */
 void reset_addresses(Table *tbl, unsigned int offset);
 void print_table(Table *tbl);
 
@@ -0,0 +1,124 @@
+#include <pthread.h>
+#include <unistd.h>
+
+#include "task_pool.h"
+#include "util.h"
+
+/* more than this never paid off for ~1k row chunks */
+#define MAX_POOL_THREADS 8
+
+typedef struct TaskJob {
+    TaskChunkFn run;
+    void *context;
+    int chunks;
+    int next_chunk;         /* next one to hand out */
+    int done;               /* chunks finished */
+    struct TaskJob *next;   /* jobs that still have chunks to hand out */
+} TaskJob;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t work_done = PTHREAD_COND_INITIALIZER;
+static TaskJob *open_jobs = NULL;
+static int wanted_threads = NOT_FOUND;  /* NOT_FOUND = not decided yet */
+static int started = FALSE;
+
+static int default_threads(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 1 ? (int)cpus - 1 : 0;
+    return threads > MAX_POOL_THREADS ? MAX_POOL_THREADS : threads;
+}
+
+/* lock held: next chunk of the oldest open job (job closes when its last
+   chunk goes out). FALSE if there is none */
+static int take_chunk(TaskJob *only, TaskJob **job, int *chunk) {
+    TaskJob **link = &open_jobs;
+    while (*link && only && *link != only) link = &(*link)->next;
+    if (!*link) return FALSE;
+
+    *job = *link;
+    *chunk = (*job)->next_chunk++;
+    if ((*job)->next_chunk == (*job)->chunks) *link = (*job)->next;
+    return TRUE;
+}
+
+/* lock held: run chunk without the lock, then count it */
+static void run_chunk(TaskJob *job, int chunk) {
+    pthread_mutex_unlock(&pool_lock);
+    job->run(chunk, job->context);
+    pthread_mutex_lock(&pool_lock);
+    job->done++;
+    if (job->done == job->chunks) pthread_cond_broadcast(&work_done);
+}
+
+static void *pool_worker(void *arg) {
+    TaskJob *job;
+    int chunk;
+    (void)arg;
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (!take_chunk(NULL, &job, &chunk)) pthread_cond_wait(&work_ready, &pool_lock);
+        run_chunk(job, chunk);
+    }
+    return NULL;
+}
+
+/* lock held: decide the size + start the threads the first time */
+static void start_pool(void) {
+    int i;
+    if (started) return;
+    started = TRUE;
+    if (wanted_threads == NOT_FOUND) wanted_threads = default_threads();
+
+    for (i = 0; i < wanted_threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, pool_worker, NULL) != 0) break;
+        pthread_detach(thread);
+    }
+    wanted_threads = i; /* whatever actually started */
+}
+
+int task_pool_threads(int threads) {
+    pthread_mutex_lock(&pool_lock);
+    if (!started) {
+        if (threads > MAX_POOL_THREADS) threads = MAX_POOL_THREADS;
+        wanted_threads = threads > 0 ? threads : default_threads();
+    }
+    int count = wanted_threads;
+    pthread_mutex_unlock(&pool_lock);
+    return count;
+}
+
+void task_pool_run(int chunks, TaskChunkFn run, void *context) {
+    TaskJob job;
+    TaskJob *taken;
+    int chunk;
+    if (chunks <= 0) return;
+
+    job.run = run;
+    job.context = context;
+    job.chunks = chunks;
+    job.next_chunk = 0;
+    job.done = 0;
+    job.next = NULL;
+
+    pthread_mutex_lock(&pool_lock);
+    start_pool();
+    if (wanted_threads == 0 || chunks == 1) {
+        pthread_mutex_unlock(&pool_lock);
+        for (chunk = 0; chunk < chunks; chunk++) run(chunk, context);
+        return;
+    }
+
+    /* at the end of the list, older jobs get their helpers first */
+    TaskJob **link = &open_jobs;
+    while (*link) link = &(*link)->next;
+    *link = &job;
+    pthread_cond_broadcast(&work_ready);
+
+    /* help with our own job, then wait for the chunks the pool took */
+    while (take_chunk(&job, &taken, &chunk)) run_chunk(taken, chunk);
+    while (job.done < job.chunks) pthread_cond_wait(&work_done, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+}
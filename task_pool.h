@@ -0,0 +1,26 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+/*
+ * task_pool.h
+ * -----------
+ * One process-wide pool of helper threads for splitting a big piece of
+ * work (pass two of a huge table) into chunks. Started the first time it
+ * is used, lives until exit. Any number of threads can run jobs at once:
+ * the caller always works on its own job too, so a busy pool only means
+ * less help, never a wait for someone elses job.
+ */
+
+/* does chunk number chunk (0..chunks-1) of a job */
+typedef void (*TaskChunkFn)(int chunk, void *context);
+
+/* helper threads to start (only before the pool's first use, later calls
+   just report). 0 = one per cpu minus the caller. returns the count in use
+   (or the one that will be) */
+int task_pool_threads(int threads);
+
+/* run every chunk (on the pool + this thread), returns when all are done.
+   with no helper threads its just a loop */
+void task_pool_run(int chunks, TaskChunkFn run, void *context);
+
+#endif /* TASK_POOL_H */
@@ -3,27 +3,66 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <time.h>
 #include "util.h"
+#include "output_capture.h"
 #include "labels.h"
+#include "asm_stats.h"
+
+/* which reserved word (command or data directive) word[0..length) could be,
+   picked by length + a char or two. NOT_FOUND if none fits the shape */
+static int reserved_word_candidate(const char *word, size_t length) {
+    switch (length) {
+    case 3:
+        switch (word[0]) {
+        case 'a': return ADD;
+        case 'b': return BNE;
+        case 'c': return word[1] == 'm' ? CMP : CLR;
+        case 'd': return DEC;
+        case 'i': return INC;
+        case 'j': return word[1] == 'm' ? JMP : JSR;
+        case 'l': return LEA;
+        case 'm': return MOV;
+        case 'n': return NOT;
+        case 'p': return PRN;
+        case 'r': return word[1] == 'e' ? RED : RTS;
+        case 's': return SUB;
+        }
+        return NOT_FOUND;
+    case 4:
+        if (word[0] == 's') return STP;
+        if (word[0] == DOT_CHAR) return MAT;
+        return NOT_FOUND;
+    case 5:
+        return word[0] == DOT_CHAR ? DAT : NOT_FOUND;
+    case 7:
+        return word[0] == DOT_CHAR ? STR : NOT_FOUND;
+    }
+    return NOT_FOUND;
+}
+
+/* command or data directive named word[0..length), NOT_FOUND if its neither.
+   one switch + one memcmp instead of strcmp-ing the whole name list */
+int find_reserved_word(const char *word, size_t length) {
+    int candidate = reserved_word_candidate(word, length);
+    if (candidate == NOT_FOUND || memcmp(word, command_names[candidate], length) != 0)
+        return NOT_FOUND;
+    return candidate;
+}
 
-/* this func trys to find a comand by name or label */
+/* this func trys to find a comand by name or label
+   (data directives only count when the line has a label, always been like that) */
 int find_command(char *word, char *label) {
-    int i;
-for (i = 0; i < NUMBER_OF_COMMANDS; i++) {
-        if (strcmp(word, command_names[i]) == 0) {
-            return i; // found normal command
-        }
-        if (i < NUMBER_OF_DATA_TYPES &&
-            strcmp(label, EMPTY_STRING) != 0 &&
-            strcmp(word, command_names[i + NUMBER_OF_COMMANDS]) == 0) {
-            return i + NUMBER_OF_COMMANDS; // found data type command
-        }
+    int found = find_reserved_word(word, strlen(word));
+    if (found >= NUMBER_OF_COMMANDS && strcmp(label, EMPTY_STRING) == 0) {
+        return NOT_FOUND;
     }
-    return NOT_FOUND; // nothing was found
+    return found;
 }
 
 /* check if string is an integer number (no double/float allowed) */
 int is_number(const char *s, double *out) {
+    STATS_COUNT(ASM_COUNT_IS_NUMBER);
     if (s == NULL) return FALSE;
 
     // skip space at the start
@@ -62,6 +101,7 @@ int is_number(const char *s, double *out) {
 
 /* chek if its a register (like r0 - r7) */
 int is_register(const char *op) {
+    STATS_COUNT(ASM_COUNT_IS_REGISTER);
     char opbuf[MAX_OPERAND_LEN];
     strncpy(opbuf, op, MAX_OPERAND_LEN - 1);
     opbuf[MAX_OPERAND_LEN - 1] = NULL_CHAR;
@@ -109,6 +149,7 @@ int is_immediate(const char *op) {
 
 /* chek if its a matrix like [2][3] or mat[4][5] */
 int is_matrix(const char *op) {
+    STATS_COUNT(ASM_COUNT_IS_MATRIX);
     char buf[MAX_OPERAND_LEN];
     strncpy(buf, op, sizeof(buf) - 1);
     buf[sizeof(buf) - 1] = NULL_CHAR;
@@ -162,7 +203,49 @@ int is_matrix(const char *op) {
     return valid;
 }
 
+/* reentrant strtok: same rules, but the position lives in *cursor not in a static
+   (so worker threads can tokenize at the same time). start with *cursor = str */
+char *split_token(char **cursor, const char *delims) {
+    char *start = *cursor;
+    if (start == NULL) return NULL;
+
+    start += strspn(start, delims); /* skip leading delims */
+    if (*start == NULL_CHAR) {
+        *cursor = NULL;
+        return NULL;
+    }
+
+    char *end = start + strcspn(start, delims);
+    if (*end == NULL_CHAR) {
+        *cursor = NULL; /* last token */
+    } else {
+        *end = NULL_CHAR;
+        *cursor = end + 1;
+    }
+    return start;
+}
+
 /* print error msg to stderr */
 void print_error(const char *filename, int line_number, const char *msg) {
-    fprintf(stderr, "%s: Error at line %d: %s\n", filename, line_number, msg);
+    err_printf("%s: Error at line %d: %s\n", filename, line_number, msg);
+    capture_diagnostic(filename, line_number, msg);
+}
+
+/* wall clock for timing stuff (never jumps back like time() can) */
+double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* FNV-1a over name[0..len) (for the hashed name tables, len so we can hash
+   a token straight out of a line without copying it first) */
+unsigned int hash_name(const char *name, size_t len) {
+    unsigned int hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
 }
@@ -1,6 +1,8 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stddef.h>
+
 /* chars and strings */
 #define NULL_CHAR '\0'
 #define NEW_LINE_STRING "\n"
@@ -43,7 +45,6 @@
 #define MACRO_LEN 4
 #define MACRO_END_LEN 7
 #define DEFAULT_MACRO_CAPACITY 10
-#define INITIAL_LINE_CAPACITY 4
 #define GROWTH_FACTOR 2
 
 /* bool like defines */
@@ -91,15 +92,6 @@ typedef enum {
     MAT = 18
 } DataType;
 
-/* number of operands for each command */
-static const int command_operands[] = {
-    [MOV] = 2, [CMP] = 2, [ADD] = 2, [SUB] = 2,
-    [NOT] = 1, [CLR] = 1, [LEA] = 2, [INC] = 1,
-    [DEC] = 1, [JMP] = 1, [BNE] = 1, [RED] = 1,
-    [PRN] = 1, [JSR] = 1, [RTS] = 0, [STP] = 0,
-    [STR] = 0, [DAT] = 0, [MAT] = 0
-};
-
 /* names of commands */
 static const char* command_names[] = {
     [MOV] = "mov", [CMP] = "cmp", [ADD] = "add", [SUB] = "sub",
@@ -126,11 +118,15 @@ typedef enum {
 
 /* funcs from util.c */
 int find_command(char *word, char *label);
+int find_reserved_word(const char *word, size_t length);
 int is_number(const char *s, double *out);
 int is_register(const char *op);
 int is_immediate(const char *op);
 int is_matrix(const char *op);
 void print_error(const char *filename, int line_number, const char *msg);
+char *split_token(char **cursor, const char *delims);
+double monotonic_seconds(void);
+unsigned int hash_name(const char *name, size_t len);
 
 /* forward declare Labels so no cycles with labels.h */
 struct Labels;
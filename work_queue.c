@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include "work_queue.h"
+#include "util.h"
+
+int queue_init(WorkQueue *q, int capacity) {
+    if (capacity < 1) capacity = 1;
+    q->items = malloc((size_t)capacity * sizeof(void*));
+    if (!q->items) return FALSE;
+    q->capacity = capacity;
+    q->head = 0;
+    q->count = 0;
+    q->closed = FALSE;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    return TRUE;
+}
+
+void queue_destroy(WorkQueue *q) {
+    if (!q || !q->items) return;
+    pthread_cond_destroy(&q->not_full);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_mutex_destroy(&q->lock);
+    free(q->items);
+    q->items = NULL;
+}
+
+/* caller holds the lock and checked there is room */
+static void push_locked(WorkQueue *q, void *item) {
+    q->items[(q->head + q->count) % q->capacity] = item;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+}
+
+int queue_push(WorkQueue *q, void *item) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->capacity && !q->closed)
+        pthread_cond_wait(&q->not_full, &q->lock);
+    if (q->closed) {
+        pthread_mutex_unlock(&q->lock);
+        return FALSE;
+    }
+    push_locked(q, item);
+    pthread_mutex_unlock(&q->lock);
+    return TRUE;
+}
+
+int queue_try_push(WorkQueue *q, void *item) {
+    pthread_mutex_lock(&q->lock);
+    if (q->closed || q->count == q->capacity) {
+        pthread_mutex_unlock(&q->lock);
+        return FALSE;
+    }
+    push_locked(q, item);
+    pthread_mutex_unlock(&q->lock);
+    return TRUE;
+}
+
+int queue_pop(WorkQueue *q, void **item) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed)
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    if (q->count == 0) {
+        pthread_mutex_unlock(&q->lock); /* closed and drained */
+        return FALSE;
+    }
+    *item = q->items[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return TRUE;
+}
+
+void queue_close(WorkQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = TRUE;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+}
@@ -0,0 +1,32 @@
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <pthread.h>
+
+/*
+ * WorkQueue
+ * ---------
+ * Bounded FIFO of void* items shared between threads (ring buffer).
+ * Producers either block while its full (queue_push) or get told no
+ * right away (queue_try_push) so they can push back on whoever is calling.
+ */
+typedef struct {
+    void **items;
+    int capacity;
+    int head;       /* index of oldest item */
+    int count;
+    int closed;     /* no more pushes, pops drain whats left */
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} WorkQueue;
+
+int  queue_init(WorkQueue *q, int capacity);   /* TRUE on success */
+void queue_destroy(WorkQueue *q);
+
+int  queue_push(WorkQueue *q, void *item);     /* blocks while full, FALSE if closed */
+int  queue_try_push(WorkQueue *q, void *item); /* FALSE if full or closed */
+int  queue_pop(WorkQueue *q, void **item);     /* blocks, FALSE once closed and empty */
+void queue_close(WorkQueue *q);
+
+#endif /* WORK_QUEUE_H */